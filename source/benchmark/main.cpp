@@ -0,0 +1,68 @@
+
+#include <filesystem>
+#include <atomic>
+#include <cstdlib>
+#include "../../source/xserializer.h"
+#include "../../source/benchmark/xserializer_benchmark.h"
+
+//
+// Block sizes are separated by commas, with an optional K or M suffix (auto picks one per pack)
+//
+static bool ParseBlockSizes( std::string_view List, std::vector<std::uint32_t>& BlockSizes )
+{
+    BlockSizes.clear();
+    while( List.empty() == false )
+    {
+        const auto             Comma = List.find( ',' );
+        const std::string_view Item  = List.substr( 0, Comma );
+        List = Comma == std::string_view::npos ? std::string_view{} : List.substr( Comma + 1 );
+
+        if( Item == "auto" )
+        {
+            BlockSizes.push_back( 0 );
+            continue;
+        }
+
+        char*                  pEnd;
+        const std::string      Text{ Item };
+        unsigned long long     Size = std::strtoull( Text.c_str(), &pEnd, 10 );
+        if( Size > 0xffffffffull ) return false;
+
+        if     ( *pEnd == 'K' || *pEnd == 'k' ) { Size *= 1024;        pEnd++; }
+        else if( *pEnd == 'M' || *pEnd == 'm' ) { Size *= 1024 * 1024; pEnd++; }
+
+        if( *pEnd || Size == 0 || Size > 0xffffffffull )
+            return false;
+
+        BlockSizes.push_back( static_cast<std::uint32_t>(Size) );
+    }
+
+    return BlockSizes.empty() == false;
+}
+
+//
+// Usage: xserializer_benchmark [--iterations=N] [--scale=X] [--threads=N] [--block-sizes=4K,64K,1M,auto] [--churn[=N]]
+//
+int main( int argc, const char* argv[] )
+{
+    xserializer::benchmark::settings Settings;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string_view Arg{ argv[i] };
+
+        if     ( Arg.starts_with("--iterations=") ) Settings.m_nIterations = static_cast<std::uint32_t>( std::max( 1, std::atoi( &argv[i][13] ) ) );
+        else if( Arg.starts_with("--scale=") )      Settings.m_Scale       = std::max( 0.0001, std::atof( &argv[i][8] ) );
+        else if( Arg.starts_with("--threads=") )    Settings.m_nThreads    = static_cast<std::uint32_t>( std::max( 1, std::atoi( &argv[i][10] ) ) );
+        else if( Arg.starts_with("--block-sizes=") && ParseBlockSizes( Arg.substr(14), Settings.m_BlockSizes ) ) {}
+        else if( Arg == "--churn" )                 Settings.m_nChurnCycles = 10000;
+        else if( Arg.starts_with("--churn=") )      Settings.m_nChurnCycles = static_cast<std::uint32_t>( std::max( 1, std::atoi( &argv[i][8] ) ) );
+        else
+        {
+            std::fprintf( stderr, "Usage: %s [--iterations=N] [--scale=X] [--threads=N] [--block-sizes=4K,64K,1M,auto] [--churn[=N]]\n", argv[0] );
+            return 1;
+        }
+    }
+
+    return xserializer::benchmark::Run( Settings );
+}
@@ -0,0 +1,652 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace xserializer::benchmark
+{
+    //----------------------------------------------------------------------------------
+    // Synthetic data shapes. Every shape is built once and saved at every level.
+    //----------------------------------------------------------------------------------
+    namespace shapes
+    {
+        //----------------------------------------------------------------------------------
+        // Big arrays of plain numbers (one copy per array when saving)
+        //----------------------------------------------------------------------------------
+        struct flat_arrays
+        {
+            constexpr static auto xserializer_version_v = 1;
+
+            std::uint64_t                   m_nFloats;
+            data_ptr<float>                 m_Floats;
+            std::uint64_t                   m_nIndices;
+            data_ptr<std::uint32_t>         m_Indices;
+        };
+
+        //----------------------------------------------------------------------------------
+        // Millions of tiny structures, each one pointing at its own value
+        //----------------------------------------------------------------------------------
+        struct tiny_node
+        {
+            std::uint32_t                   m_Value;
+            data_ptr<std::uint32_t>         m_pValue;
+        };
+
+        struct tiny_structs
+        {
+            constexpr static auto xserializer_version_v = 1;
+
+            std::uint64_t                   m_nNodes;
+            data_ptr<tiny_node>             m_Nodes;
+        };
+
+        //----------------------------------------------------------------------------------
+        // Binary tree, every level is a pointer deeper
+        //----------------------------------------------------------------------------------
+        struct tree_node
+        {
+            std::uint32_t                   m_Value;
+            std::uint32_t                   m_nChildren;
+            data_ptr<tree_node>             m_Children;
+        };
+
+        struct deep_tree
+        {
+            constexpr static auto xserializer_version_v = 1;
+
+            tree_node                       m_Root;
+        };
+
+        //----------------------------------------------------------------------------------
+        // Many small buffers that are unique, so each one is a pack (and an allocation)
+        //----------------------------------------------------------------------------------
+        struct unique_buffer
+        {
+            std::uint32_t                   m_Size;
+            data_ptr<std::byte>             m_Data;
+        };
+
+        struct unique_packs
+        {
+            constexpr static auto xserializer_version_v = 1;
+
+            std::uint64_t                   m_nBuffers;
+            data_ptr<unique_buffer>         m_Buffers;
+        };
+
+        //----------------------------------------------------------------------------------
+        // Random bytes, every block ends up stored raw
+        //----------------------------------------------------------------------------------
+        struct incompressible
+        {
+            constexpr static auto xserializer_version_v = 1;
+
+            std::uint64_t                   m_Size;
+            data_ptr<std::byte>             m_Data;
+        };
+    }
+}
+
+namespace xserializer::io_functions
+{
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::flat_arrays>(xserializer::stream& Stream, const xserializer::benchmark::shapes::flat_arrays& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_nFloats); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Floats.m_pValue, Data.m_nFloats); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_nIndices); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Indices.m_pValue, Data.m_nIndices); Err )
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::tiny_node>(xserializer::stream& Stream, const xserializer::benchmark::shapes::tiny_node& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_Value); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_pValue.m_pValue, 1); Err )
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::tiny_structs>(xserializer::stream& Stream, const xserializer::benchmark::shapes::tiny_structs& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_nNodes); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Nodes.m_pValue, Data.m_nNodes); Err )
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::tree_node>(xserializer::stream& Stream, const xserializer::benchmark::shapes::tree_node& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_Value); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_nChildren); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Children.m_pValue, Data.m_nChildren); Err )
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::deep_tree>(xserializer::stream& Stream, const xserializer::benchmark::shapes::deep_tree& Data) noexcept
+    {
+        return Stream.Serialize(Data.m_Root);
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::unique_buffer>(xserializer::stream& Stream, const xserializer::benchmark::shapes::unique_buffer& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_Size); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Data.m_pValue, Data.m_Size, xserializer::mem_type{ .m_bUnique = true }); Err )
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::unique_packs>(xserializer::stream& Stream, const xserializer::benchmark::shapes::unique_packs& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_nBuffers); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Buffers.m_pValue, Data.m_nBuffers); Err )
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::benchmark::shapes::incompressible>(xserializer::stream& Stream, const xserializer::benchmark::shapes::incompressible& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_Size); Err )
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Data.m_pValue, Data.m_Size); Err )
+            return Err;
+
+        return {};
+    }
+}
+
+//----------------------------------------------------------------------------------
+// The benchmark itself
+//----------------------------------------------------------------------------------
+namespace xserializer::benchmark
+{
+    struct settings
+    {
+        std::uint32_t                   m_nIterations   { 5 };
+        double                          m_Scale         { 1.0 };
+        std::uint32_t                   m_nThreads      { 1 };
+        std::vector<std::uint32_t>      m_BlockSizes    { 0 };      // Block sizes to save with (zero is the automatic one)
+        std::uint32_t                   m_nChurnCycles  { 0 };      // Load and unload cycles of the churn mode (zero runs the shapes)
+    };
+
+    //----------------------------------------------------------------------------------
+    // Owns the memory of a shape while it is being saved
+    //----------------------------------------------------------------------------------
+    template< class T >
+    struct shape_instance
+    {
+        T                                           m_Object    {};
+        std::vector<std::unique_ptr<std::byte[]>>   m_Memory    {};
+
+        template< class T_ELEMENT >
+        T_ELEMENT* Allocate( std::uint64_t Count ) noexcept
+        {
+            m_Memory.push_back( std::make_unique<std::byte[]>( std::max<std::uint64_t>( Count, 1 ) * sizeof(T_ELEMENT) ) );
+            return reinterpret_cast<T_ELEMENT*>( m_Memory.back().get() );
+        }
+    };
+
+    //----------------------------------------------------------------------------------
+    // Same sequence on every run so the results can be compared
+    //----------------------------------------------------------------------------------
+    struct random
+    {
+        std::uint64_t m_State { 0x9E3779B97F4A7C15ull };
+
+        std::uint64_t Next( void ) noexcept
+        {
+            m_State ^= m_State << 13;
+            m_State ^= m_State >> 7;
+            m_State ^= m_State << 17;
+            return m_State;
+        }
+    };
+
+    //----------------------------------------------------------------------------------
+
+    inline std::uint64_t Scaled( const settings& Settings, std::uint64_t Count ) noexcept
+    {
+        return std::max<std::uint64_t>( 1, static_cast<std::uint64_t>( Count * Settings.m_Scale ) );
+    }
+
+    //----------------------------------------------------------------------------------
+
+    inline void Build( shape_instance<shapes::flat_arrays>& Shape, const settings& Settings ) noexcept
+    {
+        auto& Object = Shape.m_Object;
+
+        Object.m_nFloats          = Scaled( Settings, 8 * 1024 * 1024 );
+        Object.m_Floats.m_pValue  = Shape.Allocate<float>( Object.m_nFloats );
+        for( std::uint64_t i = 0; i < Object.m_nFloats; ++i ) Object.m_Floats.m_pValue[i] = static_cast<float>(i % 4096) * 0.25f;
+
+        Object.m_nIndices         = Scaled( Settings, 2 * 1024 * 1024 );
+        Object.m_Indices.m_pValue = Shape.Allocate<std::uint32_t>( Object.m_nIndices );
+        for( std::uint64_t i = 0; i < Object.m_nIndices; ++i ) Object.m_Indices.m_pValue[i] = static_cast<std::uint32_t>( (i / 3) + (i % 3) );
+    }
+
+    //----------------------------------------------------------------------------------
+
+    inline void Build( shape_instance<shapes::tiny_structs>& Shape, const settings& Settings ) noexcept
+    {
+        auto& Object = Shape.m_Object;
+
+        Object.m_nNodes         = Scaled( Settings, 1024 * 1024 );
+        Object.m_Nodes.m_pValue = Shape.Allocate<shapes::tiny_node>( Object.m_nNodes );
+
+        auto const pValues = Shape.Allocate<std::uint32_t>( Object.m_nNodes );
+        for( std::uint64_t i = 0; i < Object.m_nNodes; ++i )
+        {
+            pValues[i]                                  = static_cast<std::uint32_t>(i * 7);
+            Object.m_Nodes.m_pValue[i].m_Value          = static_cast<std::uint32_t>(i);
+            Object.m_Nodes.m_pValue[i].m_pValue.m_pValue= &pValues[i];
+        }
+    }
+
+    //----------------------------------------------------------------------------------
+
+    inline void Build( shape_instance<shapes::deep_tree>& Shape, const settings& Settings ) noexcept
+    {
+        std::uint32_t Depth = 1;
+        while( (2ull << Depth) <= Scaled( Settings, 512 * 1024 ) ) Depth++;
+
+        std::uint32_t Value = 0;
+        auto Grow = [&]( auto& Self, shapes::tree_node& Node, std::uint32_t Level ) noexcept -> void
+        {
+            Node.m_Value     = Value++;
+            Node.m_nChildren = Level < Depth ? 2 : 0;
+            if( Node.m_nChildren == 0 )
+            {
+                Node.m_Children.m_pValue = nullptr;
+                return;
+            }
+
+            Node.m_Children.m_pValue = Shape.template Allocate<shapes::tree_node>( Node.m_nChildren );
+            for( std::uint32_t i = 0; i < Node.m_nChildren; ++i ) Self( Self, Node.m_Children.m_pValue[i], Level + 1 );
+        };
+
+        Grow( Grow, Shape.m_Object.m_Root, 1 );
+    }
+
+    //----------------------------------------------------------------------------------
+
+    inline void Build( shape_instance<shapes::unique_packs>& Shape, const settings& Settings ) noexcept
+    {
+        auto&  Object = Shape.m_Object;
+        random Random;
+
+        Object.m_nBuffers         = Scaled( Settings, 2048 );
+        Object.m_Buffers.m_pValue = Shape.Allocate<shapes::unique_buffer>( Object.m_nBuffers );
+        for( std::uint64_t i = 0; i < Object.m_nBuffers; ++i )
+        {
+            auto& Buffer = Object.m_Buffers.m_pValue[i];
+            Buffer.m_Size           = 1024 + static_cast<std::uint32_t>( Random.Next() % (7 * 1024) );
+            Buffer.m_Data.m_pValue  = Shape.Allocate<std::byte>( Buffer.m_Size );
+            for( std::uint32_t j = 0; j < Buffer.m_Size; ++j ) Buffer.m_Data.m_pValue[j] = static_cast<std::byte>( (j / 16) ^ i );
+        }
+    }
+
+    //----------------------------------------------------------------------------------
+
+    inline void Build( shape_instance<shapes::incompressible>& Shape, const settings& Settings ) noexcept
+    {
+        auto&  Object = Shape.m_Object;
+        random Random;
+
+        Object.m_Size           = Scaled( Settings, 32 * 1024 * 1024 ) & ~std::uint64_t{ 7 };
+        Object.m_Data.m_pValue  = Shape.Allocate<std::byte>( Object.m_Size );
+        for( std::uint64_t i = 0; i < Object.m_Size; i += 8 )
+        {
+            const std::uint64_t V = Random.Next();
+            std::memcpy( &Object.m_Data.m_pValue[i], &V, sizeof(V) );
+        }
+    }
+
+    //----------------------------------------------------------------------------------
+    // Times of every iteration of one operation
+    //----------------------------------------------------------------------------------
+    struct samples
+    {
+        std::vector<double>             m_Microseconds  {};
+
+        template< typename T_FUNCTION >
+        bool Measure( T_FUNCTION&& Function ) noexcept
+        {
+            const auto Start = std::chrono::steady_clock::now();
+            const bool bOk   = Function();
+            const auto End   = std::chrono::steady_clock::now();
+
+            m_Microseconds.push_back( std::chrono::duration<double, std::micro>( End - Start ).count() );
+            return bOk;
+        }
+
+        double Percentile( double P ) noexcept
+        {
+            std::sort( m_Microseconds.begin(), m_Microseconds.end() );
+            return m_Microseconds[ static_cast<std::size_t>( P * (m_Microseconds.size() - 1) + 0.5 ) ];
+        }
+    };
+
+    //----------------------------------------------------------------------------------
+    // Block sizes as they are written on the command line (4K, 64K, 1M or auto)
+    //----------------------------------------------------------------------------------
+    inline std::string BlockSizeName( std::uint32_t BlockSize ) noexcept
+    {
+        if( BlockSize == 0 )                  return "auto";
+        if( (BlockSize % (1024 * 1024)) == 0 ) return std::to_string( BlockSize / (1024 * 1024) ) + "M";
+        if( (BlockSize % 1024) == 0 )          return std::to_string( BlockSize / 1024 ) + "K";
+        return std::to_string( BlockSize );
+    }
+
+    //----------------------------------------------------------------------------------
+    // One JSON object per line so the output can be parsed (or diffed) easily.
+    // The ratio is the bytes of data over the bytes of the file.
+    //----------------------------------------------------------------------------------
+    inline void Report( std::string_view Shape, std::string_view Level, std::string_view BlockSize, std::string_view Operation, std::uint64_t Bytes, std::uint64_t FileBytes, samples& Samples ) noexcept
+    {
+        const double P50   = Samples.Percentile( 0.5 );
+        const double MBs   = (Bytes && P50 > 0) ? (Bytes / (1024.0 * 1024.0)) / (P50 / 1000000.0) : 0;
+        const double Ratio = FileBytes ? static_cast<double>(Bytes) / static_cast<double>(FileBytes) : 0;
+
+        std::printf( "{\"shape\":\"%.*s\",\"level\":\"%.*s\",\"block_size\":\"%.*s\",\"op\":\"%.*s\",\"iterations\":%zu,\"bytes\":%llu,\"file_bytes\":%llu"
+                     ",\"ratio\":%.3f,\"mb_per_s\":%.2f,\"p50_us\":%.2f,\"p90_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f}\n"
+                   , static_cast<int>(Shape.size()),     Shape.data()
+                   , static_cast<int>(Level.size()),     Level.data()
+                   , static_cast<int>(BlockSize.size()), BlockSize.data()
+                   , static_cast<int>(Operation.size()), Operation.data()
+                   , Samples.m_Microseconds.size()
+                   , static_cast<unsigned long long>(Bytes)
+                   , static_cast<unsigned long long>(FileBytes)
+                   , Ratio, MBs, P50, Samples.Percentile( 0.9 ), Samples.Percentile( 0.99 ), Samples.Percentile( 1.0 ) );
+        std::fflush( stdout );
+    }
+
+    //----------------------------------------------------------------------------------
+    // Saves and loads a shape at every compression level and block size (stored files
+    // have no blocks so they are only done once). Loads come from memory and
+    // go into an arena so only the serializer is measured (no disk, no heap frees).
+    // Pointer fixup is measured by resolving the stored file in place (LoadMappedObject),
+    // which does nothing else.
+    //----------------------------------------------------------------------------------
+    template< class T >
+    bool RunShape( std::string_view Name, const settings& Settings ) noexcept
+    {
+        constexpr static std::array<std::pair<compression_level, std::string_view>, 5> Levels
+        {{ { compression_level::STORE,  "STORE"  }
+         , { compression_level::FAST,   "FAST"   }
+         , { compression_level::LOW,    "LOW"    }
+         , { compression_level::MEDIUM, "MEDIUM" }
+         , { compression_level::HIGH,   "HIGH"   }
+        }};
+
+        auto Shape = std::make_unique<shape_instance<T>>();
+        Build( *Shape, Settings );
+
+        for( auto& [ Level, LevelName ] : Levels )
+        for( std::size_t iBlockSize = 0; iBlockSize < Settings.m_BlockSizes.size(); ++iBlockSize )
+        {
+            const std::uint32_t     BlockSize     = Settings.m_BlockSizes[iBlockSize];
+            const std::string       BlockSizeText = Level == compression_level::STORE ? "none" : BlockSizeName( BlockSize );
+            std::vector<std::byte>  Buffer;
+            samples                 Save, Header, Load;
+
+            if( Level == compression_level::STORE && iBlockSize > 0 )
+                continue;
+
+            for( std::uint32_t i = 0; i < Settings.m_nIterations; ++i )
+            {
+                xserializer::stream Stream;
+                Stream.setThreadCount( Settings.m_nThreads );
+                Stream.setBlockSize( BlockSize );
+
+                Buffer.clear();
+                if( Save.Measure( [&]{ return !Stream.Save( Buffer, Shape->m_Object, Level ); } ) == false )
+                    return false;
+            }
+
+            // How much memory the packs take is the amount of data that goes through the serializer
+            memory_requirements Requirements;
+            {
+                xserializer::stream Stream;
+                if( Stream.LoadHeader( Buffer, sizeof(T) ) || Stream.LoadRequirements( Buffer, Requirements ) )
+                    return false;
+            }
+
+            std::uint64_t Bytes = 0;
+            for( auto Size : Requirements.m_Size ) Bytes += Size;
+
+            arena_memory_handler Arena;
+            for( std::uint32_t i = 0; i < Settings.m_nIterations; ++i )
+            {
+                xserializer::stream Stream{ Arena };
+                Stream.setThreadCount( Settings.m_nThreads );
+
+                if( Header.Measure( [&]{ return !Stream.LoadHeader( Buffer, sizeof(T) ); } ) == false )
+                    return false;
+
+                if( Load.Measure( [&]{ return Stream.LoadObject( Buffer ) != nullptr; } ) == false )
+                    return false;
+
+                Arena.Reset();
+            }
+
+            Report( Name, LevelName, BlockSizeText, "Save",       Bytes, Buffer.size(), Save   );
+            Report( Name, LevelName, BlockSizeText, "LoadHeader", 0,     Buffer.size(), Header );
+            Report( Name, LevelName, BlockSizeText, "LoadObject", Bytes, Buffer.size(), Load   );
+
+            // Resolving in place needs the stored layout
+            if( Level == compression_level::STORE )
+            {
+                samples                 Fixup;
+                std::vector<std::byte>  View;
+                for( std::uint32_t i = 0; i < Settings.m_nIterations; ++i )
+                {
+                    // Pointers are resolved in place so every iteration needs the stored bytes
+                    View = Buffer;
+
+                    xserializer::stream Stream;
+                    if( Stream.LoadHeader( View, sizeof(T) ) )
+                        return false;
+
+                    if( Fixup.Measure( [&]{ return Stream.LoadMappedObject( View ) != nullptr; } ) == false )
+                        return false;
+                }
+
+                Report( Name, LevelName, BlockSizeText, "Fixup", Bytes, Buffer.size(), Fixup );
+            }
+        }
+
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------
+    // Churn mode: keeps a few resources alive, loading a random one over the oldest every
+    // cycle. The resources have 2 to 7 unique packs of 32 bytes to 1.5MB, so the memory
+    // handler sees the mixed sizes of a game streaming its levels. Each cycle is timed
+    // with the unload of the resource it replaces.
+    //----------------------------------------------------------------------------------
+    constexpr static std::size_t churn_slots_v = 8;
+
+    template< typename T_GET_HANDLER, typename T_UNLOAD >
+    bool Churn( std::string_view HandlerName, const std::vector<std::vector<std::byte>>& Files, std::uint64_t Bytes, std::uint64_t FileBytes, const settings& Settings, T_GET_HANDLER&& getHandler, T_UNLOAD&& Unload ) noexcept
+    {
+        std::array<shapes::unique_packs*, churn_slots_v>    Slots   {};
+        random                                              Random;
+        samples                                             Cycles;
+
+        for( std::uint32_t i = 0; i < Settings.m_nChurnCycles; ++i )
+        {
+            const std::size_t   iSlot = i % churn_slots_v;
+            const auto&         File  = Files[ Random.Next() % Files.size() ];
+
+            const bool bOk = Cycles.Measure( [&]
+            {
+                if( Slots[iSlot] ) Unload( iSlot, *Slots[iSlot] );
+
+                xserializer::stream Stream{ getHandler( iSlot ) };
+                Stream.setThreadCount( Settings.m_nThreads );
+
+                Slots[iSlot] = nullptr;
+                if( Stream.LoadHeader( File, sizeof(shapes::unique_packs) ) )
+                    return false;
+
+                Slots[iSlot] = reinterpret_cast<shapes::unique_packs*>( Stream.LoadObject( File ) );
+                return Slots[iSlot] != nullptr;
+            });
+
+            if( bOk == false )
+                return false;
+        }
+
+        for( std::size_t iSlot = 0; iSlot < churn_slots_v; ++iSlot )
+        {
+            if( Slots[iSlot] ) Unload( iSlot, *Slots[iSlot] );
+        }
+
+        std::string Operation = "LoadUnload/";
+        Operation += HandlerName;
+        Report( "churn", "FAST", "auto", Operation, Bytes, FileBytes, Cycles );
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------
+    // Runs the churn with the default handler, a pool and an arena per slot over a pool
+    //----------------------------------------------------------------------------------
+    inline bool RunChurn( const settings& Settings ) noexcept
+    {
+        constexpr static std::size_t        num_resources_v = 16;
+        std::vector<std::vector<std::byte>> Files( num_resources_v );
+        std::uint64_t                       Bytes       = 0;
+        std::uint64_t                       FileBytes   = 0;
+        random                              Random;
+
+        for( auto& File : Files )
+        {
+            shape_instance<shapes::unique_packs> Shape;
+            auto&                                Object = Shape.m_Object;
+
+            Object.m_nBuffers         = 2 + Random.Next() % 6;
+            Object.m_Buffers.m_pValue = Shape.Allocate<shapes::unique_buffer>( Object.m_nBuffers );
+            for( std::uint64_t i = 0; i < Object.m_nBuffers; ++i )
+            {
+                // Small sizes are as likely as big ones
+                auto&               Buffer = Object.m_Buffers.m_pValue[i];
+                const std::uint32_t Range  = (3 * 512 * 1024) >> (Random.Next() % 16);
+                Buffer.m_Size           = 32 + static_cast<std::uint32_t>( Random.Next() % Range );
+                Buffer.m_Data.m_pValue  = Shape.Allocate<std::byte>( Buffer.m_Size );
+                for( std::uint32_t j = 0; j < Buffer.m_Size; ++j ) Buffer.m_Data.m_pValue[j] = static_cast<std::byte>( (j / 16) ^ i );
+                Bytes += Buffer.m_Size;
+            }
+
+            xserializer::stream Stream;
+            if( Stream.Save( File, Object, compression_level::FAST ) )
+                return false;
+
+            FileBytes += File.size();
+        }
+
+        // Reported per cycle
+        Bytes     /= num_resources_v;
+        FileBytes /= num_resources_v;
+
+        // Without an arena every pack is freed one by one (the root pack holds the rest)
+        auto FreePacks = []( const memory_handle_base& Handler, shapes::unique_packs& Object ) noexcept
+        {
+            for( std::uint64_t i = 0; i < Object.m_nBuffers; ++i )
+                Handler.Free( mem_type{ .m_bUnique = true }, Object.m_Buffers.m_pValue[i].m_Data.m_pValue );
+            Handler.Free( mem_type{}, &Object );
+        };
+
+        bool bOk = Churn( "default", Files, Bytes, FileBytes, Settings
+                        , []( std::size_t ) noexcept -> const memory_handle_base& { return default_memory_handler_v; }
+                        , [&]( std::size_t, shapes::unique_packs& Object ) noexcept { FreePacks( default_memory_handler_v, Object ); } );
+
+        {
+            pool_memory_handler Pool;
+            bOk = bOk && Churn( "pool", Files, Bytes, FileBytes, Settings
+                              , [&]( std::size_t ) noexcept -> const memory_handle_base& { return Pool; }
+                              , [&]( std::size_t, shapes::unique_packs& Object ) noexcept { FreePacks( Pool, Object ); } );
+        }
+
+        {
+            pool_memory_handler                                 Pool;
+            std::vector<std::unique_ptr<arena_memory_handler>>  Arenas;
+            for( std::size_t i = 0; i < churn_slots_v; ++i ) Arenas.push_back( std::make_unique<arena_memory_handler>( Pool ) );
+
+            bOk = bOk && Churn( "arena_over_pool", Files, Bytes, FileBytes, Settings
+                              , [&]( std::size_t iSlot ) noexcept -> const memory_handle_base& { return *Arenas[iSlot]; }
+                              , [&]( std::size_t iSlot, shapes::unique_packs& ) noexcept { Arenas[iSlot]->Reset(); } );
+        }
+
+        return bOk;
+    }
+
+    //----------------------------------------------------------------------------------
+
+    inline int Run( const settings& Settings ) noexcept
+    {
+        bool bOk = true;
+
+        if( Settings.m_nChurnCycles )
+        {
+            bOk = RunChurn( Settings );
+        }
+        else
+        {
+            bOk = bOk && RunShape<shapes::flat_arrays>    ( "flat_arrays",     Settings );
+            bOk = bOk && RunShape<shapes::tiny_structs>   ( "tiny_structs",    Settings );
+            bOk = bOk && RunShape<shapes::deep_tree>      ( "deep_tree",       Settings );
+            bOk = bOk && RunShape<shapes::unique_packs>   ( "unique_packs",    Settings );
+            bOk = bOk && RunShape<shapes::incompressible> ( "incompressible",  Settings );
+        }
+
+        if( bOk == false )
+        {
+            std::fprintf( stderr, "ERROR: A save or a load failed\n" );
+            return 1;
+        }
+
+        return 0;
+    }
+}
@@ -60,6 +60,76 @@ namespace xserializer
         template<class T>
         constexpr static bool has_serialization_v = is_detected_exact_v<xerr, has_serialization, T>;
 
+        //--------------------------------------------------------------------------------------------
+        // Determine if the memory of a type can be written as it is (see xserializer::is_trivially_serializable)
+        //--------------------------------------------------------------------------------------------
+        namespace details
+        {
+            template< class T, class = void >
+            struct trivial_marker : std::false_type {};
+
+            template< class T >
+            struct trivial_marker<T, std::void_t<decltype(T::xserializer_trivial_v)>> : std::bool_constant<T::xserializer_trivial_v> {};
+
+            template< class T >
+            struct is_trivially_serializable : std::bool_constant
+            <   std::is_integral_v<T>
+            ||  std::is_floating_point_v<T>
+            ||  std::is_enum_v<T>
+            ||  ( std::is_trivially_copyable_v<T> && (xserializer::is_trivially_serializable<T>::value || trivial_marker<T>::value) )
+            > {};
+
+            template< class T, std::size_t N >
+            struct is_trivially_serializable<T[N]> : is_trivially_serializable<T> {};
+
+            template< class T, std::size_t N >
+            struct is_trivially_serializable<std::array<T, N>> : is_trivially_serializable<T> {};
+
+            template<class T> struct is_trivially_serializable<T const> : is_trivially_serializable<T> {};
+        }
+
+        template< typename T >
+        constexpr static bool is_trivially_serializable_v = details::is_trivially_serializable<T>::value;
+
+        //--------------------------------------------------------------------------------------------
+        // Trivially serializable structures that have a SerializeIO to be swapped member by member.
+        // It has to be said explicitly since SerializeIO is declared for every type.
+        //--------------------------------------------------------------------------------------------
+        namespace details
+        {
+            template< class T, class = void >
+            struct swap_members_marker : std::false_type {};
+
+            template< class T >
+            struct swap_members_marker<T, std::void_t<decltype(T::xserializer_swap_members_v)>> : std::bool_constant<T::xserializer_swap_members_v> {};
+
+            template<class T> struct swap_members_marker<T const> : swap_members_marker<T> {};
+        }
+
+        template< typename T >
+        constexpr static bool can_swap_members_v = is_trivially_serializable_v<T> == false || details::swap_members_marker<T>::value;
+
+        //--------------------------------------------------------------------------------------------
+        // Size of the words that must be byte swapped when saving with a different endian. Zero means
+        // that the type is a structure so it can only be swapped member by member.
+        //--------------------------------------------------------------------------------------------
+        namespace details
+        {
+            template< class T >
+            struct swap_size : std::integral_constant< std::size_t, (std::is_arithmetic_v<T> || std::is_enum_v<T>) ? sizeof(T) : 0 > {};
+
+            template< class T, std::size_t N >
+            struct swap_size<T[N]> : swap_size<T> {};
+
+            template< class T, std::size_t N >
+            struct swap_size<std::array<T, N>> : swap_size<T> {};
+
+            template<class T> struct swap_size<T const> : swap_size<T> {};
+        }
+
+        template< typename T >
+        constexpr static std::size_t swap_size_v = details::swap_size<T>::value;
+
         //--------------------------------------------------------------------------------------------
         // Determine if a type is an array will return true if it is a C array or an object of type array 
         //--------------------------------------------------------------------------------------------
@@ -121,10 +191,111 @@ namespace xserializer
     //------------------------------------------------------------------------------
 
     inline
-    xfile::stream& stream::getW(void) noexcept
+    stream::pack_writing& stream::getW(void) noexcept
     {
         assert(m_pWrite);
-        return m_pWrite->m_Packs[m_iPack].m_Data;
+        return m_pWrite->m_Packs[m_iPack];
+    }
+
+    //------------------------------------------------------------------------------
+    // Plain store at a given offset, it only grows the buffer when writing pass the end.
+    // The copy gets swapped in words of SwapSize bytes (the user data is never touched).
+    //------------------------------------------------------------------------------
+    inline
+    void stream::pack_writing::Write(std::size_t Offset, const std::span<const std::byte> View, std::size_t SwapSize) noexcept
+    {
+        if( m_bStreaming )
+        {
+            WriteBlocks( Offset, View, SwapSize );
+        }
+        else
+        {
+            if( (Offset + View.size()) > m_Data.size() ) 
+                m_Data.resize( Offset + View.size() );
+
+            std::memcpy( &m_Data[Offset], View.data(), View.size() );
+
+            if( SwapSize > 1 )
+                SwapBytes( std::span{ &m_Data[Offset], View.size() }, SwapSize );
+        }
+
+        m_Position = Offset + View.size();
+    }
+
+    //------------------------------------------------------------------------------
+    // Adds zeroed space at the end of the pack and moves the position to the beginning of it
+    //------------------------------------------------------------------------------
+    inline
+    std::size_t stream::pack_writing::Reserve(std::size_t Size, std::size_t Alignment) noexcept
+    {
+        assert( Alignment && (Alignment & (Alignment - 1)) == 0 );
+
+        // Streamed blocks only get memory when they are written to
+        if( m_bStreaming )
+        {
+            m_Position   = (m_StreamSize + Alignment - 1) & ~(Alignment - 1);
+            m_StreamSize = m_Position + Size;
+
+            const std::size_t nBlocks = static_cast<std::size_t>( (m_StreamSize + m_BlockSize - 1) / m_BlockSize );
+            if( nBlocks > m_StreamBlocks.size() ) 
+                m_StreamBlocks.resize(nBlocks);
+
+            return m_Position;
+        }
+
+        m_Position = (m_Data.size() + Alignment - 1) & ~(Alignment - 1);
+
+        // Grow by doubling so that many small reservations stay cheap
+        const std::size_t NewSize = m_Position + Size;
+        if( NewSize > m_Data.capacity() ) 
+            m_Data.reserve( std::max( NewSize, m_Data.capacity() * 2 ) );
+
+        m_Data.resize(NewSize);
+        return m_Position;
+    }
+
+    //------------------------------------------------------------------------------
+    // Size of the blocks used to compress this pack, packs smaller than a block are a single block
+    //------------------------------------------------------------------------------
+    constexpr
+    std::uint32_t stream::pack::getBlockSize(void) const noexcept
+    {
+        const std::int32_t  Shift     = m_Format.m_BlockSizeShift;
+        const std::uint32_t BlockSize = Shift >= 0 ? default_block_size_v << Shift : default_block_size_v >> -Shift;
+        return static_cast<std::uint32_t>(std::min<std::uint64_t>(BlockSize, m_UncompressSize));
+    }
+
+    //------------------------------------------------------------------------------
+    // Makes the data at the current position of the pack the new class, this is how 
+    // structures that live outside the current class (pointed to) get written.
+    //------------------------------------------------------------------------------
+    template< typename T_FUNCTION > inline
+    xerr stream::SerializeNonLocal(const std::byte* pData, std::size_t Size, T_FUNCTION&& Function) noexcept
+    {
+        const auto BackupClassPos  = m_ClassPos;
+        const auto pBackupClass    = m_pClass;
+        const auto BackupClassSize = m_ClassSize;
+
+        m_ClassPos  = getW().m_Position;
+        m_pClass    = const_cast<std::byte*>(pData);
+        m_ClassSize = static_cast<std::uint32_t>(Size);
+
+        // A streaming save can't flush the structure until all its members are written
+        const bool        bStreaming = isStreaming();
+        const std::size_t iPin       = bStreaming ? PushPin( m_ClassPos, m_ClassPos + Size ) : 0;
+
+        auto Err = Function();
+
+        if( bStreaming ) PopPin(iPin);
+
+        // Go the end of the structure 
+        getW().m_Position = m_ClassPos + m_ClassSize;
+
+        m_ClassPos  = BackupClassPos;
+        m_pClass    = pBackupClass;
+        m_ClassSize = BackupClassSize;
+
+        return Err;
     }
 
     //------------------------------------------------------------------------------
@@ -170,6 +341,32 @@ namespace xserializer
 
     template< class T > inline
     xerr stream::Save( xfile::stream& File, const T& Object, compression_level CompressionLevel, mem_type ObjectFlags, bool bSwapEndian) noexcept
+    {
+        return SaveObject( File, Object, CompressionLevel, ObjectFlags, bSwapEndian );
+    }
+
+    //------------------------------------------------------------------------------
+    // The resource is added at the end of the buffer
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    xerr stream::Save( std::vector<std::byte>& Buffer, const T& Object, compression_level CompressionLevel, mem_type ObjectFlags, bool bSwapEndian) noexcept
+    {
+        return SaveObject( Buffer, Object, CompressionLevel, ObjectFlags, bSwapEndian );
+    }
+
+    //------------------------------------------------------------------------------
+    // The target only has to append, with setStreamingSave it can be a pipe or a socket
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    xerr stream::Save( details::save_target& Target, const T& Object, compression_level CompressionLevel, mem_type ObjectFlags, bool bSwapEndian) noexcept
+    {
+        return SaveObject( Target, Object, CompressionLevel, ObjectFlags, bSwapEndian );
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T, class T_TARGET > inline
+    xerr stream::SaveObject( T_TARGET& Target, const T& Object, compression_level CompressionLevel, mem_type ObjectFlags, bool bSwapEndian) noexcept
     {
         //
         // Allocate the writing structure
@@ -185,29 +382,43 @@ namespace xserializer
         // but we keep the owner
         m_pWrite = Write.get();
 
-        // back up the pointer
-        Write->m_pFile = &File;
-
         //
         // Initialize class members
         //
-        m_iPack             = Write->AllocatePack(ObjectFlags);
         m_ClassPos          = 0;
         m_CompressionLevel  = CompressionLevel;
         m_pClass            = const_cast<std::byte*>(reinterpret_cast<const std::byte*>(&Object));
         m_ClassSize         = sizeof(Object);
         Write->m_bEndian = bSwapEndian;
 
-        // Save the initial class
-        if ( auto Err = getW().putC(' ', m_ClassSize, true); Err ) 
+        //
+        // Streaming saves write the blocks while serializing
+        //
+        if( m_bStreamingSave )
+        {
+            auto Err = SaveStreamed( Target, ObjectFlags, &Object, []( stream& Stream, const void* pObject ) noexcept
+            {
+                return xserializer::io_functions::SerializeIO( Stream, *static_cast<const T*>(pObject) );
+            });
+
+            m_pWrite = nullptr;
             return Err;
+        }
+
+        m_iPack = Write->AllocatePack(ObjectFlags, 0, m_Codec);
+
+        // Save the initial class
+        getW().Reserve(m_ClassSize, 8);
 
         // Start the saving 
-        if( auto Err = xserializer::io_functions::SerializeIO(*this, Object); Err ) 
-            return Err;
+        {
+            details::stats_scope Scope{ m_pStats, stats::stage::SAVE_SERIALIZE };
+            if( auto Err = xserializer::io_functions::SerializeIO(*this, Object); Err ) 
+                return Err;
+        }
 
         // Save the file
-        if ( auto Err = SaveFile(); Err ) 
+        if ( auto Err = SaveFile(Target); Err ) 
             return Err;
 
         // clean up
@@ -224,12 +435,27 @@ namespace xserializer
         // Reading or writing?
         assert(m_pWrite);
 
-        if constexpr (  std::is_integral_v<T>
-            ||          std::is_floating_point_v<T>
-            ||          std::is_enum_v<T>)
+        if constexpr ( details::is_trivially_serializable_v<T> )
         {
-            if ( auto Err = Handle(std::span<const std::byte>{&reinterpret_cast<const std::byte&>(A), sizeof(T)}); Err ) 
-                return Err;
+            // Structures can't be swapped as a blob
+            if constexpr ( details::swap_size_v<T> == 0 )
+            {
+                if ( SwapEndian() ) 
+                    return SerializeMembers(A);
+            }
+
+            // Atomic types, trivially serializable structures and arrays of them go in a single copy
+            const std::span<const std::byte> View{&reinterpret_cast<const std::byte&>(A), sizeof(T)};
+
+            if (isLocalVariable(View.data()))
+            {
+                if ( auto Err = Handle(View, details::swap_size_v<T>); Err ) 
+                    return Err;
+            }
+            else
+            {
+                return SerializeNonLocal( View.data(), View.size(), [&]{ return Handle(View, details::swap_size_v<T>); });
+            }
         }
         else if constexpr (std::is_array_v<T>)
         {
@@ -243,43 +469,38 @@ namespace xserializer
         else if constexpr (details::is_array_v<T> || details::is_span_v<T>)
         {
             static_assert(std::is_object_v<T>);
-            for (auto& X : A) 
-            {
-                if ( auto Err = Serialize(X); Err ) 
-                    return Err;
-            }
-        }
-        else if constexpr (details::has_serialization_v<T>)
-        {
-            static_assert(std::is_object_v<T>);
-            static_assert(false == std::is_polymorphic_v<T>);
 
-            if (isLocalVariable(reinterpret_cast<const std::byte*>(&A)))
+            // Spans of trivially serializable types go in a single copy
+            constexpr bool bBulk = []
             {
-                //return Handle(std::span{ reinterpret_cast<const std::byte*>(&A), sizeof(T) });
-                return xserializer::io_functions::SerializeIO(*this, A);
-            }
-            else
+                if constexpr (details::is_span_v<T>) return details::is_trivially_serializable_v<typename T::element_type>;
+                else                                 return false;
+            }();
+
+            if constexpr (bBulk)
             {
-                // Copy most of the data
-                stream File(*this);
+                constexpr auto SwapSize = details::swap_size_v<typename T::element_type>;
 
-                std::size_t Offset;
-                if (auto Err = getW().Tell(Offset); Err)
-                    return Err;
+                // Structures that need swapping go one at a time
+                if ( SwapSize || SwapEndian() == false )
+                {
+                    if (A.empty()) 
+                        return {};
 
-                File.m_iPack        = m_iPack;
-                File.m_ClassPos     = static_cast<std::uint32_t>(Offset);
-                File.m_pClass       = &const_cast<std::byte&>(reinterpret_cast<const std::byte&>(A));
-                File.m_ClassSize    = sizeof(A);
+                    return Handle(std::as_bytes(A), SwapSize);
+                }
+            }
 
-                if ( auto Err = xserializer::io_functions::SerializeIO(File, A); Err ) 
+            for (auto& X : A) 
+            {
+                if ( auto Err = Serialize(X); Err ) 
                     return Err;
-
-                // Go the end of the structure 
-                return getW().SeekOrigin( File.m_ClassPos + File.m_ClassSize );
             }
         }
+        else if constexpr (details::has_serialization_v<T>)
+        {
+            return SerializeMembers(A);
+        }
         else if constexpr (std::is_trivially_copyable_v<T>)
         {
             /*
@@ -291,6 +512,9 @@ namespace xserializer
             || std::is_same<T, vector4>
             || std::is_same<T, quaternion>
             */
+            if ( SwapEndian() )
+                return xerr::create<state::FAILURE, "Only trivially serializable types or types with a SerializeIO can be endian swapped">();
+
             if ( auto Err = Handle(std::span<const std::byte>{ &reinterpret_cast<const std::byte&>(A), sizeof(T) }); Err ) 
                 return Err;
         }
@@ -302,10 +526,52 @@ namespace xserializer
         return {};
     }
 
+    //------------------------------------------------------------------------------
+    // Serializes an object with its SerializeIO, this is also how trivially serializable
+    // structures (or arrays of them) get swapped when the endian is different
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::SerializeMembers(const T& A) noexcept
+    {
+        if constexpr (details::is_array_v<T>)
+        {
+            for (auto& X : A) 
+            {
+                if ( auto Err = Serialize(X); Err ) 
+                    return Err;
+            }
+
+            return {};
+        }
+        else if constexpr (details::has_serialization_v<T> && details::can_swap_members_v<T>)
+        {
+            static_assert(std::is_object_v<T>);
+            static_assert(false == std::is_polymorphic_v<T>);
+
+            if (isLocalVariable(reinterpret_cast<const std::byte*>(&A)))
+            {
+                //return Handle(std::span{ reinterpret_cast<const std::byte*>(&A), sizeof(T) });
+                return xserializer::io_functions::SerializeIO(*this, A);
+            }
+            else
+            {
+                return SerializeNonLocal( reinterpret_cast<const std::byte*>(&A), sizeof(A), [&]
+                {
+                    return xserializer::io_functions::SerializeIO(*this, A);
+                });
+            }
+        }
+        else
+        {
+            return xerr::create<state::FAILURE, "Trivially serializable structures need a SerializeIO and xserializer_swap_members_v to be endian swapped">();
+        }
+    }
+
     //------------------------------------------------------------------------------
 
     template< class T, typename T_SIZE  > inline
-    xerr stream::Serialize(T* const& pView, T_SIZE Size, mem_type MemoryFlags) noexcept
+    xerr stream::Serialize(T* const& pView, T_SIZE Size, mem_type MemoryFlags, std::uint8_t Quality, codec_id Codec) noexcept
     {
         if (pView == nullptr)
         {
@@ -322,49 +588,94 @@ namespace xserializer
             , sizeof(T)
             , Size
             , MemoryFlags
+            , Quality
+            , Codec
         ); Err ) return Err;
 
+        const std::uint64_t DataPos = getW().m_Position;
+        const std::size_t   nRefs   = m_pWrite->m_PointerTable.size();
+        const std::size_t   nPacks  = m_pWrite->m_Packs.size();
+
         //
         // Loop throw all the items
         //
-        using of_type_t = details::decay_full_t<decltype(pView[0])>;
+        if (auto Err = SerializeElements(pView, static_cast<std::uint64_t>(Size)); Err)
+            return Err;
 
-        // Short-cut
-        if constexpr (std::is_integral_v<of_type_t>
-                   || std::is_floating_point_v<of_type_t>
-                   || std::is_enum_v<of_type_t>)
-        {
-            if (isLocalVariable(reinterpret_cast<const std::byte*>(&pView[0])))
-            {
-                if (auto Err = Handle(std::span<const std::byte>{reinterpret_cast<const std::byte*>(&pView[0]), sizeof(of_type_t)* Size }); Err )
-                    return Err;
-            }
-            else
-            {
-                // Copy most of the data
-                stream File(*this);
+        //
+        // Only buffers without pointers can be shared, two copies could point at different things
+        //
+        if ( m_bDeduplicate && Size && nRefs == m_pWrite->m_PointerTable.size() && nPacks == m_pWrite->m_Packs.size() )
+            DeduplicatePointer( DataPos, sizeof(T) * static_cast<std::uint64_t>(Size) );
 
-                std::size_t Offset;
-                if (auto Err = getW().Tell(Offset); Err)
-                    return Err;
+        //
+        // Restore the old pack
+        //
+        m_iPack = BackupPackIndex;
+        return {};
+    }
 
-                const std::span NewView{ reinterpret_cast<const std::byte*>(&pView[0]), sizeof(of_type_t) * Size };
+    //------------------------------------------------------------------------------
+    // Writes the items that a pointer points to, the file must be already at the 
+    // position where the first item goes
+    //------------------------------------------------------------------------------
 
-                File.m_iPack        = m_iPack;
-                File.m_ClassPos     = static_cast<std::uint32_t>(Offset);
-                File.m_pClass       = &const_cast<std::byte&>(reinterpret_cast<const std::byte&>(NewView[0]));
-                File.m_ClassSize    = static_cast<std::uint32_t>(NewView.size());
+    template< class T > inline
+    xerr stream::SerializeElements(const T* pView, std::uint64_t Size) noexcept
+    {
+        using of_type_t = details::decay_full_t<decltype(pView[0])>;
 
-                if (auto Err = File.Handle(NewView); Err)
-                    return Err;
+        // Short-cut, the whole array goes as a single copy (unless it is made of structures that need swapping)
+        if constexpr (details::is_trivially_serializable_v<of_type_t>)
+        {
+            constexpr auto SwapSize = details::swap_size_v<of_type_t>;
 
-                // Go the end of the structure 
-                if (auto Err = getW().SeekOrigin( File.m_ClassPos + File.m_ClassSize ); Err)
-                    return Err;
+            if ( SwapSize || SwapEndian() == false )
+            {
+                if (isLocalVariable(reinterpret_cast<const std::byte*>(&pView[0])))
+                {
+                    if (auto Err = Handle(std::span<const std::byte>{reinterpret_cast<const std::byte*>(&pView[0]), sizeof(of_type_t)* Size }, SwapSize); Err )
+                        return Err;
+                }
+                else if( isStreaming() )
+                {
+                    // Big arrays go a few elements at a time so only the blocks that are not done stay in memory
+                    const std::span     NewView{ reinterpret_cast<const std::byte*>(&pView[0]), sizeof(of_type_t) * Size };
+                    const std::size_t   ChunkSize = std::max<std::size_t>( m_pWrite->m_StreamBlockSize / sizeof(of_type_t), 1 ) * sizeof(of_type_t);
+                    const std::uint64_t Start     = getW().m_Position;
+                    const std::size_t   iPin      = PushPin( Start, Start + NewView.size() );
+
+                    for( std::size_t Done = 0; Done < NewView.size(); )
+                    {
+                        const auto Chunk = NewView.subspan( Done, std::min( ChunkSize, NewView.size() - Done ) );
+                        getW().Write( Start + Done, Chunk, SwapEndian() ? SwapSize : 1 );
+                        Done += Chunk.size();
+
+                        m_pWrite->m_Pins[iPin].m_Begin = Start + Done;
+                        if( auto Err = FlushBlocks(false); Err )
+                            return Err;
+                    }
+
+                    PopPin(iPin);
+                }
+                else
+                {
+                    const std::span NewView{ reinterpret_cast<const std::byte*>(&pView[0]), sizeof(of_type_t) * Size };
+
+                    if (auto Err = SerializeNonLocal( NewView.data(), NewView.size(), [&]{ return Handle(NewView, SwapSize); }); Err)
+                        return Err;
+                }
+
+                return {};
             }
         }
-        else
+
         {
+            // Streaming saves pin the elements that are still to come
+            const bool          bStreaming = isStreaming();
+            const std::uint64_t Start      = getW().m_Position;
+            const std::size_t   iPin       = bStreaming ? PushPin( Start, Start + sizeof(of_type_t) * Size ) : 0;
+
             for (std::uint64_t i = 0; i < Size; i++)
             {
                 if (auto Err = Serialize(pView[i]); Err ) 
@@ -372,37 +683,77 @@ namespace xserializer
 
                 #ifdef _DEBUG
                 {
-                    std::size_t X;
-                    auto Err = getW().Tell(X);
-                    assert(Err == false );
-                    assert(static_cast<std::uint64_t>(X) >= i);
+                    assert(static_cast<std::uint64_t>(getW().m_Position) >= i);
                 }
                 #endif
+
+                // Try to flush every time the finished elements fill a block
+                if( bStreaming )
+                {
+                    const std::uint64_t End = Start + sizeof(of_type_t) * (i + 1);
+                    m_pWrite->m_Pins[iPin].m_Begin = End;
+
+                    if( (End / m_pWrite->m_StreamBlockSize) != ((End - sizeof(of_type_t)) / m_pWrite->m_StreamBlockSize) )
+                    {
+                        if( auto Err = FlushBlocks(false); Err )
+                            return Err;
+                    }
+                }
+            }
+
+            if( bStreaming )
+            {
+                PopPin(iPin);
+                return FlushBlocks(false);
             }
         }
 
-        //
-        // Restore the old pack
-        //
-        m_iPack = BackupPackIndex;
         return {};
     }
 
+    //------------------------------------------------------------------------------
+
+    template< class T, typename T_SIZE > inline
+    xerr stream::Serialize(const rel_ptr<T>& Ptr, const T* pData, T_SIZE Size) noexcept
+    {
+        assert( pData != nullptr || Size == 0 );
+
+        // Handle pointer details (the data goes in the same pack as the pointer)
+        if ( auto Err = HandleRelPtrDetails
+        (
+            reinterpret_cast<const std::byte*>(&Ptr)
+            , sizeof(T)
+            , pData ? Size : 0
+        ); Err ) return Err;
+
+        if (pData == nullptr)
+            return {};
+
+        return SerializeElements(pData, static_cast<std::uint64_t>(Size));
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T, typename T_SIZE > inline
+    xerr stream::Serialize(const rel_ptr<T>& Ptr, T_SIZE Size) noexcept
+    {
+        return Serialize(Ptr, Ptr.get(), Size);
+    }
+
     //------------------------------------------------------------------------------
     inline
-    xerr stream::Handle(const std::span<const std::byte> View) noexcept
+    xerr stream::Handle(const std::span<const std::byte> View, std::size_t SwapSize) noexcept
     {
         assert(View.size() >= 0);
 
         // If it is not a local variable then you must pass the memory type
         assert(isLocalVariable(View.data()));
 
-        // Make sure that we are at the right offset
-        if (auto Err = getW().SeekOrigin( m_ClassPos + ComputeLocalOffset(View.data()) ); Err) 
-            return Err;
+        // Write the data at its offset
+        const std::size_t Offset = m_ClassPos + ComputeLocalOffset(View.data());
+        getW().Write( Offset, View, SwapEndian() ? SwapSize : 1 );
 
-        // Write the data
-        return getW().WriteSpan(View);
+        return {};
     }
 
     //------------------------------------------------------------------------------
@@ -439,6 +790,8 @@ namespace xserializer
             return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
 
         pObject = (T*)LoadObject(File);
+        if( pObject == nullptr )
+            return xerr::create<state::FAILURE, "Fail to load the resource">();
 
         ResolveObject(pObject);
         return {};
@@ -464,6 +817,237 @@ namespace xserializer
         return {};
     }
 
+    //------------------------------------------------------------------------------
+    // Only reads the header and the tables, so a budget can decide before loading
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    xerr stream::LoadRequirements(const std::wstring_view FileName, memory_requirements& Requirements) noexcept
+    {
+        xfile::stream File;
+
+        if (auto Err = File.open(FileName, "rb"); Err ) 
+            return Err;
+
+        if ( auto Err = LoadHeader(File, sizeof(T)); Err ) 
+            return Err;
+
+        if( getResourceVersion() != T::xserializer_version_v)
+            return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
+
+        if ( auto Err = LoadRequirements(File, Requirements); Err ) 
+            return Err;
+
+        File.close();
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // The shared packs (not unique, temp or vram) are placed in Region, which must be 
+    // 16 byte aligned and at least memory_requirements::m_RegionSize bytes. Region
+    // belongs to the user so those packs are never freed by the serializer.
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    xerr stream::LoadInto(const std::wstring_view FileName, std::span<std::byte> Region, T*& pObject) noexcept
+    {
+        m_Region = Region;
+        auto Err = Load(FileName, pObject);
+        m_Region = {};
+        return Err;
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::LoadInto(xfile::stream& File, std::span<std::byte> Region, T*& pObject) noexcept
+    {
+        m_Region = Region;
+        auto Err = Load(File, pObject);
+        m_Region = {};
+        return Err;
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::LoadInto(std::span<const std::byte> Data, std::span<std::byte> Region, T*& pObject) noexcept
+    {
+        m_Region = Region;
+        auto Err = Load(Data, pObject);
+        m_Region = {};
+        return Err;
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::LoadInto(const bundle_reader& Bundle, std::uint64_t ID, std::span<std::byte> Region, T*& pObject) noexcept
+    {
+        m_Region = Region;
+        auto Err = Load(Bundle, ID, pObject);
+        m_Region = {};
+        return Err;
+    }
+
+    //------------------------------------------------------------------------------
+    // Packs are decompressed straight from Data, which is only needed during the call
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    xerr stream::Load(std::span<const std::byte> Data, T*& pObject) noexcept
+    {
+        if ( auto Err = LoadHeader(Data, sizeof(*pObject)); Err ) 
+            return Err;
+
+        if( getResourceVersion() != T::xserializer_version_v)
+            return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
+
+        pObject = (T*)LoadObject(Data);
+        if( pObject == nullptr )
+            return xerr::create<state::FAILURE, "Fail to load the resource from memory">();
+
+        ResolveObject(pObject);
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::LoadMapped(mapped_file& File, T*& pObject) noexcept
+    {
+        const auto View = File.getView();
+        if( View.size() < sizeof(header) )
+            return xerr::create<state::UNKOWN_FILE_TYPE, "The mapped file is too small to be a resource">();
+
+        if ( auto Err = DecodeHeader(View, sizeof(*pObject)); Err ) 
+            return Err;
+
+        if( getResourceVersion() != T::xserializer_version_v)
+            return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
+
+        pObject = (T*)LoadMappedObject(View);
+        if( pObject == nullptr )
+            return xerr::create<state::FAILURE, "The file can not be mapped (was it saved with compression_level::STORE?)">();
+
+        ResolveObject(pObject);
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::Load(const bundle_reader& Bundle, std::uint64_t ID, T*& pObject) noexcept
+    {
+        if ( auto Err = LoadHeader(Bundle, ID, sizeof(*pObject)); Err ) 
+            return Err;
+
+        if( getResourceVersion() != T::xserializer_version_v)
+            return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
+
+        pObject = (T*)LoadObject(Bundle, ID);
+        if( pObject == nullptr )
+            return xerr::create<state::FAILURE, "Fail to load the resource from the bundle">();
+
+        ResolveObject(pObject);
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::LoadLazy(lazy_file& File, T*& pObject) noexcept
+    {
+        if ( auto Err = LoadHeader(File.m_File, sizeof(*pObject)); Err ) 
+            return Err;
+
+        if( getResourceVersion() != T::xserializer_version_v)
+            return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
+
+        pObject = (T*)LoadLazyObject(File, std::numeric_limits<std::uint8_t>::max(), true);
+        if( pObject == nullptr )
+            return xerr::create<state::FAILURE, "Fail to load the resource">();
+
+        ResolveObject(pObject);
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr stream::LoadLazy(lazy_file& File, T*& pObject, std::uint8_t Quality) noexcept
+    {
+        if ( auto Err = LoadHeader(File.m_File, sizeof(*pObject)); Err ) 
+            return Err;
+
+        if( getResourceVersion() != T::xserializer_version_v)
+            return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
+
+        pObject = (T*)LoadLazyObject(File, Quality, false);
+        if( pObject == nullptr )
+            return xerr::create<state::FAILURE, "Fail to load the resource">();
+
+        ResolveObject(pObject);
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    template< class T > inline
+    xerr bundle_writer::Add(std::uint64_t ID, const T& Object, compression_level Level, mem_type ObjectFlags) noexcept
+    {
+        if ( auto Err = BeginEntry(); Err ) 
+            return Err;
+
+        if ( auto Err = m_Stream.Save(m_File, Object, Level, ObjectFlags); Err ) 
+            return Err;
+
+        return EndEntry(ID);
+    }
+
+    //------------------------------------------------------------------------------
+    // Each load gets its own copy of the stream settings so many loads can run at once
+    template< class T > inline
+    async_load<T> stream::LoadAsync(const std::wstring_view FileName, T*& pObject) noexcept
+    {
+        auto State = std::make_shared<details::async_load_state>(*this);
+        State->m_Stream.m_Header         = {};
+        State->m_Stream.m_pTempBlockData = nullptr;
+        State->m_Stream.m_pWrite         = nullptr;
+        State->m_Stream.m_pLoaderContext = nullptr;     // The worker uses its own
+
+        pObject = nullptr;
+        SubmitLoad( State, std::wstring{ FileName }, sizeof(T), T::xserializer_version_v );
+        return async_load<T>{ std::move(State), pObject };
+    }
+
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    bool async_load<T>::isReady(void) const noexcept
+    {
+        return m_State == nullptr || m_State->isDone();
+    }
+
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    void async_load<T>::wait(void) const noexcept
+    {
+        if( m_State ) m_State->Wait();
+    }
+
+    //------------------------------------------------------------------------------
+    template< class T > inline
+    xerr async_load<T>::get(void) noexcept
+    {
+        assert(m_State);
+        m_State->Wait();
+
+        const auto State = std::move(m_State);
+        if( State->m_Error ) 
+            return State->m_Error;
+
+        *m_ppObject = reinterpret_cast<T*>(State->m_pObject);
+        State->m_Stream.ResolveObject(*m_ppObject);
+        return {};
+    }
+
     //------------------------------------------------------------------------------
     inline
     void stream::setResourceVersion(std::uint16_t ResourceVersion) noexcept
@@ -471,6 +1055,127 @@ namespace xserializer
         m_Header.m_ResourceVersion = ResourceVersion;
     }
 
+    //------------------------------------------------------------------------------
+    // Zero means use all the hardware threads
+    inline
+    void stream::setThreadCount(std::uint32_t nThreads) noexcept
+    {
+        m_nThreads = nThreads ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setIndependentBlocks(bool bIndependentBlocks) noexcept
+    {
+        m_bIndependentBlocks = bIndependentBlocks;
+    }
+
+    //------------------------------------------------------------------------------
+    // Zero lets the save pick the block size of each pack from its size. Other values
+    // get rounded down to a power of two between min_block_size_v and max_block_size_v.
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setBlockSize(std::uint32_t BlockSize) noexcept
+    {
+        m_BlockSize = BlockSize ? std::bit_floor( std::clamp( BlockSize, min_block_size_v, max_block_size_v ) ) : 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // Codec for the root pack and for any pointer serialized with codec_id::DEFAULT
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setCodec(codec_id Codec) noexcept
+    {
+        assert( Codec != codec_id::DEFAULT );
+        m_Codec = Codec;
+    }
+
+    //------------------------------------------------------------------------------
+    // The context must outlive the loads of this stream, null goes back to the one of
+    // the thread that does the load
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setLoaderContext(loader_context* pContext) noexcept
+    {
+        m_pLoaderContext = pContext;
+    }
+
+    //------------------------------------------------------------------------------
+    // Blocks are compressed and written as soon as they are done instead of keeping the
+    // whole resource in memory. The tables and the real header go at the end.
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setStreamingSave(bool bStreaming) noexcept
+    {
+        m_bStreamingSave = bStreaming;
+    }
+
+    //------------------------------------------------------------------------------
+    // Files saved with checksums have a CRC32C of every compressed block. Loaders 
+    // only check them when asked to with setVerifyChecksums.
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setChecksums(bool bChecksums) noexcept
+    {
+        m_bChecksums = bChecksums;
+    }
+
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setVerifyChecksums(bool bVerify) noexcept
+    {
+        m_bVerifyChecksums = bVerify;
+    }
+
+    //------------------------------------------------------------------------------
+    // Saves and loads add their timings and counters to the stats (null turns it off).
+    // The stats must outlive the loads, including the ones started with LoadAsync.
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setStats(stats* pStats) noexcept
+    {
+        m_pStats = pStats;
+    }
+
+    //------------------------------------------------------------------------------
+    // Pointed-to buffers with the same bytes (and no pointers inside) are saved once and
+    // every pointer to them points to the first copy, so they are loaded once as well.
+    // Buffers in unique packs are never shared (they are freed one by one) and streamed
+    // saves write the buffers before a copy could be found so they save every copy.
+    //------------------------------------------------------------------------------
+    inline
+    void stream::setDeduplication(bool bDeduplicate) noexcept
+    {
+        m_bDeduplicate = bDeduplicate;
+    }
+
+    //------------------------------------------------------------------------------
+    inline
+    bool stream::isStreaming(void) const noexcept
+    {
+        return m_pWrite->m_pTarget != nullptr;
+    }
+
+    //------------------------------------------------------------------------------
+    // Marks a range of the current pack as still being written (streaming saves only)
+    //------------------------------------------------------------------------------
+    inline
+    std::size_t stream::PushPin(std::uint64_t Begin, std::uint64_t End) noexcept
+    {
+        m_pWrite->m_Pins.push_back( pin{ .m_iPack = m_iPack, .m_Begin = Begin, .m_End = End } );
+        return m_pWrite->m_Pins.size() - 1;
+    }
+
+    //------------------------------------------------------------------------------
+    // Also drops any pin left above it by a serialization that failed
+    //------------------------------------------------------------------------------
+    inline
+    void stream::PopPin(std::size_t iPin) noexcept
+    {
+        assert( iPin < m_pWrite->m_Pins.size() );
+        m_pWrite->m_Pins.resize(iPin);
+    }
+
     //------------------------------------------------------------------------------
     constexpr
     std::uint16_t stream::getResourceVersion(void) const noexcept
@@ -478,6 +1183,13 @@ namespace xserializer
         return m_Header.m_ResourceVersion;
     }
 
+    //------------------------------------------------------------------------------
+    constexpr
+    std::size_t stream::getHeaderSize(void) const noexcept
+    {
+        return m_Header.m_HeaderSize;
+    }
+
     //------------------------------------------------------------------------------
     constexpr
     bool stream::SwapEndian(void) const noexcept
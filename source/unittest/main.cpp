@@ -1,4 +1,6 @@
 
+#include <filesystem>
+#include <atomic>
 #include "../../source/xserializer.h"
 #include "../../source/unittest/xserializer_unittest.h"
 
@@ -128,6 +128,308 @@ namespace xserializer::unittest
                 }
             }
         };
+
+        //----------------------------------------------------------------------------------
+        // Structure using relative pointers, they don't need any fixup when loading
+        //----------------------------------------------------------------------------------
+        struct data4
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 1000;
+
+            std::uint32_t               m_Count;
+            rel_ptr<data1>              m_Data;
+            rel_ptr<std::uint32_t>      m_Ints;
+            rel_ptr<std::uint32_t>      m_Null;
+
+            // When saving the data lives in regular memory so we pass it by hand
+            data1*                      m_pSaveData;
+            std::uint32_t*              m_pSaveInts;
+
+            void SanityCheck(void) const
+            {
+                assert(m_Count == COUNT);
+                assert(!m_Null);
+                for (std::uint32_t i = 0; i < m_Count; i++)
+                {
+                    assert(m_Data[i].m_A == static_cast<std::int16_t>(i));
+                    assert(m_Ints[i] == i * 3);
+                }
+            }
+        };
+
+        //----------------------------------------------------------------------------------
+        // Structures with no pointers can be marked as trivial so arrays of them are
+        // written with a single copy
+        //----------------------------------------------------------------------------------
+        struct vertex
+        {
+            static constexpr bool xserializer_trivial_v = true;
+
+            float               m_X, m_Y, m_Z;
+            std::uint32_t       m_Color;
+        };
+
+        struct data5
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 100000;
+
+            std::array<vertex, 4>   m_Corners;
+            std::uint32_t           m_Count;
+            data_ptr<vertex>        m_Vertices;
+
+            void SanityCheck(void) const
+            {
+                for (std::uint32_t i = 0; i < m_Corners.size(); i++)
+                {
+                    assert(m_Corners[i].m_X == static_cast<float>(i));
+                }
+
+                assert(m_Count == COUNT);
+                for (std::uint32_t i = 0; i < m_Count; i++)
+                {
+                    assert(m_Vertices.m_pValue[i].m_Y     == static_cast<float>(i));
+                    assert(m_Vertices.m_pValue[i].m_Color == i);
+                }
+            }
+        };
+
+        //----------------------------------------------------------------------------------
+        // Big resource used by the stress test (needs the wide counts and sizes of the v2 format)
+        //----------------------------------------------------------------------------------
+        struct stress_node
+        {
+            std::uint64_t               m_Value;
+            data_ptr<std::uint64_t>     m_pValue;
+        };
+
+        struct data6
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint64_t NODE_COUNT = 4 * 1024 * 1024;                        // More pointers than a 16bit table could hold
+            static constexpr std::uint64_t BLOB_SIZE  = 5ull * 1024 * 1024 * 1024;              // A pack bigger than 4GB
+
+            std::uint64_t               m_nNodes;
+            data_ptr<stress_node>       m_Nodes;
+            std::uint64_t               m_BlobSize;
+            data_ptr<std::uint8_t>      m_Blob;
+
+            static std::uint8_t getBlobByte(std::uint64_t i) { return static_cast<std::uint8_t>((i * 31) ^ (i >> 13)); }
+
+            void SanityCheck(void) const
+            {
+                assert(m_nNodes == NODE_COUNT);
+                for (std::uint64_t i = 0; i < m_nNodes; i++)
+                {
+                    assert(m_Nodes.m_pValue[i].m_Value == i);
+                    assert(*m_Nodes.m_pValue[i].m_pValue.m_pValue == i * 7);
+                }
+
+                assert(m_BlobSize == BLOB_SIZE);
+                for (std::uint64_t i = 0; i < m_BlobSize; i += 4099)
+                {
+                    assert(m_Blob.m_pValue[i] == getBlobByte(i));
+                }
+                assert(m_Blob.m_pValue[m_BlobSize - 1] == getBlobByte(m_BlobSize - 1));
+            }
+        };
+
+        //----------------------------------------------------------------------------------
+        // Lots of pointers in an array of structures (exercises the relocation table runs and chunks)
+        //----------------------------------------------------------------------------------
+        struct link
+        {
+            data_ptr<std::uint32_t>     m_pA;                   // Always one entry (collapses into long runs)
+            std::uint32_t               m_nB;
+            data_ptr<std::uint32_t>     m_pB;                   // Variable size (breaks the runs)
+        };
+
+        //----------------------------------------------------------------------------------
+        // Same data in three quality tiers
+        //----------------------------------------------------------------------------------
+        struct data8
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 1000;
+
+            data_ptr<std::uint32_t>     m_Coarse;               // Quality 0 (COUNT / 4 entries)
+            data_ptr<std::uint32_t>     m_Fine;                 // Quality 1 (COUNT / 2 entries, unique so it can be freed)
+            data_ptr<std::uint32_t>     m_Finest;               // Quality 2 (COUNT entries)
+
+            static void Check(const data_ptr<std::uint32_t>& Ptr, std::uint32_t Count)
+            {
+                for (std::uint32_t i = 0; i < Count; i++)
+                {
+                    assert(Ptr.m_pValue[i] == i * 3);
+                }
+            }
+        };
+
+        struct data9
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t                  COUNT       = 20000;
+            static constexpr xserializer::codec_id          rle_codec_v = xserializer::codec_id{ 0x47 };
+
+            data_ptr<std::uint32_t>     m_Streamed;             // Saved with the user rle codec
+            data_ptr<std::uint32_t>     m_Archive;              // Saved with the store codec
+            data_ptr<std::uint32_t>     m_Plain;                // Saved with the codec of the stream
+
+            static void Check(const data_ptr<std::uint32_t>& Ptr)
+            {
+                for (std::uint32_t i = 0; i < COUNT; i++)
+                {
+                    assert(Ptr.m_pValue[i] == i / 64);
+                }
+            }
+        };
+
+        struct data10
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 30001;      // Odd so the blocks end with a partial element
+
+            data_ptr<std::int16_t>      m_Shorts;               // SHUFFLE2
+            data_ptr<float>             m_Floats;               // SHUFFLE4
+            data_ptr<double>            m_Doubles;              // SHUFFLE8
+            data_ptr<std::uint32_t>     m_Sorted;               // DELTA4
+            data_ptr<std::uint32_t>     m_Small;                // BITPACK4
+
+            static std::int16_t  getShort   (std::uint32_t i) { return static_cast<std::int16_t>(i % 700) - 350; }
+            static float         getFloat   (std::uint32_t i) { return 1.0f + static_cast<float>(i) * 0.25f; }
+            static double        getDouble  (std::uint32_t i) { return static_cast<double>(i) / 3.0; }
+            static std::uint32_t getSorted  (std::uint32_t i) { return 100000 + i * 3 + (i & 1); }
+            static std::uint32_t getSmall   (std::uint32_t i) { return 5000 + (i * 7919) % 300; }
+
+            void SanityCheck(void) const
+            {
+                for (std::uint32_t i = 0; i < COUNT; i++)
+                {
+                    assert(m_Shorts.m_pValue[i]  == getShort(i));
+                    assert(m_Floats.m_pValue[i]  == getFloat(i));
+                    assert(m_Doubles.m_pValue[i] == getDouble(i));
+                    assert(m_Sorted.m_pValue[i]  == getSorted(i));
+                    assert(m_Small.m_pValue[i]   == getSmall(i));
+                }
+            }
+        };
+
+        //----------------------------------------------------------------------------------
+        // Saved with endian swapping. The sample is trivial but since it has a SerializeIO
+        // it can also be swapped member by member
+        //----------------------------------------------------------------------------------
+        struct sample
+        {
+            static constexpr bool xserializer_trivial_v         = true;
+            static constexpr bool xserializer_swap_members_v    = true;
+
+            std::uint32_t       m_A;
+            std::uint16_t       m_B;
+            std::uint16_t       m_C;
+        };
+
+        struct data11
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 1001;
+
+            std::uint16_t                   m_Short;
+            std::uint64_t                   m_Big;
+            std::array<std::uint32_t, 4>    m_Words;
+            data_ptr<std::uint32_t>         m_Values;
+            data_ptr<sample>                m_Samples;
+
+            static std::uint32_t getValue(std::uint32_t i) { return 0x11223344u + i * 0x01010101u; }
+        };
+
+        struct data7
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 40000;
+
+            std::uint32_t               m_Count;
+            data_ptr<link>              m_Links;
+
+            void SanityCheck(void) const
+            {
+                assert(m_Count == COUNT);
+                for (std::uint32_t i = 0; i < m_Count; i++)
+                {
+                    const link& Link = m_Links.m_pValue[i];
+                    assert(*Link.m_pA.m_pValue == i);
+                    assert(Link.m_nB == 1 + i % 3);
+                    for (std::uint32_t j = 0; j < Link.m_nB; j++)
+                    {
+                        assert(Link.m_pB.m_pValue[j] == i + j);
+                    }
+                }
+            }
+        };
+
+        //----------------------------------------------------------------------------------
+        // Buffers with the same content, for saving with deduplication
+        //----------------------------------------------------------------------------------
+        struct data12
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 5000;
+
+            data_ptr<std::uint32_t>     m_A;            // Same values as m_B
+            data_ptr<std::uint32_t>     m_B;
+            data_ptr<std::uint32_t>     m_C;            // Different values
+            data_ptr<data2>             m_L1;           // The three have the same bytes but they have pointers so they
+            data_ptr<data2>             m_L2;           // can't be shared. L3 points to the same values as L1 and
+            data_ptr<data2>             m_L3;           // L2 to different ones.
+            data_ptr<std::uint32_t>     m_U1;           // Same values but in unique packs, those can't be shared
+            data_ptr<std::uint32_t>     m_U2;
+
+            static std::uint32_t getValue(std::uint32_t i, std::uint32_t Seed) { return i * 7 + Seed; }
+
+            void SanityCheck(void) const
+            {
+                for (std::uint32_t i = 0; i < COUNT; i++)
+                {
+                    assert(m_A.m_pValue[i]  == getValue(i, 1));
+                    assert(m_B.m_pValue[i]  == getValue(i, 1));
+                    assert(m_C.m_pValue[i]  == getValue(i, 2));
+                    assert(m_U1.m_pValue[i] == getValue(i, 3));
+                    assert(m_U2.m_pValue[i] == getValue(i, 3));
+                }
+
+                for (std::uint32_t i = 0; i < m_L1.m_pValue->m_Count; i++)
+                {
+                    assert(m_L1.m_pValue->m_Data.m_pValue[i].m_A == static_cast<std::int16_t>(i));
+                    assert(m_L2.m_pValue->m_Data.m_pValue[i].m_A == static_cast<std::int16_t>(i + 1));
+                    assert(m_L3.m_pValue->m_Data.m_pValue[i].m_A == static_cast<std::int16_t>(i));
+                }
+            }
+        };
+
+        //----------------------------------------------------------------------------------
+        // Structure of the version 1 file in Test25, don't change it
+        //----------------------------------------------------------------------------------
+        struct data13
+        {
+            constexpr static auto xserializer_version_v = 1;
+            static constexpr std::uint32_t COUNT = 40;
+
+            std::uint32_t               m_Count;
+            data_ptr<std::uint32_t>     m_Values;
+            data_ptr<std::uint16_t>     m_Unique;
+
+            static std::uint32_t getValue(std::uint32_t i) { return 0xA5000000u + i * 3; }
+
+            void SanityCheck(void) const
+            {
+                assert(m_Count == COUNT);
+                for (std::uint32_t i = 0; i < COUNT; i++)
+                {
+                    assert(m_Values.m_pValue[i] == getValue(i));
+                    assert(m_Unique.m_pValue[i] == static_cast<std::uint16_t>(getValue(i)));
+                }
+            }
+        };
     }
 }
 
@@ -163,91 +465,2097 @@ namespace xserializer::io_functions
 
     //----------------------------------------------------------------------------------
     template<>
-    xerr SerializeIO<xserializer::unittest::examples::data3>(xserializer::stream& Stream, const xserializer::unittest::examples::data3& Data) noexcept
+    xerr SerializeIO<xserializer::unittest::examples::data4>(xserializer::stream& Stream, const xserializer::unittest::examples::data4& Data) noexcept
     {
-        // Make sure that it is the first version
-        Stream.setResourceVersion(1);
+        if ( auto Err = Stream.Serialize(Data.m_Count); Err) 
+            return Err;
 
-        // Tell the structure to save it self
-        if (auto Err = Stream.Serialize(Data.m_GoInStatic); Err) 
+        if ( auto Err = Stream.Serialize(Data.m_Data, Data.m_pSaveData, Data.m_Count); Err ) 
             return Err;
 
-        // Don't always need to go into structures
-        if ( auto Err = Stream.Serialize(Data.m_DontDynamic.m_Count); Err) 
+        if ( auto Err = Stream.Serialize(Data.m_Ints, Data.m_pSaveInts, Data.m_Count); Err ) 
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Null, static_cast<const std::uint32_t*>(nullptr), 0); Err ) 
             return Err;
 
+        return {};
+    }
 
-        if (auto Err = Stream.Serialize(Data.m_DontDynamic.m_Data.m_pValue, Data.m_DontDynamic.m_Count, xserializer::mem_type{ .m_bUnique = true } ); Err )
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data5>(xserializer::stream& Stream, const xserializer::unittest::examples::data5& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_Corners); Err) 
             return Err;
 
-        // Serialize the temp
-        for (auto& Temp : Data.m_GoTemp)
-        {
-            if ( auto Err = Stream.Serialize(Temp.m_Count); Err ) 
-                return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Count); Err) 
+            return Err;
 
-            if ( auto Err = Stream.Serialize(Temp.m_Data.m_pValue, Temp.m_Count, xserializer::mem_type{ .m_bTempMemory = true } ); Err ) 
-                return Err;
-        }
+        if ( auto Err = Stream.Serialize(Data.m_Vertices.m_pValue, Data.m_Count); Err ) 
+            return Err;
 
-        // Tell our parent to save it self
-        if ( auto Err = SerializeIO(Stream, static_cast<const xserializer::unittest::examples::data1&>(Data)); Err ) 
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::stress_node>(xserializer::stream& Stream, const xserializer::unittest::examples::stress_node& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_Value); Err) 
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_pValue.m_pValue, 1); Err ) 
             return Err;
 
         return {};
     }
-}
 
-//----------------------------------------------------------------------------------
-// Actual code for the examples
-//----------------------------------------------------------------------------------
-namespace xserializer::unittest
-{
-    namespace examples
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data6>(xserializer::stream& Stream, const xserializer::unittest::examples::data6& Data) noexcept
     {
-        //----------------------------------------------------------------------------------
-        void Test01(void)
-        {
-            std::wstring_view FileName(L"temp:/SerialFile.bin");
+        if ( auto Err = Stream.Serialize(Data.m_nNodes); Err) 
+            return Err;
 
-            // Save
-            if constexpr (true)
-            {
-                xserializer::stream   SerialFile;
-                data3                 TheData;
+        if ( auto Err = Stream.Serialize(Data.m_Nodes.m_pValue, Data.m_nNodes); Err ) 
+            return Err;
 
-                TheData.SanityCheck();
-                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
-                {
-                    assert(false);
-                }
-                TheData.DestroyStaticStuff();
-            }
+        if ( auto Err = Stream.Serialize(Data.m_BlobSize); Err) 
+            return Err;
 
-            // Load
-            if constexpr (true)
-            {
-                xserializer::stream   SerialFile;
-                data3* pTheData;
+        if ( auto Err = Stream.Serialize(Data.m_Blob.m_pValue, Data.m_BlobSize, xserializer::mem_type{ .m_bUnique = true } ); Err ) 
+            return Err;
 
-                // This hold thing could happen in one thread
-                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
-                {
-                    assert(false);
-                }
+        return {};
+    }
 
-                // Run sanity check
-                pTheData->SanityCheck();
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::link>(xserializer::stream& Stream, const xserializer::unittest::examples::link& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_pA.m_pValue, 1); Err ) 
+            return Err;
 
-                // Okay one pointer to nuck
-                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
-            }
-        }
+        if ( auto Err = Stream.Serialize(Data.m_nB); Err) 
+            return Err;
 
-        //----------------------------------------------------------------------------------
-        void Test(void)
-        {
-            Test01();
+        if ( auto Err = Stream.Serialize(Data.m_pB.m_pValue, Data.m_nB); Err ) 
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data7>(xserializer::stream& Stream, const xserializer::unittest::examples::data7& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_Count); Err) 
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Links.m_pValue, Data.m_Count); Err ) 
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data8>(xserializer::stream& Stream, const xserializer::unittest::examples::data8& Data) noexcept
+    {
+        using data8 = xserializer::unittest::examples::data8;
+
+        if ( auto Err = Stream.Serialize(Data.m_Coarse.m_pValue, data8::COUNT / 4); Err ) 
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Fine.m_pValue, data8::COUNT / 2, xserializer::mem_type{ .m_bUnique = true }, 1); Err ) 
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Finest.m_pValue, data8::COUNT, {}, 2); Err ) 
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data9>(xserializer::stream& Stream, const xserializer::unittest::examples::data9& Data) noexcept
+    {
+        using data9 = xserializer::unittest::examples::data9;
+
+        if ( auto Err = Stream.Serialize(Data.m_Streamed.m_pValue, data9::COUNT, {}, 0, data9::rle_codec_v); Err ) 
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Archive.m_pValue, data9::COUNT, {}, 0, xserializer::codec_id::STORE); Err ) 
+            return Err;
+
+        if ( auto Err = Stream.Serialize(Data.m_Plain.m_pValue, data9::COUNT); Err ) 
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data10>(xserializer::stream& Stream, const xserializer::unittest::examples::data10& Data) noexcept
+    {
+        using data10 = xserializer::unittest::examples::data10;
+        using codec  = xserializer::codec_id;
+
+        if ( auto Err = Stream.Serialize(Data.m_Shorts.m_pValue,  data10::COUNT, {}, 0, codec::SHUFFLE2); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Floats.m_pValue,  data10::COUNT, {}, 0, codec::SHUFFLE4); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Doubles.m_pValue, data10::COUNT, {}, 0, codec::SHUFFLE8); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Sorted.m_pValue,  data10::COUNT, {}, 0, codec::DELTA4);   Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Small.m_pValue,   data10::COUNT, {}, 0, codec::BITPACK4); Err ) return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::sample>(xserializer::stream& Stream, const xserializer::unittest::examples::sample& Data) noexcept
+    {
+        if ( auto Err = Stream.Serialize(Data.m_A); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_B); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_C); Err ) return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data11>(xserializer::stream& Stream, const xserializer::unittest::examples::data11& Data) noexcept
+    {
+        using data11 = xserializer::unittest::examples::data11;
+
+        if ( auto Err = Stream.Serialize(Data.m_Short); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Big);   Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Words); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Values.m_pValue,  data11::COUNT); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Samples.m_pValue, data11::COUNT); Err ) return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data3>(xserializer::stream& Stream, const xserializer::unittest::examples::data3& Data) noexcept
+    {
+        // Make sure that it is the first version
+        Stream.setResourceVersion(1);
+
+        // Tell the structure to save it self
+        if (auto Err = Stream.Serialize(Data.m_GoInStatic); Err) 
+            return Err;
+
+        // Don't always need to go into structures
+        if ( auto Err = Stream.Serialize(Data.m_DontDynamic.m_Count); Err) 
+            return Err;
+
+
+        if (auto Err = Stream.Serialize(Data.m_DontDynamic.m_Data.m_pValue, Data.m_DontDynamic.m_Count, xserializer::mem_type{ .m_bUnique = true } ); Err )
+            return Err;
+
+        // Serialize the temp
+        for (auto& Temp : Data.m_GoTemp)
+        {
+            if ( auto Err = Stream.Serialize(Temp.m_Count); Err ) 
+                return Err;
+
+            if ( auto Err = Stream.Serialize(Temp.m_Data.m_pValue, Temp.m_Count, xserializer::mem_type{ .m_bTempMemory = true } ); Err ) 
+                return Err;
+        }
+
+        // Tell our parent to save it self
+        if ( auto Err = SerializeIO(Stream, static_cast<const xserializer::unittest::examples::data1&>(Data)); Err ) 
+            return Err;
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data12>(xserializer::stream& Stream, const xserializer::unittest::examples::data12& Data) noexcept
+    {
+        using data12 = xserializer::unittest::examples::data12;
+
+        for( auto p : { &data12::m_A, &data12::m_B, &data12::m_C } )
+        {
+            if ( auto Err = Stream.Serialize((Data.*p).m_pValue, data12::COUNT); Err )
+                return Err;
+        }
+
+        for( auto p : { &data12::m_L1, &data12::m_L2, &data12::m_L3 } )
+        {
+            if ( auto Err = Stream.Serialize((Data.*p).m_pValue, 1); Err )
+                return Err;
+        }
+
+        for( auto p : { &data12::m_U1, &data12::m_U2 } )
+        {
+            if ( auto Err = Stream.Serialize((Data.*p).m_pValue, data12::COUNT, xserializer::mem_type{ .m_bUnique = true }); Err )
+                return Err;
+        }
+
+        return {};
+    }
+
+    //----------------------------------------------------------------------------------
+    template<>
+    xerr SerializeIO<xserializer::unittest::examples::data13>(xserializer::stream& Stream, const xserializer::unittest::examples::data13& Data) noexcept
+    {
+        using data13 = xserializer::unittest::examples::data13;
+
+        if ( auto Err = Stream.Serialize(Data.m_Count); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Values.m_pValue, Data.m_Count); Err ) return Err;
+        if ( auto Err = Stream.Serialize(Data.m_Unique.m_pValue, data13::COUNT, xserializer::mem_type{ .m_bUnique = true }); Err ) return Err;
+
+        return {};
+    }
+}
+
+//----------------------------------------------------------------------------------
+// Actual code for the examples
+//----------------------------------------------------------------------------------
+namespace xserializer::unittest
+{
+    namespace examples
+    {
+        //----------------------------------------------------------------------------------
+        void Test01(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFile.bin");
+
+            // Save
+            if constexpr (true)
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                TheData.SanityCheck();
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            // Load
+            if constexpr (true)
+            {
+                xserializer::stream   SerialFile;
+                data3* pTheData;
+
+                // This hold thing could happen in one thread
+                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                // Run sanity check
+                pTheData->SanityCheck();
+
+                // Okay one pointer to nuck
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Saves and loads data3 letting the caller configure the stream for both operations
+        //----------------------------------------------------------------------------------
+        template< typename T_SETUP >
+        void RoundTrip(std::wstring_view FileName, T_SETUP&& Setup, compression_level Level = compression_level::MEDIUM)
+        {
+            // Save
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                Setup(SerialFile);
+                if ( auto Err = SerialFile.Save(FileName, TheData, Level); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            // Load
+            {
+                xserializer::stream   SerialFile;
+                data3* pTheData;
+
+                Setup(SerialFile);
+                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Multi-threaded saving and loading with chained and independent blocks. The
+        // number of threads must not change the bytes of the file.
+        //----------------------------------------------------------------------------------
+        void Test02(void)
+        {
+            RoundTrip(L"temp:/SerialFileMTChained.bin", [](xserializer::stream& S)
+            {
+                S.setThreadCount(0);
+            });
+
+            RoundTrip(L"temp:/SerialFileMT.bin", [](xserializer::stream& S)
+            {
+                S.setThreadCount(0);
+                S.setIndependentBlocks(true);
+            });
+
+            for( bool bIndependentBlocks : { false, true } )
+            {
+                std::vector<std::byte>  Single, Multi;
+                data3                   TheData;
+
+                for( std::uint32_t nThreads : { 1u, 8u } )
+                {
+                    xserializer::stream SerialFile;
+
+                    SerialFile.setThreadCount(nThreads);
+                    SerialFile.setIndependentBlocks(bIndependentBlocks);
+                    if ( auto Err = SerialFile.Save(nThreads == 1 ? Single : Multi, TheData); Err )
+                    {
+                        assert(false);
+                    }
+                }
+                TheData.DestroyStaticStuff();
+
+                assert( Single.size() == Multi.size() );
+                assert( std::memcmp( Single.data(), Multi.data(), Single.size() ) == 0 );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Stored (uncompressed) files can be loaded normally or memory mapped
+        //----------------------------------------------------------------------------------
+        void Test03(void)
+        {
+            // Memory mapping needs a real path
+            const std::wstring FileName = (std::filesystem::temp_directory_path() / L"SerialFileStored.bin").wstring();
+
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                if ( auto Err = SerialFile.Save(FileName, TheData, compression_level::STORE); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            RoundTrip(L"temp:/SerialFileStored.bin", [](xserializer::stream&){}, compression_level::STORE);
+
+            {
+                xserializer::stream         SerialFile;
+                xserializer::mapped_file    MappedFile;
+                data3*                      pTheData;
+
+                if (auto Err = MappedFile.open(FileName); Err)
+                {
+                    assert(false);
+                }
+
+                if (auto Err = SerialFile.LoadMapped(MappedFile, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                // All the memory belongs to the mapped file so nothing to free
+                pTheData->SanityCheck();
+            }
+
+            // Every pack of a file is stored or none is
+            {
+                std::vector<std::byte> Buffer;
+                {
+                    xserializer::stream   SerialFile;
+                    data3                 TheData;
+
+                    if ( auto Err = SerialFile.Save(Buffer, TheData, compression_level::STORE); Err )
+                    {
+                        assert(false);
+                    }
+                    TheData.DestroyStaticStuff();
+                }
+
+                // Header: m_HeaderSize at 0 and m_nPacks at 20. The packs of 16 bytes follow it, m_Format is their second byte
+                std::uint32_t HeaderSize, nPacks;
+                std::memcpy( &HeaderSize, &Buffer[0],  sizeof(HeaderSize) );
+                std::memcpy( &nPacks,     &Buffer[20], sizeof(nPacks) );
+                assert( nPacks > 1 );
+
+                for( std::uint32_t iPack : { 0u, nPacks - 1 } )
+                {
+                    std::vector<std::byte> Mixed = Buffer;
+                    Mixed[HeaderSize + iPack * 16 + 1] &= ~std::byte{ 2 };
+
+                    xserializer::stream   SerialFile;
+                    data3*                pTheData;
+                    assert( SerialFile.Load(std::span<const std::byte>{ Mixed }, pTheData) );
+                }
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Relative pointers
+        //----------------------------------------------------------------------------------
+        void Test04(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFileRelPtr.bin");
+
+            {
+                xserializer::stream         SerialFile;
+                std::vector<data1>          Data(data4::COUNT);
+                std::vector<std::uint32_t>  Ints(data4::COUNT);
+                data4                       TheData{ .m_Count = data4::COUNT, .m_pSaveData = Data.data(), .m_pSaveInts = Ints.data() };
+
+                for (std::uint32_t i = 0; i < data4::COUNT; i++)
+                {
+                    Data[i].m_A = static_cast<std::int16_t>(i);
+                    Ints[i]     = i * 3;
+                }
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            {
+                xserializer::stream   SerialFile;
+                data4*                pTheData;
+
+                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Bulk copies of trivially serializable structures
+        //----------------------------------------------------------------------------------
+        void Test05(void)
+        {
+            static_assert(xserializer::details::is_trivially_serializable_v<vertex>);
+            static_assert(xserializer::details::is_trivially_serializable_v<std::array<vertex, 4>>);
+            static_assert(false == xserializer::details::is_trivially_serializable_v<data2>);
+
+            std::wstring_view FileName(L"temp:/SerialFileTrivial.bin");
+
+            {
+                xserializer::stream   SerialFile;
+                std::vector<vertex>   Vertices(data5::COUNT);
+                data5                 TheData;
+
+                for (std::uint32_t i = 0; i < TheData.m_Corners.size(); i++)
+                {
+                    TheData.m_Corners[i] = vertex{ static_cast<float>(i), 0, 0, 0 };
+                }
+
+                for (std::uint32_t i = 0; i < data5::COUNT; i++)
+                {
+                    Vertices[i] = vertex{ 0, static_cast<float>(i), 0, i };
+                }
+
+                TheData.m_Count             = data5::COUNT;
+                TheData.m_Vertices.m_pValue = Vertices.data();
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            {
+                xserializer::stream   SerialFile;
+                data5*                pTheData;
+
+                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Stress test for the v2 format: millions of pointers and a pack bigger than 4GB.
+        // It needs many GB of memory so it only runs when XSERIALIZER_STRESS_TEST is defined.
+        //----------------------------------------------------------------------------------
+        void Test06(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFileStress.bin");
+
+            {
+                xserializer::stream         SerialFile;
+                std::vector<stress_node>    Nodes(data6::NODE_COUNT);
+                std::vector<std::uint64_t>  Values(data6::NODE_COUNT);
+                std::vector<std::uint8_t>   Blob(data6::BLOB_SIZE);
+                data6                       TheData;
+
+                for (std::uint64_t i = 0; i < data6::NODE_COUNT; i++)
+                {
+                    Values[i]                   = i * 7;
+                    Nodes[i].m_Value            = i;
+                    Nodes[i].m_pValue.m_pValue  = &Values[i];
+                }
+
+                for (std::uint64_t i = 0; i < data6::BLOB_SIZE; i++)
+                {
+                    Blob[i] = data6::getBlobByte(i);
+                }
+
+                TheData.m_nNodes            = data6::NODE_COUNT;
+                TheData.m_Nodes.m_pValue    = Nodes.data();
+                TheData.m_BlobSize          = data6::BLOB_SIZE;
+                TheData.m_Blob.m_pValue     = Blob.data();
+
+                SerialFile.setThreadCount(0);
+                if ( auto Err = SerialFile.Save(FileName, TheData, compression_level::FAST); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            {
+                xserializer::stream   SerialFile;
+                data6*                pTheData;
+
+                SerialFile.setThreadCount(0);
+                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData->m_Blob.m_pValue );
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Pointer dense resource, the relocation table is resolved with one and many threads
+        //----------------------------------------------------------------------------------
+        void Test07(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFileLinks.bin");
+
+            {
+                xserializer::stream                         SerialFile;
+                std::vector<link>                           Links(data7::COUNT);
+                std::vector<std::array<std::uint32_t, 4>>   Values(data7::COUNT);
+                data7                                       TheData;
+
+                for (std::uint32_t i = 0; i < data7::COUNT; i++)
+                {
+                    Values[i]               = { i, i, i + 1, i + 2 };
+                    Links[i].m_pA.m_pValue  = &Values[i][0];
+                    Links[i].m_nB           = 1 + i % 3;
+                    Links[i].m_pB.m_pValue  = &Values[i][1];
+                }
+
+                TheData.m_Count             = data7::COUNT;
+                TheData.m_Links.m_pValue    = Links.data();
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            {
+                xserializer::stream   SerialFile;
+                data7*                pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Minimal coroutine type so we can co_await a load
+        //----------------------------------------------------------------------------------
+        struct load_task
+        {
+            struct promise_type
+            {
+                load_task           get_return_object   (void) noexcept { return {}; }
+                std::suspend_never  initial_suspend     (void) noexcept { return {}; }
+                std::suspend_never  final_suspend       (void) noexcept { return {}; }
+                void                return_void         (void) noexcept {}
+                void                unhandled_exception (void) noexcept { assert(false); }
+            };
+        };
+
+        load_task AwaitLoad(xserializer::async_load<data7>& Load, std::atomic<std::uint32_t>& nDone)
+        {
+            if (auto Err = co_await Load; Err)
+            {
+                assert(false);
+            }
+
+            // Resumed in a worker, the object is resolved later by get() in the main thread
+            nDone++;
+        }
+
+        //----------------------------------------------------------------------------------
+        // Many loads in flight at the same time (uses the file from Test07)
+        //----------------------------------------------------------------------------------
+        void Test08(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFileLinks.bin");
+            constexpr int     nLoads = 16;
+
+            // Future style
+            {
+                xserializer::stream                         SerialFile;
+                std::array<data7*, nLoads>                  pTheData;
+                std::vector<xserializer::async_load<data7>> Loads;
+
+                for (auto& pData : pTheData)
+                {
+                    Loads.push_back(SerialFile.LoadAsync(FileName, pData));
+                }
+
+                for (int i = 0; i < nLoads; i++)
+                {
+                    if (auto Err = Loads[i].get(); Err)
+                    {
+                        assert(false);
+                    }
+
+                    pTheData[i]->SanityCheck();
+                    default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData[i] );
+                }
+            }
+
+            // Coroutine style
+            {
+                xserializer::stream                         SerialFile;
+                std::array<data7*, nLoads>                  pTheData;
+                std::vector<xserializer::async_load<data7>> Loads;
+                std::atomic<std::uint32_t>                  nDone{ 0 };
+
+                for (auto& pData : pTheData)
+                {
+                    Loads.push_back(SerialFile.LoadAsync(FileName, pData));
+                }
+
+                for (auto& Load : Loads)
+                {
+                    AwaitLoad(Load, nDone);
+                }
+
+                while (nDone.load() != nLoads)
+                {
+                    std::this_thread::yield();
+                }
+
+                for (int i = 0; i < nLoads; i++)
+                {
+                    // co_await does not resolve the object
+                    assert(pTheData[i] == nullptr);
+                    if (auto Err = Loads[i].get(); Err)
+                    {
+                        assert(false);
+                    }
+
+                    pTheData[i]->SanityCheck();
+                    default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData[i] );
+                }
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Many resources in one bundle, loaded from several threads at the same time
+        //----------------------------------------------------------------------------------
+        void Test09(void)
+        {
+            // The bundle reader needs a real path
+            const std::wstring       FileName = (std::filesystem::temp_directory_path() / L"SerialFileBundle.bin").wstring();
+            constexpr std::uint64_t  nEntries = 8;
+
+            {
+                xserializer::bundle_writer  Bundle;
+                data3                       TheData;
+
+                if (auto Err = Bundle.open(FileName); Err)
+                {
+                    assert(false);
+                }
+
+                // Mix compressed and stored resources
+                for (std::uint64_t i = 0; i < nEntries; i++)
+                {
+                    if (auto Err = Bundle.Add(100 + i, TheData, (i & 1) ? compression_level::STORE : compression_level::FAST); Err)
+                    {
+                        assert(false);
+                    }
+                }
+
+                if (auto Err = Bundle.close(); Err)
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            xserializer::bundle_reader Bundle;
+            if (auto Err = Bundle.open(FileName); Err)
+            {
+                assert(false);
+            }
+
+            assert(Bundle.getCount() == nEntries);
+            assert(Bundle.contains(100) && Bundle.contains(99) == false);
+
+            std::vector<std::thread> Threads;
+            for (int t = 0; t < 4; t++)
+            {
+                Threads.emplace_back([&]
+                {
+                    for (std::uint64_t i = 0; i < nEntries; i++)
+                    {
+                        xserializer::stream   SerialFile;
+                        data3*                pTheData;
+
+                        if (auto Err = SerialFile.Load(Bundle, 100 + i, pTheData); Err)
+                        {
+                            assert(false);
+                        }
+
+                        pTheData->SanityCheck();
+                        default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+                    }
+                });
+            }
+
+            for (auto& Thread : Threads) Thread.join();
+        }
+
+        //----------------------------------------------------------------------------------
+        // Lazy loading, the unique pack stays in the file until it is asked for
+        //----------------------------------------------------------------------------------
+        void Test10(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFileLazy.bin");
+
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            {
+                xserializer::stream       SerialFile;
+                xserializer::lazy_file    LazyFile;
+                data3*                    pTheData;
+
+                if (auto Err = LazyFile.open(FileName); Err)
+                {
+                    assert(false);
+                }
+
+                if (auto Err = SerialFile.LoadLazy(LazyFile, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                assert(pTheData->m_DontDynamic.m_Data.m_pValue == nullptr);
+
+                if (auto Err = LazyFile.Load(pTheData->m_DontDynamic.m_Data); Err)
+                {
+                    assert(false);
+                }
+
+                assert(pTheData->m_DontDynamic.m_Data.m_pValue != nullptr);
+                LazyFile.close();
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Quality tiers, start with the coarsest and stream in the rest
+        //----------------------------------------------------------------------------------
+        void Test11(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFileQualities.bin");
+
+            {
+                xserializer::stream         SerialFile;
+                std::vector<std::uint32_t>  Values(data8::COUNT);
+                data8                       TheData;
+
+                for (std::uint32_t i = 0; i < data8::COUNT; i++)
+                {
+                    Values[i] = i * 3;
+                }
+
+                TheData.m_Coarse.m_pValue   = Values.data();
+                TheData.m_Fine.m_pValue     = Values.data();
+                TheData.m_Finest.m_pValue   = Values.data();
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            {
+                xserializer::stream       SerialFile;
+                xserializer::lazy_file    LazyFile;
+                data8*                    pTheData;
+
+                if (auto Err = LazyFile.open(FileName); Err)
+                {
+                    assert(false);
+                }
+
+                if (auto Err = SerialFile.LoadLazy(LazyFile, pTheData, 0); Err)
+                {
+                    assert(false);
+                }
+
+                assert(LazyFile.getQualityCount() == 3);
+                assert(pTheData->m_Fine.m_pValue == nullptr && pTheData->m_Finest.m_pValue == nullptr);
+                data8::Check(pTheData->m_Coarse, data8::COUNT / 4);
+
+                if (auto Err = LazyFile.LoadQuality(1); Err)
+                {
+                    assert(false);
+                }
+
+                assert(pTheData->m_Finest.m_pValue == nullptr);
+                data8::Check(pTheData->m_Fine, data8::COUNT / 2);
+
+                if (auto Err = LazyFile.LoadQuality(2); Err)
+                {
+                    assert(false);
+                }
+
+                data8::Check(pTheData->m_Finest, data8::COUNT);
+
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData->m_Fine.m_pValue );
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Same data as Test07 saved with different block sizes (zero is the automatic mode)
+        //----------------------------------------------------------------------------------
+        void Test12(void)
+        {
+            std::wstring_view                           FileName(L"temp:/SerialFileBlockSizes.bin");
+            std::vector<link>                           Links(data7::COUNT);
+            std::vector<std::array<std::uint32_t, 4>>   Values(data7::COUNT);
+            data7                                       TheData;
+
+            for (std::uint32_t i = 0; i < data7::COUNT; i++)
+            {
+                Values[i]               = { i, i, i + 1, i + 2 };
+                Links[i].m_pA.m_pValue  = &Values[i][0];
+                Links[i].m_nB           = 1 + i % 3;
+                Links[i].m_pB.m_pValue  = &Values[i][1];
+            }
+
+            TheData.m_Count             = data7::COUNT;
+            TheData.m_Links.m_pValue    = Links.data();
+
+            for( std::uint32_t BlockSize : { 1024u * 4, 1024u * 64, 1024u * 1024 * 8, 0u } )
+            for( bool bIndependentBlocks : { false, true } )
+            {
+                {
+                    xserializer::stream SerialFile;
+
+                    SerialFile.setBlockSize(BlockSize);
+                    SerialFile.setIndependentBlocks(bIndependentBlocks);
+                    if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                    {
+                        assert(false);
+                    }
+                }
+
+                for( std::uint32_t nThreads : { 1u, 0u } )
+                {
+                    xserializer::stream   SerialFile;
+                    data7*                pTheData;
+
+                    SerialFile.setThreadCount(nThreads);
+                    if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                    {
+                        assert(false);
+                    }
+
+                    pTheData->SanityCheck();
+                    default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+                }
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Two resources saved one after the other into a memory buffer and loaded from it
+        //----------------------------------------------------------------------------------
+        void Test13(void)
+        {
+            std::vector<std::byte>  Buffer;
+            std::size_t             SecondOffset;
+
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                SecondOffset = Buffer.size();
+                if ( auto Err = SerialFile.Save(Buffer, TheData, compression_level::STORE); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            for( std::size_t Offset : { std::size_t{0}, SecondOffset } )
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            {
+                xserializer::stream   SerialFile;
+                data3*                pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                if (auto Err = SerialFile.Load(std::span<const std::byte>{ Buffer }.subspan(Offset), pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Byte run length codec, enough to show how users plug their own codecs
+        //----------------------------------------------------------------------------------
+        struct rle_codec final : xserializer::codec_base
+        {
+            xerr Compress(std::span<std::byte> Destination, std::span<const std::byte> Source, compression_level, std::size_t& CompressSize) const noexcept override
+            {
+                CompressSize = 0;
+                for (std::size_t i = 0; i < Source.size(); )
+                {
+                    std::size_t Run = 1;
+                    while (Run < 255 && (i + Run) < Source.size() && Source[i + Run] == Source[i]) Run++;
+
+                    if ((CompressSize + 2) > Destination.size())
+                        return xerr::create<state::FAILURE, "Does not fit">();
+
+                    Destination[CompressSize++] = static_cast<std::byte>(Run);
+                    Destination[CompressSize++] = Source[i];
+                    i += Run;
+                }
+                return {};
+            }
+
+            xerr Decompress(std::span<std::byte> Destination, std::span<const std::byte> Source) const noexcept override
+            {
+                std::size_t Size = 0;
+                for (std::size_t i = 0; (i + 1) < Source.size(); i += 2)
+                {
+                    const auto Run = static_cast<std::size_t>(Source[i]);
+                    if ((Size + Run) > Destination.size())
+                        return xerr::create<state::FAILURE, "Corrupted block">();
+
+                    std::memset(&Destination[Size], static_cast<int>(Source[i + 1]), Run);
+                    Size += Run;
+                }
+
+                if (Size != Destination.size())
+                    return xerr::create<state::FAILURE, "Corrupted block">();
+
+                return {};
+            }
+        };
+
+        //----------------------------------------------------------------------------------
+        // Packs saved with the store codec, a user codec and the stream codec
+        //----------------------------------------------------------------------------------
+        void Test14(void)
+        {
+            static constexpr rle_codec  RLECodec;
+            std::vector<std::byte>      Buffer;
+
+            {
+                xserializer::stream         SerialFile;
+                std::vector<std::uint32_t>  Values(data9::COUNT);
+                data9                       TheData;
+
+                for (std::uint32_t i = 0; i < data9::COUNT; i++)
+                {
+                    Values[i] = i / 64;
+                }
+
+                TheData.m_Streamed.m_pValue = Values.data();
+                TheData.m_Archive.m_pValue  = Values.data();
+                TheData.m_Plain.m_pValue    = Values.data();
+
+                // The codec is not registered yet
+                if ( auto Err = SerialFile.Save(Buffer, TheData); !Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = xserializer::RegisterCodec(data9::rle_codec_v, RLECodec); Err )
+                {
+                    assert(false);
+                }
+
+                Buffer.clear();
+                SerialFile.setCodec(xserializer::codec_id::STORE);
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            {
+                xserializer::stream   SerialFile;
+                data9*                pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                if (auto Err = SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                data9::Check(pTheData->m_Streamed);
+                data9::Check(pTheData->m_Archive);
+                data9::Check(pTheData->m_Plain);
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Arrays saved with the built in filter codecs
+        //----------------------------------------------------------------------------------
+        void Test15(void)
+        {
+            std::wstring_view FileName(L"temp:/SerialFileFilters.bin");
+
+            {
+                xserializer::stream         SerialFile;
+                std::vector<std::int16_t>   Shorts(data10::COUNT);
+                std::vector<float>          Floats(data10::COUNT);
+                std::vector<double>         Doubles(data10::COUNT);
+                std::vector<std::uint32_t>  Sorted(data10::COUNT);
+                std::vector<std::uint32_t>  Small(data10::COUNT);
+                data10                      TheData;
+
+                for (std::uint32_t i = 0; i < data10::COUNT; i++)
+                {
+                    Shorts[i]   = data10::getShort(i);
+                    Floats[i]   = data10::getFloat(i);
+                    Doubles[i]  = data10::getDouble(i);
+                    Sorted[i]   = data10::getSorted(i);
+                    Small[i]    = data10::getSmall(i);
+                }
+
+                TheData.m_Shorts.m_pValue   = Shorts.data();
+                TheData.m_Floats.m_pValue   = Floats.data();
+                TheData.m_Doubles.m_pValue  = Doubles.data();
+                TheData.m_Sorted.m_pValue   = Sorted.data();
+                TheData.m_Small.m_pValue    = Small.data();
+
+                SerialFile.setBlockSize(1024 * 16);
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            {
+                xserializer::stream   SerialFile;
+                data10*               pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                if (auto Err = SerialFile.Load(FileName, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Endian swapping of the payload. The packs are stored so the swapped words can be
+        // found in the buffer
+        //----------------------------------------------------------------------------------
+        void Test16(void)
+        {
+            std::vector<std::uint32_t>  Values(data11::COUNT);
+            std::vector<sample>         Samples(data11::COUNT);
+            data11                      TheData;
+
+            for (std::uint32_t i = 0; i < data11::COUNT; i++)
+            {
+                Values[i]  = data11::getValue(i);
+                Samples[i] = { data11::getValue(i), static_cast<std::uint16_t>(0x0102 + i), static_cast<std::uint16_t>(0xA0B0) };
+            }
+
+            TheData.m_Short             = 0x0A0B;
+            TheData.m_Big               = 0x0102030405060708ull;
+            TheData.m_Words             = { 0x10203040u, 0x50607080u, 0x11213141u, 0x51617181u };
+            TheData.m_Values.m_pValue   = Values.data();
+            TheData.m_Samples.m_pValue  = Samples.data();
+
+            // Bytes of a value in the order of the native or of the swapped file
+            auto Append = [](std::vector<std::byte>& Bytes, auto Value, bool bSwap)
+            {
+                const auto Start = Bytes.size();
+                Bytes.resize( Start + sizeof(Value) );
+                std::memcpy( &Bytes[Start], &Value, sizeof(Value) );
+                if (bSwap) std::reverse( Bytes.begin() + Start, Bytes.end() );
+            };
+
+            auto Contains = [](const std::vector<std::byte>& Buffer, const std::vector<std::byte>& Bytes)
+            {
+                return std::search( Buffer.begin(), Buffer.end(), Bytes.begin(), Bytes.end() ) != Buffer.end();
+            };
+
+            for( bool bSwap : { false, true } )
+            {
+                xserializer::stream     SerialFile;
+                std::vector<std::byte>  Buffer;
+
+                if ( auto Err = SerialFile.Save(Buffer, TheData, xserializer::compression_level::STORE, {}, bSwap); Err )
+                {
+                    assert(false);
+                }
+
+                std::vector<std::byte> Object, ValueBytes, SampleBytes;
+                Append( Object, TheData.m_Short, bSwap );
+                Object.resize( offsetof(data11, m_Big) );
+                Append( Object, TheData.m_Big, bSwap );
+                for (auto W : TheData.m_Words) Append( Object, W, bSwap );
+
+                for (std::uint32_t i = 0; i < data11::COUNT; i++)
+                {
+                    Append( ValueBytes,  Values[i],     bSwap );
+                    Append( SampleBytes, Samples[i].m_A, bSwap );
+                    Append( SampleBytes, Samples[i].m_B, bSwap );
+                    Append( SampleBytes, Samples[i].m_C, bSwap );
+                }
+
+                assert( Contains(Buffer, Object) );
+                assert( Contains(Buffer, ValueBytes) );
+                assert( Contains(Buffer, SampleBytes) );
+
+                // The native file still loads
+                if (bSwap == false)
+                {
+                    data11* pTheData;
+                    if (auto Err = SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData); Err)
+                    {
+                        assert(false);
+                    }
+
+                    assert( pTheData->m_Big == TheData.m_Big );
+                    assert( pTheData->m_Samples.m_pValue[7].m_B == Samples[7].m_B );
+                    assert( pTheData->m_Values.m_pValue[data11::COUNT - 1] == Values[data11::COUNT - 1] );
+                    default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+                }
+            }
+
+            // Trivial structures without a SerializeIO can't be swapped
+            {
+                xserializer::stream         SerialFile;
+                std::vector<std::byte>      Buffer;
+                std::vector<vertex>         Vertices(data5::COUNT);
+                data5                       TheData5{};
+
+                TheData5.m_Count                = data5::COUNT;
+                TheData5.m_Vertices.m_pValue    = Vertices.data();
+
+                if ( auto Err = SerialFile.Save(Buffer, TheData5, xserializer::compression_level::STORE, {}, true); !Err )
+                {
+                    assert(false);
+                }
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Pooled memory and per resource arenas
+        //----------------------------------------------------------------------------------
+        void Test17(void)
+        {
+            xserializer::pool_memory_handler Pool;
+
+            // Freed blocks are reused, big and over aligned blocks still work
+            {
+                void* pA = Pool.Allocate({}, 100, 16);
+                Pool.Free({}, pA);
+                void* pB = Pool.Allocate({}, 128, 16);
+                assert(pA == pB);
+
+                void* pBig     = Pool.Allocate({}, 4 * 1024 * 1024, 16);
+                void* pAligned = Pool.Allocate({}, 256, 128);
+                assert((reinterpret_cast<std::uintptr_t>(pB)       & 15)  == 0);
+                assert((reinterpret_cast<std::uintptr_t>(pAligned) & 127) == 0);
+
+                Pool.Free({}, pB);
+                Pool.Free({}, pBig);
+                Pool.Free({}, pAligned);
+            }
+
+            std::vector<std::byte> Buffer;
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            // Loading and unloading the same resource takes the same memory every time
+            xserializer::arena_memory_handler   Arena{ Pool };
+            void*                               pFirst = nullptr;
+            for( int i = 0; i < 8; ++i )
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            {
+                xserializer::stream   SerialFile{ Arena };
+                data3*                pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                if (auto Err = SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                assert(Arena.getAllocatedSize() > 0);
+                if (pFirst == nullptr) pFirst = pTheData;
+                assert(pFirst == pTheData);
+
+                Arena.Reset();
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // The scratch memory of a loader_context stops growing once it has seen the resource
+        //----------------------------------------------------------------------------------
+        void Test18(void)
+        {
+            std::wstring_view       FileName(L"temp:/SerialFileContext.bin");
+            std::vector<std::byte>  Buffer;
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            xserializer::loader_context Context;
+            std::size_t                 ScratchSize = 0;
+            for( int i = 0; i < 4; ++i )
+            for( bool bFile : { false, true } )
+            {
+                xserializer::stream   SerialFile;
+                data3*                pTheData;
+
+                SerialFile.setLoaderContext(&Context);
+                if (auto Err = bFile ? SerialFile.Load(FileName, pTheData) : SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+
+                if (i == 0) ScratchSize = Context.getScratchSize();
+                else        assert(ScratchSize == Context.getScratchSize());
+            }
+
+            assert(ScratchSize > 0);
+            Context.Release();
+            assert(Context.getScratchSize() == 0);
+        }
+
+        //----------------------------------------------------------------------------------
+        // Streaming saves only append to the target so it could be a pipe
+        //----------------------------------------------------------------------------------
+        struct pipe_target final : xserializer::details::save_target
+        {
+            xerr WriteSpan(std::span<const std::byte> View) noexcept override
+            {
+                m_Data.insert(m_Data.end(), View.begin(), View.end());
+                m_nWrites++;
+                return {};
+            }
+
+            std::vector<std::byte>  m_Data;
+            std::size_t             m_nWrites = 0;
+        };
+
+        void Test19(void)
+        {
+            std::wstring_view       FileName(L"temp:/SerialFileStreamed.bin");
+            std::vector<std::byte>  Buffer;
+            pipe_target             Pipe;
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                SerialFile.setStreamingSave(true);
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                // Small blocks so many of them are flushed while the arrays are still being written
+                SerialFile.setBlockSize(1024 * 4);
+                if ( auto Err = SerialFile.Save(FileName, TheData, xserializer::compression_level::STORE); Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = SerialFile.Save(Pipe, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                // Every block was written by itself
+                assert(Pipe.m_nWrites > 100);
+                TheData.DestroyStaticStuff();
+            }
+
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            for( int iSource = 0; iSource < 3; ++iSource )
+            {
+                xserializer::stream   SerialFile;
+                data3*                pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                auto Err = iSource == 0 ? SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData)
+                         : iSource == 1 ? SerialFile.Load(FileName, pTheData)
+                         :                SerialFile.Load(std::span<const std::byte>{ Pipe.m_Data }, pTheData);
+                if (Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+
+            // Relative pointers and structures written one element at a time
+            {
+                std::vector<std::byte>      RelBuffer;
+                {
+                    xserializer::stream         SerialFile;
+                    std::vector<data1>          Data(data4::COUNT);
+                    std::vector<std::uint32_t>  Ints(data4::COUNT);
+                    data4                       TheData{ .m_Count = data4::COUNT, .m_pSaveData = Data.data(), .m_pSaveInts = Ints.data() };
+
+                    for (std::uint32_t i = 0; i < data4::COUNT; i++)
+                    {
+                        Data[i].m_A = static_cast<std::int16_t>(i);
+                        Ints[i]     = i * 3;
+                    }
+
+                    SerialFile.setStreamingSave(true);
+                    SerialFile.setBlockSize(1024 * 4);
+                    if ( auto Err = SerialFile.Save(RelBuffer, TheData); Err )
+                    {
+                        assert(false);
+                    }
+                }
+
+                xserializer::stream   SerialFile;
+                data4*                pTheData;
+                if (auto Err = SerialFile.Load(std::span<const std::byte>{ RelBuffer }, pTheData); Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // The memory of a resource can be known before loading it, and the shared packs
+        // can go into a region given by the user
+        //----------------------------------------------------------------------------------
+        void Test20(void)
+        {
+            std::wstring_view       FileName(L"temp:/SerialFileRegion.bin");
+            std::vector<std::byte>  Buffer;
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            constexpr xserializer::mem_type Shared  {};
+            constexpr xserializer::mem_type Unique  { .m_bUnique = true };
+            constexpr xserializer::mem_type Temp    { .m_bTempMemory = true };
+
+            xserializer::memory_requirements Requirements;
+            {
+                xserializer::stream   SerialFile;
+                if ( auto Err = SerialFile.LoadRequirements<data3>(FileName, Requirements); Err )
+                {
+                    assert(false);
+                }
+
+                assert(Requirements.m_nPacks[Shared.m_Value] == 1);
+                assert(Requirements.m_nPacks[Unique.m_Value] == 1);
+                assert(Requirements.m_nPacks[Temp.m_Value]   == 1);
+                assert(Requirements.m_Size[Unique.m_Value]   == data3::DYNAMIC_COUNT * sizeof(data1));
+                assert(Requirements.m_RegionSize             == Requirements.m_Size[Shared.m_Value]);
+
+                // Memory gives the same answer
+                xserializer::memory_requirements FromMemory;
+                if ( auto Err = SerialFile.LoadHeader(Buffer, sizeof(data3)); Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = SerialFile.LoadRequirements(Buffer, FromMemory); Err )
+                {
+                    assert(false);
+                }
+
+                assert(FromMemory.m_Size == Requirements.m_Size && FromMemory.m_RegionSize == Requirements.m_RegionSize);
+            }
+
+            const std::size_t   RegionSize  = static_cast<std::size_t>(Requirements.m_RegionSize);
+            auto const          pRegion     = reinterpret_cast<std::byte*>(default_memory_handler_v.Allocate(Shared, RegionSize, 16));
+
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            for( int iSource = 0; iSource < 2; ++iSource )
+            {
+                xserializer::arena_memory_handler   Arena;
+                xserializer::stream                 SerialFile{ Arena };
+                data3*                              pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                auto Err = iSource == 0 ? SerialFile.LoadInto(FileName, std::span{ pRegion, RegionSize }, pTheData)
+                         :                SerialFile.LoadInto(std::span<const std::byte>{ Buffer }, std::span{ pRegion, RegionSize }, pTheData);
+                if (Err)
+                {
+                    assert(false);
+                }
+
+                // Only the unique and the temp packs went to the memory handler
+                pTheData->SanityCheck();
+                assert(reinterpret_cast<std::byte*>(pTheData) == pRegion);
+                assert(Arena.getAllocatedSize() == Requirements.m_Size[Unique.m_Value] + Requirements.m_Size[Temp.m_Value]);
+            }
+
+            // A region that is too small is rejected before anything is allocated
+            {
+                xserializer::arena_memory_handler   Arena;
+                xserializer::stream                 SerialFile{ Arena };
+                data3*                              pTheData;
+
+                auto Err = SerialFile.LoadInto(std::span<const std::byte>{ Buffer }, std::span{ pRegion, RegionSize - 16 }, pTheData);
+                assert(Err);
+                assert(Arena.getAllocatedSize() == 0);
+            }
+
+            default_memory_handler_v.Free(Shared, pRegion);
+        }
+
+        //----------------------------------------------------------------------------------
+        // Counts the allocations that are still alive, failed loads must give them all back
+        //----------------------------------------------------------------------------------
+        struct counting_memory_handler final : xserializer::memory_handle_base
+        {
+            void* Allocate(xserializer::mem_type Type, std::size_t Size, std::size_t Alignment) const noexcept override
+            {
+                m_nAlive++;
+                return default_memory_handler_v.Allocate(Type, Size, Alignment);
+            }
+
+            void Free(xserializer::mem_type Type, void* pMemory) const noexcept override
+            {
+                m_nAlive--;
+                default_memory_handler_v.Free(Type, pMemory);
+            }
+
+            mutable std::atomic<std::int64_t> m_nAlive{ 0 };
+        };
+
+        //----------------------------------------------------------------------------------
+        // Blocks saved with checksums are verified while loading, corrupted files fail to load
+        //----------------------------------------------------------------------------------
+        void Test21(void)
+        {
+            std::wstring_view       FileName(L"temp:/SerialFileChecksums.bin");
+            std::wstring_view       BadFileName(L"temp:/SerialFileCorrupted.bin");
+            std::vector<std::byte>  Buffer;
+            std::vector<std::byte>  Streamed;
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                SerialFile.setChecksums(true);
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                SerialFile.setStreamingSave(true);
+                if ( auto Err = SerialFile.Save(Streamed, TheData); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            for( bool bVerify : { false, true } )
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            for( int iSource = 0; iSource < 3; ++iSource )
+            {
+                xserializer::stream   SerialFile;
+                data3*                pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                SerialFile.setVerifyChecksums(bVerify);
+                auto Err = iSource == 0 ? SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData)
+                         : iSource == 1 ? SerialFile.Load(FileName, pTheData)
+                         :                SerialFile.Load(std::span<const std::byte>{ Streamed }, pTheData);
+                if (Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+
+            // The end of the file is the compressed data of the last pack
+            Buffer[Buffer.size() - 10] ^= std::byte{ 0x55 };
+            {
+                xfile::stream File;
+                if ( auto Err = File.open(BadFileName, "wb"); Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = File.WriteSpan(Buffer); Err )
+                {
+                    assert(false);
+                }
+                File.close();
+            }
+
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            for( int iSource = 0; iSource < 2; ++iSource )
+            {
+                counting_memory_handler Counter;
+                xserializer::stream     SerialFile{ Counter };
+                data3*                  pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                SerialFile.setVerifyChecksums(true);
+                auto Err = iSource == 0 ? SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData)
+                         :                SerialFile.Load(BadFileName, pTheData);
+                assert(Err);
+                assert(Counter.m_nAlive == 0);
+
+                // Nothing is left behind, the same stream can load a good resource
+                if ( auto Err = SerialFile.Load(std::span<const std::byte>{ Streamed }, pTheData); Err )
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                Counter.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+
+            // Lazy loads that fail give back the packs they loaded before the corrupted one
+            {
+                counting_memory_handler Counter;
+                xserializer::stream     SerialFile{ Counter };
+                xserializer::lazy_file  LazyFile;
+                data3*                  pTheData;
+
+                if ( auto Err = LazyFile.open(BadFileName); Err )
+                {
+                    assert(false);
+                }
+
+                SerialFile.setVerifyChecksums(true);
+                assert( SerialFile.LoadLazy(LazyFile, pTheData, 0xff) );
+                assert( Counter.m_nAlive == 0 );
+                LazyFile.close();
+
+                if ( auto Err = LazyFile.open(FileName); Err )
+                {
+                    assert(false);
+                }
+
+                if ( auto Err = SerialFile.LoadLazy(LazyFile, pTheData, 0xff); Err )
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                LazyFile.close();
+                Counter.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Timings and counters of saves and loads
+        //----------------------------------------------------------------------------------
+        void Test22(void)
+        {
+            std::wstring_view       FileName(L"temp:/SerialFileStats.bin");
+            std::vector<std::byte>  Buffer;
+            xserializer::stats      SaveStats{ true };
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                SerialFile.setStats(&SaveStats);
+                if ( auto Err = SerialFile.Save(Buffer, TheData); Err )
+                {
+                    assert(false);
+                }
+
+                SerialFile.setStats(nullptr);
+                if ( auto Err = SerialFile.Save(FileName, TheData); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            using stage   = xserializer::stats::stage;
+            using counter = xserializer::stats::counter;
+
+            assert( SaveStats.getCounter(counter::BYTES_WRITTEN) == Buffer.size() );
+            assert( SaveStats.getCounter(counter::PACKS)    > 1 );
+            assert( SaveStats.getCounter(counter::POINTERS) > 0 );
+            assert( SaveStats.getCounter(counter::BLOCKS)   > 0 );
+            assert( SaveStats.getStageCount(stage::SAVE_SERIALIZE) == 1 );
+            assert( SaveStats.getStageCount(stage::SAVE_COMPRESS)  >= 1 );
+            assert( SaveStats.getStageCount(stage::SAVE_TABLES)    == 1 );
+            assert( SaveStats.getStageCount(stage::SAVE_WRITE)     == 1 );
+            assert( SaveStats.getStageCount(stage::LOAD_HEADER)    == 0 );
+            assert( SaveStats.getEvents().size() >= 4 );
+
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            for( int iSource = 0; iSource < 2; ++iSource )
+            {
+                xserializer::stream   SerialFile;
+                xserializer::stats    LoadStats{ true };
+                data3*                pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                SerialFile.setStats(&LoadStats);
+                auto Err = iSource == 0 ? SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData)
+                         :                SerialFile.Load(FileName, pTheData);
+                if (Err)
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+
+                // The counters of the load match the ones of the save
+                for( auto Counter : { counter::PACKS, counter::BLOCKS, counter::POINTERS, counter::INCOMPRESSIBLE_BLOCKS } )
+                    assert( LoadStats.getCounter(Counter) == SaveStats.getCounter(Counter) );
+
+                assert( LoadStats.getCounter(counter::BYTES_READ)         == Buffer.size() );
+                assert( LoadStats.getCounter(counter::BYTES_DECOMPRESSED) == SaveStats.getCounter(counter::BYTES_COMPRESSED) );
+                assert( LoadStats.getCounter(counter::ALLOCATIONS)        == LoadStats.getCounter(counter::PACKS) );
+                assert( LoadStats.getStageCount(stage::LOAD_HEADER)       == 1 );
+                assert( LoadStats.getStageCount(stage::LOAD_TABLES)       == 1 );
+                assert( LoadStats.getStageCount(stage::LOAD_DECOMPRESS)   >= 1 );
+                assert( LoadStats.getStageCount(stage::LOAD_FIXUP)        == 1 );
+                assert( iSource == 0 || LoadStats.getStageCount(stage::LOAD_IO_WAIT) >= 1 );
+
+                std::string Json;
+                LoadStats.getChromeTrace(Json);
+                assert( Json.starts_with("{\"traceEvents\":[") );
+                assert( Json.find("\"LoadFixup\"") != std::string::npos );
+
+                if ( auto Err = LoadStats.SaveChromeTrace(L"temp:/SerialFileStats.json"); Err )
+                {
+                    assert(false);
+                }
+
+                // Without tracing only the totals are kept
+                LoadStats.Reset();
+                assert( LoadStats.getEvents().empty() && LoadStats.getCounter(counter::BYTES_READ) == 0 );
+            }
+
+            // A load that fails after allocating its packs gives them back
+            for( std::uint32_t nThreads : { 1u, 0u } )
+            {
+                counting_memory_handler Counter;
+                xserializer::stream     SerialFile{ Counter };
+                xserializer::stats      LoadStats;
+                data3*                  pTheData;
+
+                SerialFile.setThreadCount(nThreads);
+                SerialFile.setStats(&LoadStats);
+                assert( SerialFile.Load(std::span<const std::byte>{ Buffer }.first(Buffer.size() - 10), pTheData) );
+                assert( LoadStats.getCounter(counter::ALLOCATIONS) > 0 );
+                assert( Counter.m_nAlive == 0 );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Identical buffers saved once
+        //----------------------------------------------------------------------------------
+        void Test23(void)
+        {
+            constexpr auto                      COUNT = data12::COUNT;
+            std::array<std::uint32_t, COUNT>    A, B, C, U1, U2;
+            std::array<data1, 100>              D1, D2, D3;
+            std::array<data2, 3>                L;
+            data12                              TheData;
+
+            for (std::uint32_t i = 0; i < COUNT; i++)
+            {
+                A[i]  = B[i]  = data12::getValue(i, 1);
+                C[i]          = data12::getValue(i, 2);
+                U1[i] = U2[i] = data12::getValue(i, 3);
+            }
+
+            for (std::uint32_t i = 0; i < D1.size(); i++)
+            {
+                D1[i].m_A = D3[i].m_A = static_cast<std::int16_t>(i);
+                D2[i].m_A             = static_cast<std::int16_t>(i + 1);
+            }
+
+            L[0] = data2{ D1.size(), { D1.data() } };
+            L[1] = data2{ D2.size(), { D2.data() } };
+            L[2] = data2{ D3.size(), { D3.data() } };
+
+            TheData.m_A.m_pValue  = A.data();
+            TheData.m_B.m_pValue  = B.data();
+            TheData.m_C.m_pValue  = C.data();
+            TheData.m_L1.m_pValue = &L[0];
+            TheData.m_L2.m_pValue = &L[1];
+            TheData.m_L3.m_pValue = &L[2];
+            TheData.m_U1.m_pValue = U1.data();
+            TheData.m_U2.m_pValue = U2.data();
+
+            std::vector<std::byte>  Plain, Deduplicated, Streamed;
+            xserializer::stats      Stats;
+            {
+                xserializer::stream SerialFile;
+
+                if ( auto Err = SerialFile.Save(Plain, TheData, xserializer::compression_level::STORE); Err )
+                {
+                    assert(false);
+                }
+
+                SerialFile.setDeduplication(true);
+                SerialFile.setStats(&Stats);
+                if ( auto Err = SerialFile.Save(Deduplicated, TheData, xserializer::compression_level::STORE); Err )
+                {
+                    assert(false);
+                }
+
+                SerialFile.setStats(nullptr);
+                SerialFile.setStreamingSave(true);
+                if ( auto Err = SerialFile.Save(Streamed, TheData); Err )
+                {
+                    assert(false);
+                }
+            }
+
+            // m_B and the values of m_L3
+            assert( Stats.getCounter(xserializer::stats::counter::BYTES_DEDUPLICATED) == sizeof(A) + sizeof(D3) );
+            assert( Deduplicated.size() < Plain.size() );
+
+            for( int iFile = 0; iFile < 3; ++iFile )
+            {
+                xserializer::stream SerialFile;
+                data12*             pTheData;
+
+                const auto& Buffer = iFile == 0 ? Plain : iFile == 1 ? Deduplicated : Streamed;
+                if ( auto Err = SerialFile.Load(std::span<const std::byte>{ Buffer }, pTheData); Err )
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+
+                const bool bShared = iFile == 1;
+                assert( (pTheData->m_A.m_pValue == pTheData->m_B.m_pValue) == bShared );
+                assert( (pTheData->m_L1.m_pValue->m_Data.m_pValue == pTheData->m_L3.m_pValue->m_Data.m_pValue) == bShared );
+                assert( pTheData->m_A.m_pValue  != pTheData->m_C.m_pValue );
+                assert( pTheData->m_L1.m_pValue != pTheData->m_L3.m_pValue );
+                assert( pTheData->m_U1.m_pValue != pTheData->m_U2.m_pValue );
+
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData->m_U1.m_pValue );
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData->m_U2.m_pValue );
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Relocation runs that wrap around the size of a pack fail to load instead of
+        // writing pointers out of it. The tables of stored files are not compressed so the
+        // runs can be patched in place.
+        //----------------------------------------------------------------------------------
+        void Test24(void)
+        {
+            std::vector<std::byte> Buffer;
+            {
+                xserializer::stream   SerialFile;
+                data3                 TheData;
+
+                if ( auto Err = SerialFile.Save(Buffer, TheData, xserializer::compression_level::STORE); Err )
+                {
+                    assert(false);
+                }
+                TheData.DestroyStaticStuff();
+            }
+
+            auto Read32 = [&](std::size_t Offset) { std::uint32_t V; std::memcpy(&V, &Buffer[Offset], sizeof(V)); return V; };
+            auto Read64 = [&](std::size_t Offset) { std::uint64_t V; std::memcpy(&V, &Buffer[Offset], sizeof(V)); return V; };
+
+            // Header: m_HeaderSize at 0, m_nPacks at 20, m_nBlockSizes at 24 and m_RelocSize at 32.
+            // The tables follow it: packs of 16 bytes, u32 block sizes and the relocation table.
+            const std::size_t RelocStart = Read32(0) + Read32(20) * std::size_t{ 16 } + Read32(24) * std::size_t{ 4 };
+            const std::size_t RelocSize  = static_cast<std::size_t>(Read64(32));
+
+            auto WriteVarint = []( std::vector<std::byte>& Out, std::uint64_t Value )
+            {
+                for( ; Value >= 0x80; Value >>= 7 ) Out.push_back( static_cast<std::byte>(Value | 0x80) );
+                Out.push_back( static_cast<std::byte>(Value) );
+            };
+
+            // Control, offset, target and, with extra pointers, the strides (the target ones zigzag encoded)
+            constexpr std::uint64_t         Half = std::uint64_t{ 1 } << 63;
+            const std::vector<std::array<std::uint64_t, 5>> BadRuns =
+            { { (2 << 2) | 3, 0,                0, Half, 0               }   // The offset stride wraps back to the start of the pack
+            , { (0 << 2) | 3, ~std::uint64_t{7}, 0, 0,    0               }   // The offset wraps back to the start of the pack
+            , { (2 << 2) | 3, 0,                0, 8,    ~std::uint64_t{0} } // The target stride wraps back to the start of the pack
+            , { (1 << 2) | 3, 0,                1, 8,    0               }   // The target is before the start of the pack
+            };
+
+            for( const auto& Run : BadRuns )
+            {
+                // A single chunk starting at the first run, the rest of the original runs are never reached
+                std::vector<std::byte> Table( 2 * sizeof(std::uint32_t) );
+                Table[0] = std::byte{ 1 };
+                WriteVarint( Table, Run[0] );
+                WriteVarint( Table, 0 );
+                WriteVarint( Table, 0 );
+                WriteVarint( Table, Run[1] );
+                WriteVarint( Table, Run[2] );
+                if( Run[0] >> 2 )
+                {
+                    WriteVarint( Table, Run[3] );
+                    WriteVarint( Table, Run[4] );
+                }
+                assert( Table.size() <= RelocSize );
+
+                std::vector<std::byte> Corrupted = Buffer;
+                std::memcpy( &Corrupted[RelocStart], Table.data(), Table.size() );
+
+                for( std::uint32_t nThreads : { 1u, 0u } )
+                {
+                    xserializer::stream   SerialFile;
+                    data3*                pTheData;
+
+                    SerialFile.setThreadCount(nThreads);
+                    assert( SerialFile.Load(std::span<const std::byte>{ Corrupted }, pTheData) );
+                }
+
+                // The mapped path reads the same header and only fails in the relocations
+                for( std::uint32_t nThreads : { 1u, 0u } )
+                for( bool bCorrupted : { false, true } )
+                {
+                    xserializer::stream     SerialFile;
+                    std::vector<std::byte>  View = bCorrupted ? Corrupted : Buffer;
+
+                    SerialFile.setThreadCount(nThreads);
+                    if ( auto Err = SerialFile.LoadHeader(std::span<const std::byte>{ View }, sizeof(data3)); Err )
+                    {
+                        assert(false);
+                    }
+
+                    assert( (SerialFile.LoadMappedObject(View) == nullptr) == bCorrupted );
+                }
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        // Loads a file written by the version 1 serializer (a data13) and saves it again
+        // with the current version. The bytes come from the version 1 writer with a
+        // compressor that always reports incompressible data, so the blocks and tables
+        // are raw and the file loads with any compressor. Version 1 never initialized the
+        // 3 bytes after the flags of each pack, so the test loads it again with those set
+        // to garbage.
+        //----------------------------------------------------------------------------------
+        void Test25(void)
+        {
+            static constexpr std::uint8_t FileV1[] =
+            {
+                0x48, 0x01, 0x00, 0x00, 0x01, 0x00, 0x40, 0x00, 0x02, 0x00, 0x02, 0x00, 0x02, 0x00, 0x01, 0x00,
+                0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB8, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+                0x01, 0x00, 0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00,
+                0x08, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                0x10, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0xB8, 0x00, 0x00, 0x00,
+                0x50, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+                0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xA5,
+                0x03, 0x00, 0x00, 0xA5, 0x06, 0x00, 0x00, 0xA5, 0x09, 0x00, 0x00, 0xA5, 0x0C, 0x00, 0x00, 0xA5,
+                0x0F, 0x00, 0x00, 0xA5, 0x12, 0x00, 0x00, 0xA5, 0x15, 0x00, 0x00, 0xA5, 0x18, 0x00, 0x00, 0xA5,
+                0x1B, 0x00, 0x00, 0xA5, 0x1E, 0x00, 0x00, 0xA5, 0x21, 0x00, 0x00, 0xA5, 0x24, 0x00, 0x00, 0xA5,
+                0x27, 0x00, 0x00, 0xA5, 0x2A, 0x00, 0x00, 0xA5, 0x2D, 0x00, 0x00, 0xA5, 0x30, 0x00, 0x00, 0xA5,
+                0x33, 0x00, 0x00, 0xA5, 0x36, 0x00, 0x00, 0xA5, 0x39, 0x00, 0x00, 0xA5, 0x3C, 0x00, 0x00, 0xA5,
+                0x3F, 0x00, 0x00, 0xA5, 0x42, 0x00, 0x00, 0xA5, 0x45, 0x00, 0x00, 0xA5, 0x48, 0x00, 0x00, 0xA5,
+                0x4B, 0x00, 0x00, 0xA5, 0x4E, 0x00, 0x00, 0xA5, 0x51, 0x00, 0x00, 0xA5, 0x54, 0x00, 0x00, 0xA5,
+                0x57, 0x00, 0x00, 0xA5, 0x5A, 0x00, 0x00, 0xA5, 0x5D, 0x00, 0x00, 0xA5, 0x60, 0x00, 0x00, 0xA5,
+                0x63, 0x00, 0x00, 0xA5, 0x66, 0x00, 0x00, 0xA5, 0x69, 0x00, 0x00, 0xA5, 0x6C, 0x00, 0x00, 0xA5,
+                0x6F, 0x00, 0x00, 0xA5, 0x72, 0x00, 0x00, 0xA5, 0x75, 0x00, 0x00, 0xA5, 0x00, 0x00, 0x03, 0x00,
+                0x06, 0x00, 0x09, 0x00, 0x0C, 0x00, 0x0F, 0x00, 0x12, 0x00, 0x15, 0x00, 0x18, 0x00, 0x1B, 0x00,
+                0x1E, 0x00, 0x21, 0x00, 0x24, 0x00, 0x27, 0x00, 0x2A, 0x00, 0x2D, 0x00, 0x30, 0x00, 0x33, 0x00,
+                0x36, 0x00, 0x39, 0x00, 0x3C, 0x00, 0x3F, 0x00, 0x42, 0x00, 0x45, 0x00, 0x48, 0x00, 0x4B, 0x00,
+                0x4E, 0x00, 0x51, 0x00, 0x54, 0x00, 0x57, 0x00, 0x5A, 0x00, 0x5D, 0x00, 0x60, 0x00, 0x63, 0x00,
+                0x66, 0x00, 0x69, 0x00, 0x6C, 0x00, 0x6F, 0x00, 0x72, 0x00, 0x75, 0x00
+            };
+
+            std::vector<std::byte> Garbage( reinterpret_cast<const std::byte*>(FileV1), reinterpret_cast<const std::byte*>(FileV1) + sizeof(FileV1) );
+
+            // Header of 20 bytes followed by the 2 packs of 12 bytes
+            for( std::size_t Offset : { 20, 32 } )
+                std::memset( &Garbage[Offset + 1], 0xFF, 3 );
+
+            std::vector<std::byte> Resaved;
+            for( int iFile = 0; iFile < 3; ++iFile )
+            {
+                xserializer::stream SerialFile;
+                data13*             pTheData;
+
+                const auto Buffer = iFile == 0 ? std::as_bytes(std::span{ FileV1 })
+                                  : iFile == 1 ? std::span<const std::byte>{ Garbage }
+                                  :              std::span<const std::byte>{ Resaved };
+                if ( auto Err = SerialFile.Load(Buffer, pTheData); Err )
+                {
+                    assert(false);
+                }
+
+                pTheData->SanityCheck();
+
+                if( iFile == 0 )
+                {
+                    if ( auto Err = SerialFile.Save(Resaved, *pTheData); Err )
+                    {
+                        assert(false);
+                    }
+                }
+
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData->m_Unique.m_pValue );
+                default_memory_handler_v.Free(xserializer::mem_type{ .m_bUnique = true}, pTheData );
+            }
+        }
+
+        //----------------------------------------------------------------------------------
+        void Test(void)
+        {
+            Test01();
+            Test02();
+            Test03();
+            Test04();
+            Test05();
+            Test07();
+            Test08();
+            Test09();
+            Test10();
+            Test11();
+            Test12();
+            Test13();
+            Test14();
+            Test15();
+            Test16();
+            Test17();
+            Test18();
+            Test19();
+            Test20();
+            Test21();
+            Test22();
+            Test23();
+            Test24();
+            Test25();
+
+        #ifdef XSERIALIZER_STRESS_TEST
+            Test06();
+        #endif
         }
     }
 }
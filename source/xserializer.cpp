@@ -2,22 +2,97 @@
 #include "xserializer.h"
 #include "source/xcompression.h"
 #include <format>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <utility>
+#include <filesystem>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define XSERIALIZER_AVX2  1
+    #define XSERIALIZER_SSSE3 1
+    #define XSERIALIZER_SSE2  1
+#elif defined(__SSSE3__) || defined(__AVX__)
+    #include <tmmintrin.h>
+    #define XSERIALIZER_AVX2  0
+    #define XSERIALIZER_SSSE3 1
+    #define XSERIALIZER_SSE2  1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define XSERIALIZER_AVX2  0
+    #define XSERIALIZER_SSSE3 0
+    #define XSERIALIZER_SSE2  1
+#else
+    #define XSERIALIZER_AVX2  0
+    #define XSERIALIZER_SSSE3 0
+    #define XSERIALIZER_SSE2  0
+#endif
+
+// The 64 bit crc32 instruction only exists in 64 bit mode
+#if (defined(__SSE4_2__) || defined(__AVX__)) && (defined(__x86_64__) || defined(_M_X64))
+    #include <nmmintrin.h>
+    #define XSERIALIZER_SSE42 1
+#else
+    #define XSERIALIZER_SSE42 0
+#endif
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <cerrno>
+#endif
 
 namespace xserializer
 {
-    template<typename T>
-    struct unique_span : std::span<T>
+    namespace details
     {
-        using std::span<T>::operator[];
+        // A pack (or an independent block of one) that LoadPacksParallel decompresses
+        struct decompress_job
+        {
+            std::span<std::byte>                    m_Destination           {};
+            std::size_t                             m_SourceOffset          {};
+            std::span<const std::uint32_t>          m_BlockSizes            {};
+            std::uint32_t                           m_BlockSize             {};
+            bool                                    m_bIndependentBlocks    {};
+            const codec_base*                       m_pCodec                {};
+            const std::uint32_t*                    m_pChecksums            {};     // One per block size, null when they are not verified
+            xerr                                    m_Error                 {};
+        };
 
-        void New( std::size_t Count )
+        //------------------------------------------------------------------------------
+        // What a loader_context owns
+        //------------------------------------------------------------------------------
+        struct loader_scratch
         {
-            m_Data = std::make_unique<T[]>(Count);
-            static_cast<std::span<T>&>(*this) = std::span<T>{m_Data.get(), Count};
-        }
+            // Buffers never shrink, so the memory is only touched by resize the first time
+            static std::span<std::byte> Grow( std::vector<std::byte>& Buffer, std::size_t Size ) noexcept
+            {
+                if( Buffer.size() < Size ) Buffer.resize( Size );
+                return { Buffer.data(), Size };
+            }
 
-        std::unique_ptr<T[]> m_Data;
-    };
+            std::vector<std::byte>                  m_Tables        {};     // Packs, block sizes and relocation table of the current load
+            std::vector<std::byte>                  m_Staging       {};     // Compressed tables, then the compressed packs or the read double buffer
+            std::vector<std::byte*>                 m_PackPointers  {};
+            std::vector<std::uint64_t>              m_BlockOffsets  {};     // Where each block is, only for streamed resources
+            std::vector<std::uint32_t>              m_Checksums     {};     // Checksum of each block, only when they are verified
+            std::vector<decompress_job>             m_Jobs          {};
+            xcompression::dynamic_block_decompress  m_Decompress    {};
+        };
+    }
 
     //------------------------------------------------------------------------------
     // Create the compressor capable of compressing both dynamic and fixed size blocks
@@ -36,6 +111,7 @@ namespace xserializer
 
             switch (CompressionLevel)
             {
+            case compression_level::STORE:  // Stored packs never get here, but the table could
             case compression_level::FAST:
                 m_bUseDynamic   = false;
                 FLevel          = xcompression::fixed_block_compress::level::FAST;
@@ -85,714 +161,4280 @@ namespace xserializer
     };
 
     //------------------------------------------------------------------------------
-
-    namespace endian
+    // Copies the blocks as they are. Compress always fails so the blocks get saved raw.
+    //------------------------------------------------------------------------------
+    struct store_codec final : codec_base
     {
-        constexpr static std::uint8_t Convert(std::uint8_t value) noexcept
+        xerr Compress( std::span<std::byte>, std::span<const std::byte>, compression_level, std::size_t& ) const noexcept override
         {
-            return value;
+            return xerr::create<state::FAILURE, "The store codec does not compress">();
         }
 
-        constexpr static std::uint16_t Convert(std::uint16_t value) noexcept
+        xerr Decompress( std::span<std::byte> Destination, std::span<const std::byte> Source ) const noexcept override
         {
-            return (value >> 8) | (value << 8);
+            if( Destination.size() != Source.size() )
+                return xerr::create<state::FAILURE, "Stored block with the wrong size">();
+
+            std::memcpy( Destination.data(), Source.data(), Source.size() );
+            return {};
         }
+    };
 
-        constexpr static std::uint32_t Convert(std::uint32_t value) noexcept
+    //------------------------------------------------------------------------------
+    // Lossless filters that run on a block before xcompression and are undone after it.
+    // Byte shuffle puts byte k of every element together, so the slow changing bytes of
+    // ints and floats form long runs. Values are read as little endian so the files are
+    // the same on every machine. The decode kernels are vectorized when SSE2/AVX2 is on.
+    //------------------------------------------------------------------------------
+    namespace filters
+    {
+        static std::uint32_t LoadU32( const std::byte* p ) noexcept
         {
-            return ((value >> 24) & 0xFF)       | ((value >> 8) & 0xFF00) |
-                   ((value <<  8) & 0xFF0000)   |  (value << 24);
+            return  static_cast<std::uint32_t>(p[0])        | (static_cast<std::uint32_t>(p[1]) << 8)
+                 | (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
         }
 
-        constexpr static std::uint64_t Convert(std::uint64_t value) noexcept
+        //------------------------------------------------------------------------------
+
+        static void StoreU32( std::byte* p, std::uint32_t Value ) noexcept
         {
-            return  ((value >> 56) & 0xFF)              | ((value >> 40) & 0xFF00)          |
-                    ((value >> 24) & 0xFF0000)          | ((value >>  8) & 0xFF000000)      |
-                    ((value <<  8) & 0xFF00000000)      | ((value << 24) & 0xFF0000000000)  |
-                    ((value << 40) & 0xFF000000000000)  |  (value << 56);
+            p[0] = static_cast<std::byte>(Value);
+            p[1] = static_cast<std::byte>(Value >> 8);
+            p[2] = static_cast<std::byte>(Value >> 16);
+            p[3] = static_cast<std::byte>(Value >> 24);
         }
-    }
 
+        //------------------------------------------------------------------------------
+        // The bytes at the end that don't make a full element are copied as they are
+        //------------------------------------------------------------------------------
+        static void Shuffle( std::byte* pDst, const std::byte* pSrc, std::size_t Size, std::size_t ElementSize ) noexcept
+        {
+            const std::size_t n = Size / ElementSize;
+            for( std::size_t k = 0; k < ElementSize; ++k )
+            {
+                for( std::size_t i = 0; i < n; ++i ) pDst[k * n + i] = pSrc[i * ElementSize + k];
+            }
 
+            std::memcpy( pDst + n * ElementSize, pSrc + n * ElementSize, Size - n * ElementSize );
+        }
 
-    //------------------------------------------------------------------------------
+        //------------------------------------------------------------------------------
 
-    stream::stream(const default_memory_hadler& MemoryHandler) noexcept
-        : m_MemoryCallback{ MemoryHandler }
-    {
-    }
+        template< std::size_t N >
+        static void Unshuffle( std::byte* pDst, const std::byte* pSrc, std::size_t Size ) noexcept
+        {
+            static_assert( N == 2 || N == 4 || N == 8 );
 
-    //------------------------------------------------------------------------------
+            const std::size_t n = Size / N;
+            std::size_t       i = 0;
 
-    std::uint32_t stream::writing::AllocatePack( mem_type DefaultPackFlags ) noexcept
-    {
-        constexpr std::wstring_view Name(L"ram:\\Whatever");
+#if XSERIALIZER_AVX2
+            if constexpr ( N == 4 )
+            {
+                // Unpacks stay inside the 128 bit lanes, the permutes put the lanes back in order
+                for( ; i + 32 <= n; i += 32 )
+                {
+                    const __m256i P0  = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc + 0 * n + i) );
+                    const __m256i P1  = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc + 1 * n + i) );
+                    const __m256i P2  = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc + 2 * n + i) );
+                    const __m256i P3  = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pSrc + 3 * n + i) );
+                    const __m256i L01 = _mm256_unpacklo_epi8( P0, P1 );
+                    const __m256i H01 = _mm256_unpackhi_epi8( P0, P1 );
+                    const __m256i L23 = _mm256_unpacklo_epi8( P2, P3 );
+                    const __m256i H23 = _mm256_unpackhi_epi8( P2, P3 );
+                    const __m256i E0  = _mm256_unpacklo_epi16( L01, L23 );
+                    const __m256i E1  = _mm256_unpackhi_epi16( L01, L23 );
+                    const __m256i E2  = _mm256_unpacklo_epi16( H01, H23 );
+                    const __m256i E3  = _mm256_unpackhi_epi16( H01, H23 );
 
-        // Create the default pack
-        auto& WPack = m_Packs.emplace_back();
-        if( auto Error = WPack.m_Data.open(Name, "wb+"); Error )
-        {
-            assert(false);
-            return ~0;
-        }
-        WPack.m_PackFlags = DefaultPackFlags;
+                    auto pOut = reinterpret_cast<__m256i*>( pDst + i * 4 );
+                    _mm256_storeu_si256( pOut + 0, _mm256_permute2x128_si256( E0, E1, 0x20 ) );
+                    _mm256_storeu_si256( pOut + 1, _mm256_permute2x128_si256( E2, E3, 0x20 ) );
+                    _mm256_storeu_si256( pOut + 2, _mm256_permute2x128_si256( E0, E1, 0x31 ) );
+                    _mm256_storeu_si256( pOut + 3, _mm256_permute2x128_si256( E2, E3, 0x31 ) );
+                }
+            }
+#endif
 
-        return static_cast<std::uint32_t>(m_Packs.size() - 1);
-    }
+#if XSERIALIZER_SSE2
+            for( ; i + 16 <= n; i += 16 )
+            {
+                auto Load = [&]( std::size_t k ) { return _mm_loadu_si128( reinterpret_cast<const __m128i*>(pSrc + k * n + i) ); };
+                auto pOut = reinterpret_cast<__m128i*>( pDst + i * N );
 
-    //------------------------------------------------------------------------------
+                if constexpr ( N == 2 )
+                {
+                    const __m128i P0 = Load(0), P1 = Load(1);
+                    _mm_storeu_si128( pOut + 0, _mm_unpacklo_epi8( P0, P1 ) );
+                    _mm_storeu_si128( pOut + 1, _mm_unpackhi_epi8( P0, P1 ) );
+                }
+                else if constexpr ( N == 4 )
+                {
+                    const __m128i L01 = _mm_unpacklo_epi8( Load(0), Load(1) ), H01 = _mm_unpackhi_epi8( Load(0), Load(1) );
+                    const __m128i L23 = _mm_unpacklo_epi8( Load(2), Load(3) ), H23 = _mm_unpackhi_epi8( Load(2), Load(3) );
+                    _mm_storeu_si128( pOut + 0, _mm_unpacklo_epi16( L01, L23 ) );
+                    _mm_storeu_si128( pOut + 1, _mm_unpackhi_epi16( L01, L23 ) );
+                    _mm_storeu_si128( pOut + 2, _mm_unpacklo_epi16( H01, H23 ) );
+                    _mm_storeu_si128( pOut + 3, _mm_unpackhi_epi16( H01, H23 ) );
+                }
+                else
+                {
+                    // Three rounds of unpacks: bytes to pairs, pairs to 4 byte groups, groups to elements
+                    __m128i B[8], W[8];
+                    for( std::size_t k = 0; k < 8; k += 2 )
+                    {
+                        B[k + 0] = _mm_unpacklo_epi8( Load(k), Load(k + 1) );
+                        B[k + 1] = _mm_unpackhi_epi8( Load(k), Load(k + 1) );
+                    }
+                    for( std::size_t k = 0; k < 8; k += 4 )
+                    {
+                        W[k + 0] = _mm_unpacklo_epi16( B[k + 0], B[k + 2] );
+                        W[k + 1] = _mm_unpackhi_epi16( B[k + 0], B[k + 2] );
+                        W[k + 2] = _mm_unpacklo_epi16( B[k + 1], B[k + 3] );
+                        W[k + 3] = _mm_unpackhi_epi16( B[k + 1], B[k + 3] );
+                    }
+                    for( std::size_t k = 0; k < 4; ++k )
+                    {
+                        _mm_storeu_si128( pOut + k * 2 + 0, _mm_unpacklo_epi32( W[k], W[k + 4] ) );
+                        _mm_storeu_si128( pOut + k * 2 + 1, _mm_unpackhi_epi32( W[k], W[k + 4] ) );
+                    }
+                }
+            }
+#endif
 
-    xerr stream::HandlePtrDetails( const std::byte* pA, std::size_t SizeofA, std::size_t Count, mem_type MemoryFlags ) noexcept
-    {
-        // If the parent is in not in a common pool then its children must also not be in a common pool.
-        // The theory is that if the parent is not in a common pool it could be deallocated and if the child 
-        // is in a common pool it could be left orphan. However this may need to be thought out more carefully
-        // so I am playing it safe for now.
-        if( m_pWrite->m_Packs[m_iPack].m_PackFlags.m_bUnique )
-        {
-            assert(MemoryFlags.m_bUnique);
+            for( ; i < n; ++i )
+            {
+                for( std::size_t k = 0; k < N; ++k ) pDst[i * N + k] = pSrc[k * n + i];
+            }
+
+            std::memcpy( pDst + n * N, pSrc + n * N, Size - n * N );
         }
-        else if (m_pWrite->m_Packs[m_iPack].m_PackFlags.m_bTempMemory)
+
+        //------------------------------------------------------------------------------
+        // 32 bit differences with wrap around, sorted values become small numbers
+        //------------------------------------------------------------------------------
+        static void DeltaEncode( std::byte* p, std::size_t Size ) noexcept
         {
-            assert(MemoryFlags.m_bTempMemory);
+            std::uint32_t Last = 0;
+            for( std::size_t i = 0; i + 4 <= Size; i += 4 )
+            {
+                const std::uint32_t Value = LoadU32( p + i );
+                StoreU32( p + i, Value - Last );
+                Last = Value;
+            }
         }
 
-        //
-        // If we don't have any elements then just write the pointer raw
-        //
-        if (Count == 0)
+        //------------------------------------------------------------------------------
+
+        static void DeltaDecode( std::byte* p, std::size_t Size ) noexcept
         {
-            // always write 64 bits worth (assuming user is using xserialfile::ptr)
-            // if we do not do this the upper bits of the 64 bits may contain trash
-            // and if the compiler is 32bits and the game 64 then that trash can crash
-            // the game.
-            if( auto Err = Serialize(*((std::uint64_t*)(pA))); Err )
-                return Err;
+            std::uint32_t Last = 0;
+            std::size_t   i    = 0;
 
-            return {};
-        }
+#if XSERIALIZER_SSE2
+            // Prefix sum of 4 values in two shifts, the carry is the last sum broadcast
+            __m128i Carry = _mm_setzero_si128();
+            for( ; i + 16 <= Size; i += 16 )
+            {
+                __m128i X = _mm_loadu_si128( reinterpret_cast<const __m128i*>(p + i) );
+                X     = _mm_add_epi32( X, _mm_slli_si128( X, 4 ) );
+                X     = _mm_add_epi32( X, _mm_slli_si128( X, 8 ) );
+                X     = _mm_add_epi32( X, Carry );
+                Carry = _mm_shuffle_epi32( X, 0xFF );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(p + i), X );
+            }
+            Last = static_cast<std::uint32_t>( _mm_cvtsi128_si32( Carry ) );
+#endif
 
-        //
-        // Choose the right pack for this allocation        
-        //
+            for( ; i + 4 <= Size; i += 4 )
+            {
+                Last += LoadU32( p + i );
+                StoreU32( p + i, Last );
+            }
+        }
 
-        // Back up the current pack
-        auto BackupPackIndex = m_iPack;
+        //------------------------------------------------------------------------------
+        // Frame of reference: u32 Min, u8 Bits, then every (value - Min) in Bits bits
+        //------------------------------------------------------------------------------
+        static constexpr std::size_t bitpack_header_v = 5;
 
-        if( MemoryFlags.m_bUnique )
+        static std::size_t BitPackSize( std::size_t Size, std::uint32_t Bits ) noexcept
         {
-            // Create a pack
-            m_iPack = m_pWrite->AllocatePack(MemoryFlags);
+            return bitpack_header_v + ( (Size / 4) * Bits + 7 ) / 8 + Size % 4;
         }
-        else
+
+        //------------------------------------------------------------------------------
+
+        static bool BitPack( std::span<std::byte> Dst, std::span<const std::byte> Src, std::size_t& PackSize ) noexcept
         {
-            // Search for a pool which matches our attributes
-            std::uint32_t i;
-            constexpr static auto non_unique_v = []() consteval { mem_type x {.m_bUnique = false, .m_bTempMemory = true, .m_bVRam = true}; return x; }();
-            for (i = 0; i < m_pWrite->m_Packs.size(); i++)
-            {
-                if( (m_pWrite->m_Packs[i].m_PackFlags.m_Value & non_unique_v.m_Value ) == MemoryFlags.m_Value )
-                    break;
-            }
+            const std::size_t n   = Src.size() / 4;
+            std::uint32_t     Min = std::numeric_limits<std::uint32_t>::max();
+            std::uint32_t     Max = 0;
 
-            // Could not find a pack with compatible flags so just create a new one
-            if (i == m_pWrite->m_Packs.size())
+            for( std::size_t i = 0; i < n; ++i )
             {
-                // Create a pack
-                m_iPack = m_pWrite->AllocatePack(MemoryFlags);
+                const auto Value = LoadU32( &Src[i * 4] );
+                Min = std::min( Min, Value );
+                Max = std::max( Max, Value );
             }
-            else
+            if( n == 0 ) Min = 0;
+
+            const auto Bits = static_cast<std::uint32_t>( std::bit_width( Max - Min ) );
+            PackSize = BitPackSize( Src.size(), Bits );
+            if( PackSize > Dst.size() ) 
+                return false;
+
+            StoreU32( Dst.data(), Min );
+            Dst[4] = static_cast<std::byte>(Bits);
+
+            std::byte*    pOut  = &Dst[bitpack_header_v];
+            std::uint64_t Acc   = 0;
+            std::uint32_t nAcc  = 0;
+            for( std::size_t i = 0; i < n; ++i )
             {
-                // Set the index to the compatible pack
-                m_iPack = i;
+                Acc  |= static_cast<std::uint64_t>( LoadU32( &Src[i * 4] ) - Min ) << nAcc;
+                nAcc += Bits;
+                for( ; nAcc >= 8; nAcc -= 8, Acc >>= 8 ) *pOut++ = static_cast<std::byte>(Acc);
             }
-        }
+            if( nAcc ) *pOut++ = static_cast<std::byte>(Acc);
 
-        // Make sure we are at the end of the buffer before preallocating
-        // I have change the alignment from 4 to 8 because of 64 bits OS.
-        // it may help. In the future will be nice if the user could specify the alignment.
-        if ( auto Err = getW().SeekEnd(0); Err ) 
-            return {Err.m_pMessage};
+            std::memcpy( pOut, &Src[n * 4], Src.size() % 4 );
+            return true;
+        }
 
-        if (auto Err = getW().AlignPutC(' ', static_cast<int>(SizeofA) * static_cast<int>(Count), 8, false); Err)
-            return {Err.m_pMessage};
+        //------------------------------------------------------------------------------
 
-        //
-        // Store the pointer
-        //
+        static bool BitUnpack( std::span<std::byte> Dst, std::span<const std::byte> Src ) noexcept
         {
-            auto& Ref = m_pWrite->m_PointerTable.emplace_back();
-
-            std::size_t Pos;
-            if ( auto Err = getW().Tell(Pos); Err ) 
-                return {Err.m_pMessage};
+            if( Src.size() < bitpack_header_v ) 
+                return false;
 
-            Ref.m_PointingAT        = static_cast<std::uint32_t>(Pos);
-            Ref.m_OffsetPack        = BackupPackIndex;
-            Ref.m_OffSet            = m_ClassPos + ComputeLocalOffset(pA);
-            Ref.m_Count             = static_cast<std::uint32_t>(Count);
-            Ref.m_PointingATPack    = m_iPack;
+            const std::uint32_t Min  = LoadU32( Src.data() );
+            const std::uint32_t Bits = static_cast<std::uint32_t>( Src[4] );
+            if( Bits > 32 || Src.size() != BitPackSize( Dst.size(), Bits ) ) 
+                return false;
 
-            // We better be at the write spot that we are pointing at 
-#ifdef _DEBUG
+            const std::size_t   n    = Dst.size() / 4;
+            const std::uint64_t Mask = ( std::uint64_t{1} << Bits ) - 1;
+            const std::byte*    pIn  = &Src[bitpack_header_v];
+            std::uint64_t       Acc  = 0;
+            std::uint32_t       nAcc = 0;
+            for( std::size_t i = 0; i < n; ++i )
             {
-                assert( getW().Tell(Pos) == false );
-                assert( Ref.m_PointingAT == Pos );
+                for( ; nAcc < Bits; nAcc += 8 ) Acc |= static_cast<std::uint64_t>( *pIn++ ) << nAcc;
+                StoreU32( &Dst[i * 4], Min + static_cast<std::uint32_t>( Acc & Mask ) );
+                Acc  >>= Bits;
+                nAcc  -= Bits;
             }
-#endif
-        }
 
-        return {};
+            std::memcpy( &Dst[n * 4], Src.data() + Src.size() - Dst.size() % 4, Dst.size() % 4 );
+            return true;
+        }
     }
 
     //------------------------------------------------------------------------------
-
-    xerr stream::SaveFile(void) noexcept
+    // Built in codecs that filter a block and then compress it with xcompression 
+    // (bit packing is not compressed again, its output has little redundancy left)
+    //------------------------------------------------------------------------------
+    struct filter_codec final : codec_base
     {
-        //
-        // Go throw all the packs and compress them
-        //
-        for(std::uint32_t i = 0; i < m_pWrite->m_Packs.size(); i++ )
+        enum class kind : std::uint8_t
+        { SHUFFLE
+        , DELTA
+        , BITPACK
+        };
+
+        constexpr filter_codec( kind Kind, std::uint8_t ElementSize ) noexcept : m_Kind{ Kind }, m_ElementSize{ ElementSize } {}
+
+        xerr Compress( std::span<std::byte> Destination, std::span<const std::byte> Source, compression_level Level, std::size_t& CompressSize ) const noexcept override
         {
-            std::vector<std::byte>      RawData;
-            pack_writing&               Pack = m_pWrite->m_Packs[i];
+            if( m_Kind == kind::BITPACK )
+            {
+                if( filters::BitPack( Destination, Source, CompressSize ) == false )
+                    return xerr::create<state::FAILURE, "The block does not get smaller">();
+                return {};
+            }
 
+            thread_local std::vector<std::byte> Filtered, Packed;
+            Filtered.resize( Source.size() );
+            Packed.resize( Source.size() );
+
+            if( m_Kind == kind::DELTA )
+            {
+                std::memcpy( Packed.data(), Source.data(), Source.size() );
+                filters::DeltaEncode( Packed.data(), Packed.size() );
+                filters::Shuffle( Filtered.data(), Packed.data(), Source.size(), m_ElementSize );
+            }
+            else
             {
-                std::size_t Length;
-                if ( auto Err = Pack.m_Data.getFileLength(Length); Err ) 
-                    return {Err.m_pMessage};
+                filters::Shuffle( Filtered.data(), Source.data(), Source.size(), m_ElementSize );
+            }
+
+            // The block is compressed by itself, anything else than done in one go is taken as a failure
+            compressor Compressor;
+            if( auto Err = Compressor.Init( Source.size(), Filtered, Level ); Err )
+                return Err;
+
+            std::uint64_t Size = 0;
+            if( auto Err = Compressor.Pack( Size, Packed ); Err )
+                return Err;
+
+            if( Size > Destination.size() )
+                return xerr::create<state::FAILURE, "The block does not get smaller">();
+
+            std::memcpy( Destination.data(), Packed.data(), Size );
+            CompressSize = Size;
+            return {};
+        }
 
-                assert( Length <= std::numeric_limits<std::uint32_t>::max() );
-                Pack.m_UncompressSize = static_cast<std::uint32_t>(Length);
+        xerr Decompress( std::span<std::byte> Destination, std::span<const std::byte> Source ) const noexcept override
+        {
+            if( m_Kind == kind::BITPACK )
+            {
+                if( filters::BitUnpack( Destination, Source ) == false )
+                    return xerr::create<state::FAILURE, "Corrupted bit packed block">();
+                return {};
             }
 
-            Pack.m_CompressSize = 0;
-            Pack.m_BlockSize    = std::min(max_block_size_v, Pack.m_UncompressSize);
+            thread_local std::vector<std::byte> Filtered;
+            Filtered.resize( Destination.size() );
+
+            xcompression::dynamic_block_decompress Decompress;
+            if( auto Err = Decompress.Init( true, static_cast<std::uint32_t>(Destination.size()) ); Err )
+                return Err;
 
-            // Copy the pack into a memory buffer
-            RawData.resize(Pack.m_UncompressSize);
-            if( auto Err = Pack.m_Data.ToMemory(RawData); Err ) 
-                return { Err.m_pMessage };
+            std::uint32_t Size = 0;
+            if( auto Err = Decompress.Unpack( Size, Filtered, Source ); Err && Err.getState<xcompression::state>() != xcompression::state::NOT_DONE )
+                return Err;
 
-            //
-            // Now compress the memory
-            //
+            if( Size != Destination.size() )
+                return xerr::create<state::FAILURE, "Filtered block decompressed to the wrong size">();
+
+            switch( m_ElementSize )
             {
-                compressor Compress;
-                if (auto Err = Compress.Init( Pack.m_BlockSize, RawData, m_CompressionLevel); Err ) 
-                    return { Err.m_pMessage };
+            case 2:  filters::Unshuffle<2>( Destination.data(), Filtered.data(), Size ); break;
+            case 4:  filters::Unshuffle<4>( Destination.data(), Filtered.data(), Size ); break;
+            default: filters::Unshuffle<8>( Destination.data(), Filtered.data(), Size ); break;
+            }
 
-                // Guess data size assuming worse case number of blocks....
-                Pack.m_CompressData.resize(((Pack.m_UncompressSize / Pack.m_BlockSize) + 1) * Pack.m_BlockSize);
-                Pack.m_nBlocks = 0;
+            if( m_Kind == kind::DELTA ) filters::DeltaDecode( Destination.data(), Size );
+            return {};
+        }
 
-                while(true)
-                {
-                    std::uint64_t       CompressedSize;
-                    const std::uint64_t ToCompressSize  = std::min(RawData.size() - Compress.getPos(), static_cast<std::uint64_t>(Pack.m_BlockSize));
-                    auto                Err             = Compress.Pack(CompressedSize, std::span{ Pack.m_CompressData.data() + Pack.m_CompressSize, ToCompressSize });
+        kind            m_Kind;
+        std::uint8_t    m_ElementSize;
+    };
 
-                    if(Err)
-                    {
-                        if (Err.getState<xcompression::state>() == xcompression::state::INCOMPRESSIBLE)
-                        {
-                            assert( RawData.size() >= (Compress.getLastPosition() + ToCompressSize) );
-                            assert(Pack.m_CompressData.size() > Pack.m_CompressSize );
+    //------------------------------------------------------------------------------
+    // Codecs by id. XCOMPRESSION has no entry since it goes through its own path.
+    //------------------------------------------------------------------------------
+    static std::array<const codec_base*, 256>& getCodecTable( void ) noexcept
+    {
+        static constexpr store_codec              StoreCodec    {};
+        static constexpr filter_codec             Shuffle2Codec { filter_codec::kind::SHUFFLE, 2 };
+        static constexpr filter_codec             Shuffle4Codec { filter_codec::kind::SHUFFLE, 4 };
+        static constexpr filter_codec             Shuffle8Codec { filter_codec::kind::SHUFFLE, 8 };
+        static constexpr filter_codec             Delta4Codec   { filter_codec::kind::DELTA,   4 };
+        static constexpr filter_codec             BitPack4Codec { filter_codec::kind::BITPACK, 4 };
+        static std::array<const codec_base*, 256> Table         = []
+        {
+            std::array<const codec_base*, 256> Table {};
+            Table[static_cast<std::size_t>(codec_id::STORE)]    = &StoreCodec;
+            Table[static_cast<std::size_t>(codec_id::SHUFFLE2)] = &Shuffle2Codec;
+            Table[static_cast<std::size_t>(codec_id::SHUFFLE4)] = &Shuffle4Codec;
+            Table[static_cast<std::size_t>(codec_id::SHUFFLE8)] = &Shuffle8Codec;
+            Table[static_cast<std::size_t>(codec_id::DELTA4)]   = &Delta4Codec;
+            Table[static_cast<std::size_t>(codec_id::BITPACK4)] = &BitPack4Codec;
+            return Table;
+        }();
 
-                            memcpy_s( Pack.m_CompressData.data() + Pack.m_CompressSize, Pack.m_CompressData.size() - Pack.m_CompressSize,
-                                     RawData.data() + Compress.getLastPosition(), ToCompressSize );
+        return Table;
+    }
 
-                            m_pWrite->m_CSizeStream.push_back(static_cast<std::uint32_t>(ToCompressSize));
-                            Pack.m_CompressSize += static_cast<std::uint32_t>(ToCompressSize);
-                            Pack.m_nBlocks++;
-                            continue;
-                        }
-                        else  if (Err.getState<xcompression::state>() != xcompression::state::NOT_DONE)
-                        {
-                            assert(false);
-                            return Err;
-                        }
-                    }
+    //------------------------------------------------------------------------------
 
-                    //
-                    // Add to the total block if we have data to add
-                    //
-                    if (CompressedSize > 0 )
-                    {
-                        m_pWrite->m_CSizeStream.push_back(static_cast<std::uint32_t>(CompressedSize));
+    xerr RegisterCodec( codec_id ID, const codec_base& Codec ) noexcept
+    {
+        if( ID < codec_id::USER_FIRST || ID == codec_id::DEFAULT )
+            return xerr::create<state::FAILURE, "Codec ids below USER_FIRST are reserved">();
 
-                        // Get ready for the next block
-                        Pack.m_CompressSize += static_cast<std::uint32_t>(CompressedSize);
-                        Pack.m_nBlocks++;
-                    }
+        getCodecTable()[static_cast<std::size_t>(ID)] = &Codec;
+        return {};
+    }
 
-                    // Check if this was the last block...
-                    if (Err == false)
-                        break;
-                }
-            }
+    //------------------------------------------------------------------------------
 
-            //
-            // TODO: Could add a sanity check here and decompress the data and check if everything is OK
-            //
+    const codec_base* getCodec( codec_id ID ) noexcept
+    {
+        return getCodecTable()[static_cast<std::size_t>(ID)];
+    }
 
-            //
-            // Close the pack file
-            //
-            Pack.m_Data.close();
-        }
+    //------------------------------------------------------------------------------
 
-        //
-        // Take the references and the packs headers and compress them as well
-        //
-        std::vector<std::byte>          CompressInfoData;
-        std::uint64_t                   CompressInfoDataSize;
+    namespace details
+    {
+        static constexpr auto crc32c_tables_v = []
         {
-            std::vector<std::byte>      InfoData;
+            std::array<std::array<std::uint32_t, 256>, 8> Tables{};
 
-            // First update endianess 
-            if( m_pWrite->m_bEndian )
+            for( std::uint32_t i = 0; i < 256; ++i )
             {
-                for ( auto& E : m_pWrite->m_PointerTable )
-                {
-                    E.m_OffSet         = endian::Convert(E.m_OffSet);
-                    E.m_Count          = endian::Convert(E.m_Count);
-                    E.m_PointingAT     = endian::Convert(E.m_PointingAT);
-                    E.m_OffsetPack     = endian::Convert(E.m_OffsetPack);
-                    E.m_PointingATPack = endian::Convert(E.m_PointingATPack);
-                }
+                std::uint32_t C = i;
+                for( int k = 0; k < 8; ++k ) C = (C >> 1) ^ ((C & 1) ? 0x82F63B78u : 0u);
+                Tables[0][i] = C;
+            }
 
-                for( auto& E : m_pWrite->m_Packs )
-                {
-                    E.m_PackFlags.m_Value   = endian::Convert(E.m_PackFlags.m_Value);
-                    E.m_UncompressSize      = endian::Convert(E.m_UncompressSize);
-                    E.m_nBlocks             = endian::Convert(E.m_nBlocks);
-                }
+            for( std::size_t t = 1; t < Tables.size(); ++t )
+            for( std::uint32_t i = 0; i < 256; ++i )
+            {
+                Tables[t][i] = (Tables[t - 1][i] >> 8) ^ Tables[0][Tables[t - 1][i] & 0xFF];
+            }
+
+            return Tables;
+        }();
+
+        //------------------------------------------------------------------------------
+        // CRC32C (Castagnoli) of a block as it is in the file. SSE4.2 has an instruction
+        // for it, otherwise it goes 8 bytes at a time with tables (slicing by 8)
+        //------------------------------------------------------------------------------
+        static std::uint32_t Crc32c( std::span<const std::byte> Data ) noexcept
+        {
+            std::uint32_t       Crc = 0xFFFFFFFF;
+            const std::byte*    p   = Data.data();
+            std::size_t         n   = Data.size();
 
-                for( auto& E : m_pWrite->m_CSizeStream )
+        #if XSERIALIZER_SSE42
+            std::uint64_t Crc64 = Crc;
+            for( ; n >= 8; n -= 8, p += 8 )
+            {
+                std::uint64_t V;
+                std::memcpy( &V, p, sizeof(V) );
+                Crc64 = _mm_crc32_u64( Crc64, V );
+            }
+
+            Crc = static_cast<std::uint32_t>(Crc64);
+            for( ; n; --n, ++p ) Crc = _mm_crc32_u8( Crc, static_cast<std::uint8_t>(*p) );
+        #else
+            auto& T = crc32c_tables_v;
+            if constexpr ( std::endian::native == std::endian::little )
+            {
+                for( ; n >= 8; n -= 8, p += 8 )
                 {
-                    E = endian::Convert(E);
+                    std::uint64_t V;
+                    std::memcpy( &V, p, sizeof(V) );
+                    V ^= Crc;
+                    Crc = T[7][ V        & 0xFF] ^ T[6][(V >>  8) & 0xFF] ^ T[5][(V >> 16) & 0xFF] ^ T[4][(V >> 24) & 0xFF]
+                        ^ T[3][(V >> 32) & 0xFF] ^ T[2][(V >> 40) & 0xFF] ^ T[1][(V >> 48) & 0xFF] ^ T[0][ V >> 56        ];
                 }
             }
 
-            // Allocate all the memory that we will need
-            InfoData.resize( sizeof(pack)            * m_pWrite->m_Packs.size() 
-                           + sizeof(ref)             * m_pWrite->m_PointerTable.size() 
-                           + sizeof(std::uint32_t)   * m_pWrite->m_CSizeStream.size() );
+            for( ; n; --n, ++p ) Crc = (Crc >> 8) ^ T[0][(Crc ^ static_cast<std::uint8_t>(*p)) & 0xFF];
+        #endif
 
-            auto pPack          = reinterpret_cast<pack*>           (InfoData.data());
-            auto pRef           = reinterpret_cast<ref*>            (&pPack[m_pWrite->m_Packs.size()]);
-            auto pBlockSizes    = reinterpret_cast<std::uint32_t*>  (&pRef[m_pWrite->m_PointerTable.size()]);
+            return ~Crc;
+        }
+    }
 
-            CompressInfoData.resize(InfoData.size());
+    //------------------------------------------------------------------------------
+    // Compresses a range of bytes into blocks. The range can be a full pack (blocks
+    // are chained) or a single block (blocks are independent)
+    //------------------------------------------------------------------------------
+    struct compress_job
+    {
+        std::span<const std::byte>          m_Source        {};
+        std::uint32_t                       m_BlockSize     {};
+        std::uint32_t                       m_iPack         {};
+        const codec_base*                   m_pCodec        {};     // Null for xcompression, otherwise the job is a single block
+        std::vector<std::byte>              m_CompressData  {};
+        std::vector<std::uint32_t>          m_BlockSizes    {};
+        std::vector<std::uint32_t>          m_Checksums     {};     // One per block, only when the stream saves checksums
+        std::uint32_t                       m_nIncompressible{};    // Blocks that were stored as they are
+        xerr                                m_Error         {};
 
-#ifdef _DEBUG
+        void ComputeChecksums( void ) noexcept
+        {
+            std::size_t Offset = 0;
+            for( auto Size : m_BlockSizes )
             {
-                std::memset( CompressInfoData.data(), 0xBE, CompressInfoData.size() );
+                m_Checksums.push_back( details::Crc32c( std::span{ m_CompressData.data() + Offset, Size } ) );
+                Offset += Size;
             }
-#endif
+        }
 
-            // Now copy all the info starting with the packs
-            for( std::uint32_t i = 0; i < m_pWrite->m_Packs.size(); i++)
+        void Run( compression_level CompressionLevel ) noexcept
+        {
+            if( m_pCodec )
             {
-                pPack[i] = m_pWrite->m_Packs[i];
+                RunCodec( CompressionLevel );
+                return;
             }
 
-            // Now we copy all the references
-            for( std::uint32_t i = 0; i < m_pWrite->m_PointerTable.size(); i++)
+            compressor Compress;
+            if (auto Err = Compress.Init( m_BlockSize, m_Source, CompressionLevel); Err ) 
             {
-                pRef[i] = m_pWrite->m_PointerTable[i];
+                m_Error = Err;
+                return;
             }
 
-            // Now we copy all the block sizes
-            for(std::uint32_t i = 0; i < m_pWrite->m_CSizeStream.size(); i++)
-            {
-                pBlockSizes[i] = m_pWrite->m_CSizeStream[i];
-            }
+            // Guess data size assuming worse case number of blocks....
+            std::uint64_t CompressSize = 0;
+            m_CompressData.resize(((m_Source.size() / m_BlockSize) + 1) * m_BlockSize);
 
-            // 
-            // to compress it
-            //
+            while(true)
             {
-                compressor Compress;
-                if ( auto Err = Compress.Init( InfoData.size(), InfoData, m_CompressionLevel); Err ) 
-                    return Err;
+                std::uint64_t       CompressedSize;
+                const std::uint64_t ToCompressSize  = std::min(m_Source.size() - Compress.getPos(), static_cast<std::uint64_t>(m_BlockSize));
+                auto                Err             = Compress.Pack(CompressedSize, std::span{ m_CompressData.data() + CompressSize, ToCompressSize });
 
-                if (auto Err = Compress.Pack(CompressInfoDataSize, CompressInfoData); Err)
+                if(Err)
                 {
                     if (Err.getState<xcompression::state>() == xcompression::state::INCOMPRESSIBLE)
                     {
-                        memcpy(CompressInfoData.data(), InfoData.data(), InfoData.size() );
-                        CompressInfoDataSize = InfoData.size();
+                        assert( m_Source.size() >= (Compress.getLastPosition() + ToCompressSize) );
+                        assert( m_CompressData.size() > CompressSize );
+
+                        memcpy_s( m_CompressData.data() + CompressSize, m_CompressData.size() - CompressSize,
+                                  m_Source.data() + Compress.getLastPosition(), ToCompressSize );
+
+                        m_BlockSizes.push_back(static_cast<std::uint32_t>(ToCompressSize));
+                        CompressSize += ToCompressSize;
+                        m_nIncompressible++;
+                        continue;
                     }
-                    else
+                    else  if (Err.getState<xcompression::state>() != xcompression::state::NOT_DONE)
                     {
                         assert(false);
-                        return Err;
+                        m_Error = Err;
+                        return;
                     }
                 }
 
                 //
-                // TODO: Sanity check, We could uncompressed here if we wanted to...
+                // Add to the total block if we have data to add
                 //
-            }
-        }
+                if (CompressedSize > 0 )
+                {
+                    m_BlockSizes.push_back(static_cast<std::uint32_t>(CompressedSize));
 
-        //
-        // Fill up all the header information
-        //
-        m_Header.m_SerialFileVersion    = version_id_v;       // Major and minor version ( version pattern helps Identify file format as well)
-        m_Header.m_nPacks               = static_cast<std::uint16_t>(m_pWrite->m_Packs.size());
-        m_Header.m_nPointers            = static_cast<std::uint16_t>(m_pWrite->m_PointerTable.size());
-        m_Header.m_nBlockSizes          = static_cast<std::uint16_t>(m_pWrite->m_CSizeStream.size());
-        m_Header.m_SizeOfData           = 0;
-        m_Header.m_PackSize             = static_cast<std::uint32_t>(CompressInfoDataSize);
-        m_Header.m_AutomaticVersion     = m_ClassSize;
+                    // Get ready for the next block
+                    CompressSize += CompressedSize;
+                }
 
-        header  Header;
+                // Check if this was the last block...
+                if (Err == false)
+                    break;
+            }
 
-        if (m_pWrite->m_bEndian)
-        {
-            Header.m_SerialFileVersion  = endian::Convert(m_Header.m_SerialFileVersion);
-            Header.m_PackSize           = endian::Convert(m_Header.m_PackSize);
-            Header.m_MaxQualities       = endian::Convert(m_Header.m_MaxQualities);
-            Header.m_SizeOfData         = endian::Convert(m_Header.m_SizeOfData);
-            Header.m_nPointers          = endian::Convert(m_Header.m_nPointers);
-            Header.m_nPacks             = endian::Convert(m_Header.m_nPacks);
-            Header.m_nBlockSizes        = endian::Convert(m_Header.m_nBlockSizes);
-            Header.m_ResourceVersion    = endian::Convert(m_Header.m_ResourceVersion);
-            Header.m_AutomaticVersion   = endian::Convert(m_Header.m_AutomaticVersion);
+            m_CompressData.resize(CompressSize);
         }
-        else
+
+        // The block must come out smaller than the source, otherwise the loader would take it as raw
+        void RunCodec( compression_level CompressionLevel ) noexcept
         {
-            Header = m_Header;
-        }
+            assert( m_Source.size() <= m_BlockSize );
 
-        //
-        // Save everything into a file
-        //
-        std::size_t Pos;
-        if (auto Err = m_pWrite->m_pFile->Tell(Pos); Err)
-            return Err;
+            std::size_t CompressSize = 0;
+            m_CompressData.resize( m_Source.size() );
 
-        if( auto Err = m_pWrite->m_pFile->WriteSpan(std::span(reinterpret_cast<std::byte*>(&Header), sizeof(Header))); Err ) 
-            return Err;
+            if( m_Source.size() <= 1 
+                || m_pCodec->Compress( std::span{ m_CompressData.data(), m_Source.size() - 1 }, m_Source, CompressionLevel, CompressSize )
+                || CompressSize == 0 || CompressSize >= m_Source.size() )
+            {
+                std::memcpy( m_CompressData.data(), m_Source.data(), m_Source.size() );
+                CompressSize = m_Source.size();
+                m_nIncompressible++;
+            }
 
-        if( auto Err = m_pWrite->m_pFile->WriteSpan(std::span( CompressInfoData.begin(), CompressInfoData.begin() + CompressInfoDataSize) ); Err ) 
-            return Err;
+            m_CompressData.resize( CompressSize );
+            m_BlockSizes.push_back( static_cast<std::uint32_t>(CompressSize) );
+        }
+    };
 
-        for( auto& Pack : m_pWrite->m_Packs )
+    //------------------------------------------------------------------------------
+    // Decompresses a run of blocks into Destination. When the blocks are chained the
+    // run must be the full pack, independent blocks can be decompressed one by one.
+    //------------------------------------------------------------------------------
+    static
+    xerr DecompressBlocks
+    ( std::span<std::byte>              Destination
+    , const std::byte*                  pSource
+    , std::span<const std::uint32_t>    BlockSizes
+    , std::uint32_t                     BlockSize
+    , bool                              bIndependentBlocks 
+    , const codec_base*                 pCodec              // Null for xcompression
+    , const std::uint32_t*              pChecksums          // Checksum of each block, null to skip the check
+    , xcompression::dynamic_block_decompress& Decompress    // Reused by every call of the same thread
+    ) noexcept
+    {
+        std::size_t ReadSoFar = 0;
+
+        for( std::size_t i = 0; i < BlockSizes.size(); ++i )
         {
-            if( m_pWrite->m_bEndian )
+            const auto CompressSize = BlockSizes[i];
+
+            // A stored block is as big as the data it holds and a compressed one smaller
+            if( CompressSize > Destination.size() - ReadSoFar )
+                return xerr::create<state::FAILURE, "A block of the file is bigger than the room left in its pack">();
+
+            if( pChecksums && details::Crc32c( std::span{ pSource, CompressSize } ) != pChecksums[i] )
+                return xerr::create<state::FAILURE, "A block of the file is corrupted (wrong checksum)">();
+
+            // If we have the same size as the uncompress block means we did not compressed anything
+            if( CompressSize == BlockSize || CompressSize == (Destination.size() - ReadSoFar) )
+            {
+                std::memcpy( &Destination[ReadSoFar], pSource, CompressSize );
+                ReadSoFar += CompressSize;
+            }
+            else if( pCodec )
             {
-                if( auto Err = m_pWrite->m_pFile->WriteSpan( std::span( Pack.m_CompressData.begin(), Pack.m_CompressData.begin() + endian::Convert(Pack.m_CompressSize))); Err )
+                const std::size_t DecompressSize = std::min<std::size_t>( BlockSize, Destination.size() - ReadSoFar );
+                if( auto Err = pCodec->Decompress( Destination.subspan( ReadSoFar, DecompressSize ), std::span{ pSource, CompressSize } ); Err )
                     return Err;
+
+                ReadSoFar += DecompressSize;
             }
             else
             {
-                if( auto Err = m_pWrite->m_pFile->WriteSpan( std::span( Pack.m_CompressData.begin(), Pack.m_CompressData.begin() + Pack.m_CompressSize)); Err )
+                if( i == 0 || bIndependentBlocks )
+                {
+                    if (auto Err = Decompress.Init(true, BlockSize); Err)
+                        return Err;
+                }
+
+                std::uint32_t DecompressSize = 0;
+                auto Err = Decompress.Unpack( DecompressSize
+                                            , Destination.subspan(ReadSoFar)
+                                            , std::span<const std::byte>{ pSource, CompressSize } );
+                if( Err && Err.getState<xcompression::state>() != xcompression::state::NOT_DONE )
                     return Err;
+
+                ReadSoFar += DecompressSize;
             }
+
+            pSource += CompressSize;
         }
 
-        // Write the size of the data
-        {
-            std::size_t BytePos;
-            if ( auto Err = m_pWrite->m_pFile->Tell(BytePos); Err) 
-                return Err;
+        if( ReadSoFar != Destination.size() )
+            return xerr::create<state::FAILURE, "Decompressed size does not match the pack size">();
 
-            Pos = BytePos - Pos - sizeof(header);
-        }
+        return {};
+    }
 
-        Header.m_SizeOfData = static_cast<std::uint32_t>(Pos);
-        if (auto Err = m_pWrite->m_pFile->SeekOrigin( offsetof(header, m_SizeOfData) ); Err ) 
-            return Err;
+    //------------------------------------------------------------------------------
+    // Simple pool of threads which helps running loops in parallel.
+    // The thread that calls ParallelFor always takes part in the work so even if all the
+    // workers are busy (or there are none) the loop will still finish.
+    //------------------------------------------------------------------------------
+    class worker_pool
+    {
+    public:
 
-        if (m_pWrite->m_bEndian)
+        static worker_pool& getInstance( void ) noexcept
         {
-            Header.m_SizeOfData = endian::Convert(Header.m_SizeOfData);
+            static worker_pool Instance;
+            return Instance;
         }
 
-        if( auto Err = m_pWrite->m_pFile->Write(Header.m_SizeOfData); Err )
-            return Err;
+        template< typename T_FUNCTION >
+        void ParallelFor( std::uint32_t nThreads, std::size_t Count, T_FUNCTION&& Function ) noexcept
+        {
+            if( Count == 0 ) return;
 
-        // Go to the end of the file
-        if ( auto Err = m_pWrite->m_pFile->SeekEnd(0); Err ) 
-            return Err;
+            const std::size_t nHelpers = std::min<std::size_t>( std::min<std::size_t>(nThreads, Count) - 1, m_Threads.size() );
+            if( nHelpers == 0 )
+            {
+                for( std::size_t i = 0; i < Count; ++i ) Function(i);
+                return;
+            }
 
-        return {};
-    }
+            // The state is shared because helpers may wake up after the loop is already done
+            struct loop
+            {
+                std::function<void(std::size_t)>    m_Function  {};
+                std::size_t                         m_Count     {};
+                std::atomic<std::size_t>            m_Next      { 0 };
+                std::atomic<std::size_t>            m_nDone     { 0 };
+                std::mutex                          m_Mutex     {};
+                std::condition_variable             m_Done      {};
 
-    //------------------------------------------------------------------------------
+                void Work( void ) noexcept
+                {
+                    for( std::size_t i; (i = m_Next.fetch_add(1)) < m_Count; )
+                    {
+                        m_Function(i);
+                        if( (m_nDone.fetch_add(1) + 1) == m_Count )
+                        {
+                            std::lock_guard Lock( m_Mutex );
+                            m_Done.notify_all();
+                        }
+                    }
+                }
+            };
 
-    xerr stream::LoadHeader( xfile::stream& File, std::size_t SizeOfT) noexcept
-    {
-        //
-        // Check signature (version is encoded in signature)
-        //
-        if ( auto Err = File.ReadSpan(std::span<std::byte>{ reinterpret_cast<std::byte*>(&m_Header), sizeof(m_Header) }); Err )
-            return Err;
+            auto Loop = std::make_shared<loop>();
+            Loop->m_Function = std::forward<T_FUNCTION>(Function);
+            Loop->m_Count    = Count;
 
-        if( auto Err = File.Synchronize(true); Err ) 
-            return Err;
+            for( std::size_t i = 0; i < nHelpers; ++i ) 
+                Submit( [Loop]{ Loop->Work(); } );
+
+            Loop->Work();
+
+            std::unique_lock Lock( Loop->m_Mutex );
+            Loop->m_Done.wait( Lock, [&]{ return Loop->m_nDone.load() == Count; } );
+        }
 
-        if (m_Header.m_SerialFileVersion != version_id_v)
+        void Submit( std::function<void()>&& Job ) noexcept
         {
-            if ( endian::Convert(m_Header.m_SerialFileVersion) == version_id_v)
+            // Single core machines have no helpers
+            if( m_Threads.empty() )
             {
-                return xerr::create<state::WRONG_VERSION, "File can not be read. Probably it has the wrong endian.">();
+                Job();
+                return;
             }
 
-            return xerr::create<state::UNKOWN_FILE_TYPE, "Unknown file format (Could be an older version of the file format)">();
+            {
+                std::lock_guard Lock( m_Mutex );
+                m_Jobs.push_back( std::move(Job) );
+            }
+            m_Wakeup.notify_one();
         }
 
-        if (m_Header.m_AutomaticVersion != SizeOfT)
+    protected:
+
+        worker_pool( void ) noexcept
         {
-            return xerr::create<state::WRONG_VERSION, "The size of the structure that was used for writing this file is different from the one reading it">();
+            const auto nThreads = std::max( 1u, std::thread::hardware_concurrency() ) - 1;
+            for( std::uint32_t i = 0; i < nThreads; ++i )
+            {
+                m_Threads.emplace_back( [this]
+                {
+                    while(true)
+                    {
+                        std::function<void()> Job;
+                        {
+                            std::unique_lock Lock( m_Mutex );
+                            m_Wakeup.wait( Lock, [&]{ return m_bExit || !m_Jobs.empty(); } );
+                            if( m_Jobs.empty() ) return;
+                            Job = std::move( m_Jobs.front() );
+                            m_Jobs.pop_front();
+                        }
+                        Job();
+                    }
+                });
+            }
         }
 
-        return {};
-    }
+       ~worker_pool( void ) noexcept
+        {
+            {
+                std::lock_guard Lock( m_Mutex );
+                m_bExit = true;
+            }
+            m_Wakeup.notify_all();
+            for( auto& T : m_Threads ) T.join();
+        }
+
+    protected:
+
+        std::vector<std::thread>            m_Threads   {};
+        std::deque<std::function<void()>>   m_Jobs      {};
+        std::mutex                          m_Mutex     {};
+        std::condition_variable             m_Wakeup    {};
+        bool                                m_bExit     { false };
+    };
 
     //------------------------------------------------------------------------------
 
-    void* stream::LoadObject( xfile::stream& File ) noexcept
+    namespace endian
     {
-        unique_span<std::byte>           InfoData;                   // Buffer which contains all those arrays
-        unique_span<decompress_block>    ReadBuffer;
-        std::uint32_t                    iCurrentBuffer = 0;
+        constexpr static std::uint8_t Convert(std::uint8_t value) noexcept
+        {
+            return value;
+        }
 
-        //
-        // Allocate the read temp double buffer
-        //
-        ReadBuffer.New(2);
+        constexpr static std::uint16_t Convert(std::uint16_t value) noexcept
+        {
+            return (value >> 8) | (value << 8);
+        }
 
-        //
-        // Read the refs and packs
-        //
+        constexpr static std::uint32_t Convert(std::uint32_t value) noexcept
         {
-            // Create uncompress buffer for the packs and references
-            const auto DecompressSize = m_Header.m_nPacks      * sizeof(pack)
-                                      + m_Header.m_nPointers   * sizeof(ref)
-                                      + m_Header.m_nBlockSizes * sizeof(std::uint32_t);
+            return ((value >> 24) & 0xFF)       | ((value >> 8) & 0xFF00) |
+                   ((value <<  8) & 0xFF0000)   |  (value << 24);
+        }
 
-            assert(m_Header.m_PackSize <= DecompressSize);
-            InfoData.New(DecompressSize + m_Header.m_nPacks * sizeof(std::byte * *));
+        constexpr static std::uint64_t Convert(std::uint64_t value) noexcept
+        {
+            return  ((value >> 56) & 0xFF)              | ((value >> 40) & 0xFF00)          |
+                    ((value >> 24) & 0xFF0000)          | ((value >>  8) & 0xFF000000)      |
+                    ((value <<  8) & 0xFF00000000)      | ((value << 24) & 0xFF0000000000)  |
+                    ((value << 40) & 0xFF000000000000)  |  (value << 56);
+        }
 
-            // Uncompress in place for packs and references
-            if ( m_Header.m_PackSize < DecompressSize )
-            {
-                unique_span<std::byte>  CompressData;
+        //------------------------------------------------------------------------------
+        // Reverses the bytes of every N byte word of an array. pshufb does 16 (or 32 with
+        // AVX2) bytes at a time, plain SSE2 does the same with word shuffles and shifts
+        //------------------------------------------------------------------------------
+        template< std::size_t N >
+        static void SwapWords( std::byte* pData, std::size_t Size ) noexcept
+        {
+            static_assert( N == 2 || N == 4 || N == 8 );
+            using word = std::conditional_t< N == 2, std::uint16_t, std::conditional_t< N == 4, std::uint32_t, std::uint64_t > >;
 
-                CompressData.New(m_Header.m_PackSize);
+            assert( (Size % N) == 0 );
+            std::size_t i = 0;
 
-                if ( auto Err = File.ReadSpan(CompressData); Err )
-                {
-                    xerr::LogMessage<state::FAILURE>( std::format("ERROR:Serializer Load (1) Error {}", Err.getMessage() ) );
-                    Err.clear();
-                    return nullptr;
-                }
+        #if XSERIALIZER_SSSE3
+            static constexpr auto Shuffle = []
+            {
+                std::array<std::uint8_t, 16> Mask{};
+                for( std::size_t j = 0; j < Mask.size(); ++j ) Mask[j] = static_cast<std::uint8_t>( (j / N) * N + (N - 1 - j % N) );
+                return Mask;
+            }();
 
-                if ( auto Err = File.Synchronize(true); Err )
-                {
-                    assert(false);
-                    return nullptr;
-                }
+            const __m128i Mask128 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Shuffle.data()) );
 
-                // Actual decompress the block
-                if ( CompressData.size() == DecompressSize )
+            #if XSERIALIZER_AVX2
+                const __m256i Mask256 = _mm256_broadcastsi128_si256( Mask128 );
+                for( ; i + 32 <= Size; i += 32 )
                 {
-                    std::ranges::copy( InfoData.begin(), InfoData.end(), CompressData.begin());
+                    const __m256i V = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(pData + i) );
+                    _mm256_storeu_si256( reinterpret_cast<__m256i*>(pData + i), _mm256_shuffle_epi8( V, Mask256 ) );
                 }
-                else
-                {
-                    xcompression::dynamic_block_decompress Decompress;
-                    if ( auto Err = Decompress.Init(true, static_cast<std::uint32_t>(DecompressSize)); Err )
-                    {
-                        assert(false);
-                        return nullptr;
-                    }
+            #endif
 
-                    std::uint32_t BlockUncompressed=0;
-                    if ( auto Err = Decompress.Unpack(BlockUncompressed, InfoData, CompressData); Err )
-                    {
-                        assert(false);
-                        return nullptr;
-                    }
-                    assert(DecompressSize == BlockUncompressed);
-                }
+            for( ; i + 16 <= Size; i += 16 )
+            {
+                const __m128i V = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pData + i) );
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(pData + i), _mm_shuffle_epi8( V, Mask128 ) );
             }
-            else
+        #elif XSERIALIZER_SSE2
+            for( ; i + 16 <= Size; i += 16 )
             {
-                if ( auto Err = File.ReadSpan(std::span<std::byte>(InfoData.data(), m_Header.m_PackSize)); Err )
-                {
-                    xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (2) Error({})", Err.m_pMessage) );
-                    return nullptr;
-                }
+                __m128i V = _mm_loadu_si128( reinterpret_cast<const __m128i*>(pData + i) );
 
-                // Let as sync before moving forward...
-                if ( auto Err = File.Synchronize(true); Err )
-                {
-                    assert(false);
-                }
+                // Reverse the 16 bit words inside each element, then the bytes inside each 16 bit word
+                if constexpr ( N == 4 ) V = _mm_shufflehi_epi16( _mm_shufflelo_epi16( V, 0xB1 ), 0xB1 );
+                if constexpr ( N == 8 ) V = _mm_shufflehi_epi16( _mm_shufflelo_epi16( V, 0x1B ), 0x1B );
+                V = _mm_or_si128( _mm_slli_epi16( V, 8 ), _mm_srli_epi16( V, 8 ) );
+
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(pData + i), V );
+            }
+        #endif
+
+            for( ; i < Size; i += N )
+            {
+                word W;
+                std::memcpy( &W, pData + i, N );
+                W = Convert(W);
+                std::memcpy( pData + i, &W, N );
             }
         }
+    }
 
-        //
-        // Set up the all the pointers
-        //
-        auto const   pPack           = reinterpret_cast<const pack*>            (&InfoData[0]);
-        auto const   pRef            = reinterpret_cast<const ref*>             (&pPack[m_Header.m_nPacks]);
-        auto const   pBlockSizes     = reinterpret_cast<const std::uint32_t*>   (&pRef[m_Header.m_nPointers]);
-        auto const   pPackPointers   = const_cast<std::byte**>(reinterpret_cast<const std::byte* const*>(&pBlockSizes[m_Header.m_nBlockSizes]));
+    //------------------------------------------------------------------------------
 
-        //
-        // Start the reading and decompressing of the packs
-        //
+    void stream::SwapBytes( std::span<std::byte> Data, std::size_t SwapSize ) noexcept
+    {
+        assert( SwapSize && (Data.size() % SwapSize) == 0 );
+
+        switch( SwapSize )
         {
-            std::uint32_t                          iBlock = 0;
+        case 1:  break;
+        case 2:  endian::SwapWords<2>( Data.data(), Data.size() ); break;
+        case 4:  endian::SwapWords<4>( Data.data(), Data.size() ); break;
+        case 8:  endian::SwapWords<8>( Data.data(), Data.size() ); break;
+        default:
+            // Odd sizes such as long double
+            for( std::size_t i = 0; i < Data.size(); i += SwapSize )
+                std::reverse( Data.begin() + i, Data.begin() + i + SwapSize );
+            break;
+        }
+    }
 
-            for (std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++)
+    //------------------------------------------------------------------------------
+    // Variable length integers used by the relocation table
+    //------------------------------------------------------------------------------
+
+    namespace varint
+    {
+        static void Write( std::vector<std::byte>& Out, std::uint64_t Value ) noexcept
+        {
+            while( Value >= 0x80 )
             {
-                const pack&     Pack        = pPack[iPack];
-                std::uint32_t   nBlocks     = 0;
-                std::uint32_t   ReadSoFar   = 0;
+                Out.push_back( static_cast<std::byte>( Value | 0x80 ) );
+                Value >>= 7;
+            }
+            Out.push_back( static_cast<std::byte>(Value) );
+        }
 
-                xcompression::dynamic_block_decompress Decompress;
+        constexpr static std::uint64_t ZigZag( std::int64_t Value ) noexcept
+        {
+            return (static_cast<std::uint64_t>(Value) << 1) ^ static_cast<std::uint64_t>(Value >> 63);
+        }
 
-                // Initialize the decomporessor
-                const auto BlockSize = std::min(max_block_size_v, Pack.m_UncompressSize );
-                if (auto Err = Decompress.Init(true, BlockSize); Err)
-                {
-                    assert(false);
-                    return nullptr;
-                }
+        constexpr static std::int64_t UnZigZag( std::uint64_t Value ) noexcept
+        {
+            return static_cast<std::int64_t>(Value >> 1) ^ -static_cast<std::int64_t>(Value & 1);
+        }
 
-                // Start reading block immediately
-                // Note that the rest of the first block of a pack is interleave with the last pack last block
-                // except for the very first one (this one)
-                if (iPack == 0)
-                {
-                    if (auto Err = File.ReadSpan(std::span<std::byte>(reinterpret_cast<std::byte*>(&ReadBuffer[iCurrentBuffer]), pBlockSizes[iBlock])); Err)
-                    {
-                        xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (3) Error({})", Err.m_pMessage) );
-                        return nullptr;
-                    }
-                }
+        struct reader
+        {
+            std::span<const std::byte>  m_Data  {};
+            std::size_t                 m_Pos   {};
 
-                // Allocate the size of this pack
-                pPackPointers[iPack] = reinterpret_cast<std::byte*>( m_MemoryCallback.Allocate(Pack.m_PackFlags, Pack.m_UncompressSize, 16 ));
+            bool isDone( void ) const noexcept { return m_Pos >= m_Data.size(); }
 
-                // Store a block that is mark as temp (can/should only be one)
-                if (Pack.m_PackFlags.m_bTempMemory )
+            bool Read( std::uint64_t& Value ) noexcept
+            {
+                Value = 0;
+                for( int Shift = 0; Shift < 64 && m_Pos < m_Data.size(); Shift += 7 )
                 {
-                    assert(m_pTempBlockData == nullptr);
-                    m_pTempBlockData = pPackPointers[iPack];
+                    const auto Byte = static_cast<std::uint64_t>(m_Data[m_Pos++]);
+                    Value |= (Byte & 0x7F) << Shift;
+                    if( (Byte & 0x80) == 0 ) return true;
                 }
+                return false;
+            }
+        };
+    }
 
-                // Read each block
-                for ( std::uint32_t i=1; i< Pack.m_nBlocks; ++i )
-                {
-                    iCurrentBuffer = !iCurrentBuffer;
-                    iBlock++;
 
-                    // Start reading the next block
-                    if ( auto Err = File.Synchronize(true); Err )
-                    {
-                        assert(false);
-                    }
 
-                    if ( auto Err = File.ReadSpan(std::span{ reinterpret_cast<std::byte*>(&ReadBuffer[iCurrentBuffer]), static_cast<std::size_t>(pBlockSizes[iBlock]) }); Err )
-                    {
-                        xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Loading block (4) Error({})", Err.getMessage()));
-                        assert(false);
-                        return nullptr;
-                    }
+    //------------------------------------------------------------------------------
+    // loader_context
+    //------------------------------------------------------------------------------
 
-                    //
-                    // Start the decompressing at the same time
-                    //
-                    assert(pPackPointers[iPack]);
+    loader_context::loader_context( void ) noexcept
+        : m_Scratch{ std::make_unique<details::loader_scratch>() }
+    {
+    }
 
-                    // Check if the compressor failed to compress the data if so we must just copy the block
-                    if( pBlockSizes[iBlock - 1] == BlockSize)
-                    {
-                        auto dest = std::span<std::byte>{&pPackPointers[iPack][ReadSoFar], Pack.m_UncompressSize - ReadSoFar };
-                        auto src  = std::span<std::byte>{reinterpret_cast<std::byte*>(&ReadBuffer[!iCurrentBuffer]), pBlockSizes[iBlock - 1]};
-                        std::ranges::copy( src, dest.begin());
-                        ReadSoFar += BlockSize;
-                    }
-                    else
-                    {
-                        std::uint32_t DecompressSize = 0;
-                        auto Err = Decompress.Unpack(DecompressSize
-                                        , std::span<std::byte>{&pPackPointers[iPack][ReadSoFar], Pack.m_UncompressSize - ReadSoFar}
-                                        , std::span<const std::byte>{reinterpret_cast<const std::byte*>(&ReadBuffer[!iCurrentBuffer]), pBlockSizes[iBlock - 1]});
-                        assert( Err == false || Err.getState<xcompression::state>() == xcompression::state::NOT_DONE);
-                        ReadSoFar += DecompressSize;
-                    }
-                }
+    //------------------------------------------------------------------------------
 
-                // Finish reading the block
-                if ( auto Err = File.Synchronize(true); Err )
-                {
-                    assert(false);
-                }
+    loader_context::~loader_context( void ) noexcept = default;
 
-                // Interleave next pack block with this last pack block
-                if ((iPack + 1) < m_Header.m_nPacks)
-                {
-                    if (auto Err = File.ReadSpan(std::span<std::byte>(reinterpret_cast<std::byte*>(&ReadBuffer[!iCurrentBuffer]), pBlockSizes[iBlock + 1])); Err )
-                    {
-                        xerr::LogMessage<state::FAILURE>( std::format("ERROR:Serializer Load (5) Error({})", Err.m_pMessage) );
-                        assert(false);
-                        return nullptr;
-                    }
-                }
+    //------------------------------------------------------------------------------
 
-                //
-                // Decompress last block for this pack
-                //
-                assert(pPackPointers[iPack]);
+    void loader_context::Release( void ) noexcept
+    {
+        m_Scratch = std::make_unique<details::loader_scratch>();
+    }
 
-                if ( pBlockSizes[iBlock] == BlockSize || Pack.m_UncompressSize == (ReadSoFar + pBlockSizes[iBlock]) )
-                {
-                    // If we has the same size as the uncompress block means we did not compressed anything
-                    std::memcpy(&pPackPointers[iPack][ReadSoFar], &ReadBuffer[iCurrentBuffer], pBlockSizes[iBlock]);
-                    ReadSoFar += pBlockSizes[iBlock];
-                }
-                else
+    //------------------------------------------------------------------------------
+
+    std::size_t loader_context::getScratchSize( void ) const noexcept
+    {
+        return m_Scratch->m_Tables.capacity()
+             + m_Scratch->m_Staging.capacity()
+             + m_Scratch->m_PackPointers.capacity() * sizeof(std::byte*)
+             + m_Scratch->m_BlockOffsets.capacity() * sizeof(std::uint64_t)
+             + m_Scratch->m_Checksums.capacity()    * sizeof(std::uint32_t)
+             + m_Scratch->m_Jobs.capacity()         * sizeof(details::decompress_job);
+    }
+
+    //------------------------------------------------------------------------------
+
+    loader_context& loader_context::getThreadContext( void ) noexcept
+    {
+        thread_local loader_context Context;
+        return Context;
+    }
+
+    //------------------------------------------------------------------------------
+
+    loader_context& stream::getLoaderContext( void ) const noexcept
+    {
+        return m_pLoaderContext ? *m_pLoaderContext : loader_context::getThreadContext();
+    }
+
+    //------------------------------------------------------------------------------
+    // stats
+    //------------------------------------------------------------------------------
+
+    void stats::Reset( void ) noexcept
+    {
+        for( auto& Duration : m_Durations ) Duration.store( 0, std::memory_order_relaxed );
+        for( auto& Count    : m_nStages )   Count.store( 0, std::memory_order_relaxed );
+        for( auto& Counter  : m_Counters )  Counter.store( 0, std::memory_order_relaxed );
+
+        std::lock_guard Lock( m_EventsMutex );
+        m_Events.clear();
+        m_Epoch = clock::now();
+    }
+
+    //------------------------------------------------------------------------------
+
+    void stats::AddStage( stage Stage, clock::time_point Start, clock::time_point End ) noexcept
+    {
+        const auto Duration = static_cast<std::uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( End - Start ).count() );
+
+        m_Durations[static_cast<std::size_t>(Stage)].fetch_add( Duration, std::memory_order_relaxed );
+        m_nStages[static_cast<std::size_t>(Stage)].fetch_add( 1, std::memory_order_relaxed );
+
+        if( m_bTrace == false ) 
+            return;
+
+        // Threads get a small id the first time they add an event
+        static std::atomic<std::uint32_t>   s_NextThreadID  { 1 };
+        thread_local const std::uint32_t    ThreadID        = s_NextThreadID.fetch_add( 1, std::memory_order_relaxed );
+
+        // The epoch is read under the lock because Reset changes it
+        std::lock_guard Lock( m_EventsMutex );
+        m_Events.push_back( event
+        { .m_Start      = static_cast<std::uint64_t>( std::max<std::int64_t>( 0, std::chrono::duration_cast<std::chrono::nanoseconds>( Start - m_Epoch ).count() ) )
+        , .m_Duration   = Duration
+        , .m_ThreadID   = ThreadID
+        , .m_Stage      = Stage
+        });
+    }
+
+    //------------------------------------------------------------------------------
+
+    std::vector<stats::event> stats::getEvents( void ) const noexcept
+    {
+        std::lock_guard Lock( m_EventsMutex );
+        return m_Events;
+    }
+
+    //------------------------------------------------------------------------------
+
+    const char* stats::getName( stage Stage ) noexcept
+    {
+        constexpr static std::array<const char*, num_stages_v> Names
+        { "SaveSerialize", "SaveCompress", "SaveTables", "SaveWrite"
+        , "LoadHeader", "LoadTables", "LoadIOWait", "LoadDecompress", "LoadAllocate", "LoadFixup"
+        };
+        return Names[static_cast<std::size_t>(Stage)];
+    }
+
+    //------------------------------------------------------------------------------
+
+    const char* stats::getName( counter Counter ) noexcept
+    {
+        constexpr static std::array<const char*, num_counters_v> Names
+        { "BytesRead", "BytesWritten", "BytesDecompressed", "BytesCompressed"
+        , "Packs", "Blocks", "Pointers", "Allocations", "IncompressibleBlocks", "BytesDeduplicated"
+        };
+        return Names[static_cast<std::size_t>(Counter)];
+    }
+
+    //------------------------------------------------------------------------------
+    // Chrome trace-event format: a complete event ("X") per stage and the counters 
+    // as a counter event ("C") at the end. Times are in microseconds.
+    //------------------------------------------------------------------------------
+
+    void stats::getChromeTrace( std::string& Json ) const noexcept
+    {
+        const auto  Events  = getEvents();
+        auto        Out     = std::back_inserter( Json );
+        std::uint64_t End   = 0;
+
+        Json += "{\"traceEvents\":[\n";
+        for( const auto& Event : Events )
+        {
+            std::format_to( Out, "{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}},\n"
+                          , getName(Event.m_Stage)
+                          , Event.m_Stage < stage::LOAD_HEADER ? "save" : "load"
+                          , Event.m_ThreadID
+                          , Event.m_Start    / 1000.0
+                          , Event.m_Duration / 1000.0 );
+
+            End = std::max( End, Event.m_Start + Event.m_Duration );
+        }
+
+        std::format_to( Out, "{{\"name\":\"Counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":{:.3f},\"args\":{{", End / 1000.0 );
+        for( std::size_t i = 0; i < num_counters_v; ++i )
+        {
+            std::format_to( Out, "{}\"{}\":{}", i ? "," : "", getName(static_cast<counter>(i)), getCounter(static_cast<counter>(i)) );
+        }
+        Json += "}}\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stats::SaveChromeTrace( const std::wstring_view FileName ) const noexcept
+    {
+        std::string Json;
+        getChromeTrace( Json );
+
+        xfile::stream File;
+        if( auto Err = File.open( FileName, "wb" ); Err )
+            return Err;
+
+        if( auto Err = File.WriteSpan( std::span{ reinterpret_cast<const std::byte*>(Json.data()), Json.size() } ); Err )
+            return Err;
+
+        File.close();
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // pool_memory_handler
+    //------------------------------------------------------------------------------
+
+    pool_memory_handler::~pool_memory_handler( void ) noexcept
+    {
+        for( auto pSlab : m_Slabs )
+            _aligned_free( pSlab );
+    }
+
+    //------------------------------------------------------------------------------
+
+    void* pool_memory_handler::Allocate( mem_type Type, std::size_t Size, std::size_t Alignment ) const noexcept
+    {
+        if( Type.m_bVRam )
+        {
+            // VRAM memory
+            assert(false);
+            return nullptr;
+        }
+
+        constexpr std::size_t MaxClassSize = min_class_size_v << (num_classes_v - 1);
+        if( Alignment <= sizeof(block_header) && Size <= MaxClassSize )
+        {
+            const auto iClass = static_cast<std::uint32_t>( std::bit_width( (std::max(Size, min_class_size_v) - 1) / min_class_size_v ) );
+            assert( iClass < num_classes_v );
+
+            std::scoped_lock Lock( m_Mutex );
+
+            // Carve a new slab when the class runs out (the biggest classes get one block per slab)
+            if( m_FreeList[iClass] == nullptr )
+            {
+                const std::size_t Stride  = sizeof(block_header) + (min_class_size_v << iClass);
+                const std::size_t nBlocks = std::max<std::size_t>( 1, slab_size_v / Stride );
+                auto const        pSlab   = reinterpret_cast<std::byte*>( _aligned_malloc( Stride * nBlocks, 64 ) );
+                if( pSlab == nullptr )
+                    return nullptr;
+
+                m_Slabs.push_back( pSlab );
+                for( std::size_t i = nBlocks; i--; )
                 {
-                    std::uint32_t DecompressSize = 0;
-                    auto Err = Decompress.Unpack(DecompressSize
-                                    , std::span<std::byte>{&pPackPointers[iPack][ReadSoFar], Pack.m_UncompressSize - ReadSoFar }
-                                    , std::span<std::byte>{reinterpret_cast<std::byte*>(&ReadBuffer[iCurrentBuffer]), pBlockSizes[iBlock]});
-                    assert( Err == false );
-                    ReadSoFar += DecompressSize;
+                    auto pHeader = reinterpret_cast<block_header*>( pSlab + i * Stride );
+                    pHeader->m_iClass   = iClass;
+                    pHeader->m_Offset   = 0;
+                    pHeader->m_pNext    = m_FreeList[iClass];
+                    m_FreeList[iClass]  = pHeader;
                 }
-                assert(ReadSoFar == Pack.m_UncompressSize);
+            }
 
-                //
-                // Get ready for next block
-                //
-                iCurrentBuffer = !iCurrentBuffer;
-                iBlock++;
+            auto pHeader = m_FreeList[iClass];
+            m_FreeList[iClass] = pHeader->m_pNext;
+            return pHeader + 1;
+        }
+
+        // Big or over aligned blocks go straight to the heap
+        Alignment = std::max( Alignment, sizeof(block_header) );
+        auto const pBase = reinterpret_cast<std::byte*>( _aligned_malloc( Size + Alignment, Alignment ) );
+        if( pBase == nullptr )
+            return nullptr;
+
+        auto pHeader = reinterpret_cast<block_header*>( pBase + Alignment ) - 1;
+        pHeader->m_iClass = large_class_v;
+        pHeader->m_Offset = static_cast<std::uint32_t>( Alignment - sizeof(block_header) );
+        return pBase + Alignment;
+    }
+
+    //------------------------------------------------------------------------------
+
+    void pool_memory_handler::Free( mem_type Type, void* pMemory ) const noexcept
+    {
+        if( pMemory == nullptr )
+            return;
+
+        if( Type.m_bVRam )
+        {
+            // VRAM memory
+            assert(false);
+            return;
+        }
+
+        auto pHeader = reinterpret_cast<block_header*>( pMemory ) - 1;
+        if( pHeader->m_iClass == large_class_v )
+        {
+            _aligned_free( reinterpret_cast<std::byte*>(pHeader) - pHeader->m_Offset );
+            return;
+        }
+
+        assert( pHeader->m_iClass < num_classes_v );
+
+        std::scoped_lock Lock( m_Mutex );
+        pHeader->m_pNext = m_FreeList[pHeader->m_iClass];
+        m_FreeList[pHeader->m_iClass] = pHeader;
+    }
+
+    //------------------------------------------------------------------------------
+    // arena_memory_handler
+    //------------------------------------------------------------------------------
+
+    void* arena_memory_handler::Allocate( mem_type Type, std::size_t Size, std::size_t Alignment ) const noexcept
+    {
+        assert( Alignment && (Alignment & (Alignment - 1)) == 0 );
+
+        if( Type.m_bVRam )
+        {
+            // VRAM memory
+            assert(false);
+            return nullptr;
+        }
+
+        auto AlignUp = [&]( std::byte* p )
+        {
+            return reinterpret_cast<std::byte*>( (reinterpret_cast<std::uintptr_t>(p) + Alignment - 1) & ~static_cast<std::uintptr_t>(Alignment - 1) );
+        };
+
+        if( m_pCurrent == nullptr || static_cast<std::size_t>(m_pEnd - m_pCurrent) < Size + Alignment )
+        {
+            // Requests that don't fit in a regular chunk get one of their own
+            const std::size_t ChunkSize = std::max( m_ChunkSize, sizeof(chunk) + Size + Alignment );
+            auto const        pChunk    = reinterpret_cast<chunk*>( m_Backing.Allocate( mem_type{}, ChunkSize, 16 ) );
+            if( pChunk == nullptr )
+                return nullptr;
+
+            pChunk->m_pNext = m_pChunks;
+            pChunk->m_Size  = ChunkSize;
+            m_pChunks       = pChunk;
+            m_AllocatedSize += Size;
+
+            if( ChunkSize > m_ChunkSize )
+                return AlignUp( reinterpret_cast<std::byte*>(pChunk + 1) );
+
+            m_pCurrent = reinterpret_cast<std::byte*>(pChunk + 1);
+            m_pEnd     = reinterpret_cast<std::byte*>(pChunk) + ChunkSize;
+        }
+        else
+        {
+            m_AllocatedSize += Size;
+        }
+
+        auto const pData = AlignUp( m_pCurrent );
+        m_pCurrent = pData + Size;
+        assert( m_pCurrent <= m_pEnd );
+        return pData;
+    }
+
+    //------------------------------------------------------------------------------
+
+    void arena_memory_handler::Reset( void ) noexcept
+    {
+        while( m_pChunks )
+        {
+            auto const pNext = m_pChunks->m_pNext;
+            m_Backing.Free( mem_type{}, m_pChunks );
+            m_pChunks = pNext;
+        }
+
+        m_pCurrent      = nullptr;
+        m_pEnd          = nullptr;
+        m_AllocatedSize = 0;
+    }
+
+    //------------------------------------------------------------------------------
+
+    stream::stream(const memory_handle_base& MemoryHandler) noexcept
+        : m_MemoryCallback{ MemoryHandler }
+    {
+    }
+
+    //------------------------------------------------------------------------------
+
+    std::uint32_t stream::writing::AllocatePack( mem_type DefaultPackFlags, std::uint8_t Quality, codec_id Codec ) noexcept
+    {
+        // Create the default pack
+        auto& WPack = m_Packs.emplace_back();
+        WPack.m_PackFlags = DefaultPackFlags;
+        WPack.m_Quality   = Quality;
+        WPack.m_Codec     = Codec;
+
+        // Streamed packs are split in blocks from the start
+        WPack.m_bStreaming = m_pTarget != nullptr;
+        WPack.m_BlockSize  = m_StreamBlockSize;
+
+        return static_cast<std::uint32_t>(m_Packs.size() - 1);
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::HandlePtrDetails( const std::byte* pA, std::size_t SizeofA, std::size_t Count, mem_type MemoryFlags, std::uint8_t Quality, codec_id Codec ) noexcept
+    {
+        // Data that can only be reached from a fine quality tier is part of that tier as well
+        Quality = std::max( Quality, m_pWrite->m_Packs[m_iPack].m_Quality );
+        if( Codec == codec_id::DEFAULT ) Codec = m_Codec;
+
+        // If the parent is in not in a common pool then its children must also not be in a common pool.
+        // The theory is that if the parent is not in a common pool it could be deallocated and if the child 
+        // is in a common pool it could be left orphan. However this may need to be thought out more carefully
+        // so I am playing it safe for now.
+        if( m_pWrite->m_Packs[m_iPack].m_PackFlags.m_bUnique )
+        {
+            assert(MemoryFlags.m_bUnique);
+        }
+        else if (m_pWrite->m_Packs[m_iPack].m_PackFlags.m_bTempMemory)
+        {
+            assert(MemoryFlags.m_bTempMemory);
+        }
+
+        //
+        // If we don't have any elements then just write the pointer raw
+        //
+        if (Count == 0)
+        {
+            // always write 64 bits worth (assuming user is using xserialfile::ptr)
+            // if we do not do this the upper bits of the 64 bits may contain trash
+            // and if the compiler is 32bits and the game 64 then that trash can crash
+            // the game.
+            if( auto Err = Serialize(*((std::uint64_t*)(pA))); Err )
+                return Err;
+
+            return {};
+        }
+
+        //
+        // Choose the right pack for this allocation        
+        //
+
+        // Back up the current pack
+        auto BackupPackIndex = m_iPack;
+
+        if( MemoryFlags.m_bUnique )
+        {
+            // Create a pack
+            m_iPack = m_pWrite->AllocatePack(MemoryFlags, Quality, Codec);
+        }
+        else
+        {
+            // Search for a pool which matches our attributes
+            std::uint32_t i;
+            constexpr static auto non_unique_v = []() consteval { mem_type x {.m_bUnique = false, .m_bTempMemory = true, .m_bVRam = true}; return x; }();
+            for (i = 0; i < m_pWrite->m_Packs.size(); i++)
+            {
+                if( (m_pWrite->m_Packs[i].m_PackFlags.m_Value & non_unique_v.m_Value ) == MemoryFlags.m_Value 
+                    && m_pWrite->m_Packs[i].m_Quality == Quality 
+                    && m_pWrite->m_Packs[i].m_Codec   == Codec )
+                    break;
+            }
+
+            // Could not find a pack with compatible flags so just create a new one
+            if (i == m_pWrite->m_Packs.size())
+            {
+                // Create a pack
+                m_iPack = m_pWrite->AllocatePack(MemoryFlags, Quality, Codec);
+            }
+            else
+            {
+                // Set the index to the compatible pack
+                m_iPack = i;
             }
         }
 
+        // Preallocate at the end of the buffer
+        // I have change the alignment from 4 to 8 because of 64 bits OS.
+        // it may help. In the future will be nice if the user could specify the alignment.
+        const std::size_t Pos = getW().Reserve( SizeofA * Count, 8 );
+
         //
-        // Resolve pointers
+        // Store the pointer
         //
-        for (std::uint32_t i = 0; i < m_Header.m_nPointers; i++)
         {
-            const ref&                   Ref       = pRef[i];
-            void* const                  pSrcData  = &pPackPointers[Ref.m_PointingATPack][Ref.m_PointingAT];
-            xserializer::data_ptr<void>* pDestData = reinterpret_cast<xserializer::data_ptr<void>*>(&pPackPointers[Ref.m_OffsetPack][Ref.m_OffSet]);
+            auto& Ref = m_pWrite->m_PointerTable.emplace_back();
 
-            pDestData->m_pValue = pSrcData;
+            Ref.m_PointingAT        = Pos;
+            Ref.m_OffsetPack        = BackupPackIndex;
+            Ref.m_OffSet            = m_ClassPos + ComputeLocalOffset(pA);
+            Ref.m_Count             = Count;
+            Ref.m_PointingATPack    = m_iPack;
+
+            // We better be at the write spot that we are pointing at 
+            assert( Ref.m_PointingAT == getW().m_Position );
         }
 
-        // Return the basic pack
-        return pPackPointers[0];
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // The buffer that was just written is at the end of its pack, if it is a copy of a
+    // buffer that was written before it gets dropped and the pointer goes to the first one
+    //------------------------------------------------------------------------------
+
+    void stream::DeduplicatePointer( std::uint64_t DataPos, std::uint64_t DataSize ) noexcept
+    {
+        auto& Pack = getW();
+
+        if( Pack.m_PackFlags.m_bUnique || Pack.m_bStreaming || Pack.m_Data.size() != DataPos + DataSize )
+            return;
+
+        const std::span<const std::byte> Data{ &Pack.m_Data[static_cast<std::size_t>(DataPos)], static_cast<std::size_t>(DataSize) };
+        const std::uint32_t              Hash = details::Crc32c( Data );
+
+        for( auto [ It, End ] = m_pWrite->m_Dedup.equal_range( Hash ); It != End; ++It )
+        {
+            const auto& First = It->second;
+            if( First.m_iPack != m_iPack || First.m_Size != DataSize 
+                || std::memcmp( &Pack.m_Data[static_cast<std::size_t>(First.m_Position)], Data.data(), Data.size() ) )
+                continue;
+
+            // The ref of this buffer is the last one since the buffer has no pointers
+            auto& Ref = m_pWrite->m_PointerTable.back();
+            assert( Ref.m_PointingATPack == m_iPack && Ref.m_PointingAT == DataPos );
+            Ref.m_PointingAT = First.m_Position;
+
+            Pack.m_Data.resize( static_cast<std::size_t>(DataPos) );
+            Pack.m_Position = Pack.m_Data.size();
+
+            if( m_pStats ) m_pStats->AddCounter( stats::counter::BYTES_DEDUPLICATED, DataSize );
+            return;
+        }
+
+        m_pWrite->m_Dedup.emplace( Hash, dedup_entry{ .m_Position = DataPos, .m_Size = DataSize, .m_iPack = m_iPack } );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::HandleRelPtrDetails( const std::byte* pA, std::size_t SizeofA, std::size_t Count ) noexcept
+    {
+        const std::size_t PointerPos = m_ClassPos + ComputeLocalOffset(pA);
+
+        // A null pointer is just a zero offset
+        if (Count == 0)
+        {
+            const std::int32_t Zero = 0;
+            getW().Write( PointerPos, std::span{ reinterpret_cast<const std::byte*>(&Zero), sizeof(Zero) } );
+            return {};
+        }
+
+        // Reserve the space for the data at the end of the current pack
+        const std::size_t DataPos = getW().Reserve( SizeofA * Count, 8 );
+
+        // The data is always after the pointer
+        assert(DataPos > PointerPos);
+        if( (DataPos - PointerPos) > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max()) )
+            return xerr::create<state::FAILURE, "The data of a rel_ptr is too far away from the pointer">();
+
+        // Write the offset
+        const auto Offset = m_pWrite->m_bEndian 
+                          ? static_cast<std::int32_t>(endian::Convert(static_cast<std::uint32_t>(DataPos - PointerPos)))
+                          : static_cast<std::int32_t>(DataPos - PointerPos);
+        getW().Write( PointerPos, std::span{ reinterpret_cast<const std::byte*>(&Offset), sizeof(Offset) } );
+
+        // Get ready to write the data
+        getW().m_Position = DataPos;
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Sorts the pointers by where they live and writes them in the compact relocation 
+    // table format (see the ref structure for the layout).
+    //------------------------------------------------------------------------------
+
+    void stream::EncodeRelocations( std::vector<ref>& Refs, std::vector<std::byte>& Table ) noexcept
+    {
+        Table.clear();
+        if( Refs.empty() ) return;
+
+        std::ranges::sort( Refs, []( const ref& A, const ref& B )
+        {
+            if( A.m_OffsetPack != B.m_OffsetPack ) return A.m_OffsetPack < B.m_OffsetPack;
+            return A.m_OffSet < B.m_OffSet;
+        });
+
+        std::vector<std::uint32_t>  ChunkStarts;
+        std::vector<std::byte>      Runs;
+        std::uint32_t               OffsetPack      = 0;
+        std::uint32_t               TargetPack      = 0;
+        std::uint64_t               OffsetCursor    = 0;
+        std::uint64_t               TargetCursor    = 0;
+        std::size_t                 nInChunk        = reloc_chunk_size_v;
+
+        for( std::size_t i = 0; i < Refs.size(); )
+        {
+            const ref& First = Refs[i];
+
+            // Every chunk starts with a clean state so it can be resolved without the previous ones
+            const bool bNewChunk = nInChunk >= reloc_chunk_size_v;
+            if( bNewChunk )
+            {
+                assert( Runs.size() <= std::numeric_limits<std::uint32_t>::max() );
+                ChunkStarts.push_back( static_cast<std::uint32_t>(Runs.size()) );
+                nInChunk = 0;
+            }
+
+            // Collapse all the following pointers that keep the same strides
+            std::uint64_t   nExtra          = 0;
+            std::uint64_t   OffsetStride    = 0;
+            std::int64_t    TargetStride    = 0;
+            auto isSamePacks = [&]( const ref& R ) { return R.m_OffsetPack == First.m_OffsetPack && R.m_PointingATPack == First.m_PointingATPack; };
+
+            if( (i + 1) < Refs.size() && (nInChunk + 1) < reloc_chunk_size_v && isSamePacks(Refs[i + 1]) )
+            {
+                OffsetStride = Refs[i + 1].m_OffSet - First.m_OffSet;
+                TargetStride = static_cast<std::int64_t>(Refs[i + 1].m_PointingAT - First.m_PointingAT);
+                nExtra       = 1;
+
+                while( (i + nExtra + 1) < Refs.size() && (nInChunk + nExtra + 1) < reloc_chunk_size_v )
+                {
+                    const ref& Prev = Refs[i + nExtra];
+                    const ref& Next = Refs[i + nExtra + 1];
+                    if( isSamePacks(Next) == false 
+                        || (Next.m_OffSet - Prev.m_OffSet) != OffsetStride 
+                        || static_cast<std::int64_t>(Next.m_PointingAT - Prev.m_PointingAT) != TargetStride ) 
+                        break;
+                    nExtra++;
+                }
+            }
+
+            const bool bNewOffsetPack = bNewChunk || First.m_OffsetPack     != OffsetPack;
+            const bool bNewTargetPack = bNewChunk || First.m_PointingATPack != TargetPack;
+
+            varint::Write( Runs, (nExtra << 2) | (bNewTargetPack ? 2 : 0) | (bNewOffsetPack ? 1 : 0) );
+
+            if( bNewOffsetPack )
+            {
+                OffsetPack   = First.m_OffsetPack;
+                OffsetCursor = 0;
+                varint::Write( Runs, OffsetPack );
+            }
+
+            if( bNewTargetPack )
+            {
+                TargetPack   = First.m_PointingATPack;
+                TargetCursor = 0;
+                varint::Write( Runs, TargetPack );
+            }
+
+            varint::Write( Runs, First.m_OffSet - OffsetCursor );
+            varint::Write( Runs, varint::ZigZag( static_cast<std::int64_t>(First.m_PointingAT - TargetCursor) ) );
+
+            if( nExtra )
+            {
+                varint::Write( Runs, OffsetStride );
+                varint::Write( Runs, varint::ZigZag(TargetStride) );
+            }
+
+            OffsetCursor = First.m_OffSet     + nExtra * OffsetStride;
+            TargetCursor = First.m_PointingAT + nExtra * static_cast<std::uint64_t>(TargetStride);
+            nInChunk    += nExtra + 1;
+            i           += nExtra + 1;
+        }
+
+        //
+        // Put the table together
+        //
+        const std::uint32_t nChunks = static_cast<std::uint32_t>(ChunkStarts.size());
+        Table.resize( sizeof(std::uint32_t) * (1 + nChunks) + Runs.size() );
+        std::memcpy( &Table[0],                     &nChunks,           sizeof(nChunks) );
+        std::memcpy( &Table[sizeof(nChunks)],       ChunkStarts.data(), sizeof(std::uint32_t) * nChunks );
+        std::memcpy( &Table[sizeof(std::uint32_t) * (1 + nChunks)], Runs.data(), Runs.size() );
+    }
+
+    //------------------------------------------------------------------------------
+    // Writes all the pointers of a loaded resource. Each chunk of the table walks the
+    // memory in order, and chunks are spread across the worker threads.
+    // When pDeferred is given packs with a null pointer are not loaded. The pointers that 
+    // live in them or point to them are added to pDeferred (in table order) instead, and 
+    // the ones living in loaded packs are set to null.
+    //------------------------------------------------------------------------------
+
+    xerr stream::ResolveRelocations( std::span<const std::byte> Table, const pack* pPack, std::byte* const* pPackPointers, std::vector<ref>* pDeferred ) const noexcept
+    {
+        if( Table.empty() ) return {};
+
+        std::uint32_t nChunks;
+        if( Table.size() < sizeof(nChunks) )
+            return xerr::create<state::FAILURE, "The relocation table is corrupted">();
+
+        std::memcpy( &nChunks, Table.data(), sizeof(nChunks) );
+        const std::size_t RunsStart = sizeof(std::uint32_t) * (1 + static_cast<std::size_t>(nChunks));
+        if( Table.size() < RunsStart )
+            return xerr::create<state::FAILURE, "The relocation table is corrupted">();
+
+        const auto Runs = Table.subspan( RunsStart );
+        auto getChunkStart = [&]( std::size_t i ) noexcept
+        {
+            if( i == nChunks ) return static_cast<std::uint32_t>(Runs.size());
+            std::uint32_t Start;
+            std::memcpy( &Start, &Table[sizeof(std::uint32_t) * (1 + i)], sizeof(Start) );
+            return Start;
+        };
+
+        for( std::uint32_t i = 0; i < nChunks; i++ )
+        {
+            if( getChunkStart(i) > getChunkStart(i + 1) )
+                return xerr::create<state::FAILURE, "The relocation table is corrupted">();
+        }
+
+        // True when Base + Delta * i stays in [0, Limit] for every i in [0, Count]
+        auto isRunInside = []( std::uint64_t Base, std::int64_t Delta, std::uint64_t Count, std::uint64_t Limit ) noexcept
+        {
+            if( Base > Limit ) return false;
+            if( Count == 0 )   return true;
+            if( Delta >= 0 )   return static_cast<std::uint64_t>(Delta) <= (Limit - Base) / Count;
+            return (std::uint64_t{ 0 } - static_cast<std::uint64_t>(Delta)) <= Base / Count;
+        };
+
+        std::atomic<bool>               bCorrupted{ false };
+        std::vector<std::vector<ref>>   ChunkDeferred( pDeferred ? nChunks : 0 );
+        auto ResolveChunk = [&]( std::size_t iChunk ) noexcept
+        {
+            const std::uint32_t nPacks       = m_Header.m_nPacks;
+            std::uint32_t       OffsetPack   = nPacks;
+            std::uint32_t       TargetPack   = nPacks;
+            std::uint64_t       OffsetCursor = 0;
+            std::uint64_t       TargetCursor = 0;
+            varint::reader      Reader{ Runs.subspan( getChunkStart(iChunk), getChunkStart(iChunk + 1) - getChunkStart(iChunk) ) };
+
+            while( Reader.isDone() == false )
+            {
+                std::uint64_t Control, Value, Offset, Target, nExtra, OffsetStride = 0, TargetStride = 0;
+
+                if( Reader.Read(Control) == false ) { bCorrupted = true; return; }
+
+                if( Control & 1 )
+                {
+                    if( Reader.Read(Value) == false || Value >= nPacks ) { bCorrupted = true; return; }
+                    OffsetPack   = static_cast<std::uint32_t>(Value);
+                    OffsetCursor = 0;
+                }
+
+                if( Control & 2 )
+                {
+                    if( Reader.Read(Value) == false || Value >= nPacks ) { bCorrupted = true; return; }
+                    TargetPack   = static_cast<std::uint32_t>(Value);
+                    TargetCursor = 0;
+                }
+
+                if( OffsetPack >= nPacks || TargetPack >= nPacks ) { bCorrupted = true; return; }
+                if( Reader.Read(Offset) == false || Reader.Read(Target) == false ) { bCorrupted = true; return; }
+
+                nExtra = Control >> 2;
+                if( nExtra >= reloc_chunk_size_v ) { bCorrupted = true; return; }
+                if( nExtra && (Reader.Read(OffsetStride) == false || Reader.Read(TargetStride) == false) ) { bCorrupted = true; return; }
+
+                const std::uint64_t OffsetSize  = pPack[OffsetPack].m_UncompressSize;
+                const std::uint64_t TargetSize  = pPack[TargetPack].m_UncompressSize;
+                if( OffsetSize < sizeof(data_ptr<void>) || TargetSize == 0 ) { bCorrupted = true; return; }
+
+                // Last valid position of a pointer and of a target in their packs
+                const std::uint64_t OffsetLimit = OffsetSize - sizeof(data_ptr<void>);
+                const std::uint64_t TargetLimit = TargetSize - 1;
+                const std::int64_t  TargetDelta = varint::UnZigZag(Target);
+                const std::int64_t  Stride      = varint::UnZigZag(TargetStride);
+
+                // Every position of the run must be checked without wrapping around, a big stride
+                // could otherwise bring the end of the run back inside the pack while the middle is not
+                if( OffsetCursor > OffsetLimit || Offset > OffsetLimit - OffsetCursor ) { bCorrupted = true; return; }
+                Offset += OffsetCursor;
+                if( nExtra && OffsetStride > (OffsetLimit - Offset) / nExtra ) { bCorrupted = true; return; }
+
+                if( isRunInside( TargetCursor, TargetDelta, 1, TargetLimit ) == false ) { bCorrupted = true; return; }
+                Target = TargetCursor + static_cast<std::uint64_t>(TargetDelta);
+                if( isRunInside( Target, Stride, nExtra, TargetLimit ) == false ) { bCorrupted = true; return; }
+
+                const std::uint64_t LastOffset  = Offset + nExtra * OffsetStride;
+                const std::uint64_t LastTarget  = Target + nExtra * static_cast<std::uint64_t>(Stride);
+
+                if( pDeferred && (pPackPointers[OffsetPack] == nullptr || pPackPointers[TargetPack] == nullptr) )
+                {
+                    for( std::uint64_t i = 0; i <= nExtra; ++i )
+                    {
+                        auto& Ref = ChunkDeferred[iChunk].emplace_back();
+                        Ref.m_OffSet            = Offset + i * OffsetStride;
+                        Ref.m_OffsetPack        = OffsetPack;
+                        Ref.m_PointingAT        = Target + i * static_cast<std::uint64_t>(Stride);
+                        Ref.m_PointingATPack    = TargetPack;
+
+                        if( pPackPointers[OffsetPack] ) 
+                            reinterpret_cast<data_ptr<void>*>( &pPackPointers[OffsetPack][Ref.m_OffSet] )->m_pValue = nullptr;
+                    }
+                }
+                else
+                {
+                    std::byte* const pOffset = &pPackPointers[OffsetPack][Offset];
+                    std::byte* const pTarget = &pPackPointers[TargetPack][Target];
+                    for( std::uint64_t i = 0; i <= nExtra; ++i )
+                    {
+                        reinterpret_cast<data_ptr<void>*>( pOffset + i * OffsetStride )->m_pValue = pTarget + static_cast<std::int64_t>(i) * Stride;
+                    }
+                }
+
+                OffsetCursor = LastOffset;
+                TargetCursor = LastTarget;
+            }
+        };
+
+        worker_pool::getInstance().ParallelFor( m_nThreads, nChunks, ResolveChunk );
+
+        if( bCorrupted )
+            return xerr::create<state::FAILURE, "The relocation table is corrupted">();
+
+        for( auto& Deferred : ChunkDeferred )
+        {
+            pDeferred->insert( pDeferred->end(), Deferred.begin(), Deferred.end() );
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    void stream::SortPacksByQuality( void ) noexcept
+    {
+        auto& Packs = m_pWrite->m_Packs;
+
+        // The root pack is always quality zero so it stays first
+        std::vector<std::uint32_t> Order( Packs.size() );
+        for( std::uint32_t i = 0; i < Order.size(); i++ ) Order[i] = i;
+        std::ranges::stable_sort( Order, [&]( std::uint32_t A, std::uint32_t B ){ return Packs[A].m_Quality < Packs[B].m_Quality; } );
+        assert( Order.empty() || Order[0] == 0 );
+
+        std::vector<std::uint32_t>  Remap( Packs.size() );
+        std::vector<pack_writing>   Sorted;
+        Sorted.reserve( Packs.size() );
+        for( std::uint32_t i = 0; i < Order.size(); i++ )
+        {
+            Remap[Order[i]] = i;
+            Sorted.push_back( std::move(Packs[Order[i]]) );
+        }
+        Packs = std::move(Sorted);
+
+        for( auto& Ref : m_pWrite->m_PointerTable )
+        {
+            Ref.m_OffsetPack     = Remap[Ref.m_OffsetPack];
+            Ref.m_PointingATPack = Remap[Ref.m_PointingATPack];
+        }
+
+        m_Header.m_MaxQualities = Packs.empty() ? 0 : static_cast<std::uint16_t>(Packs.back().m_Quality + 1);
+    }
+
+    //------------------------------------------------------------------------------
+    // Turns the packs, the block sizes, the pointers, the checksums and (for streaming saves)
+    // the block offsets into the tables of the file, endian swapped and compressed
+    //------------------------------------------------------------------------------
+
+    xerr stream::EncodeTables( std::span<const std::uint64_t> BlockOffsets, std::vector<std::byte>& Tables ) noexcept
+    {
+        std::vector<std::byte>      InfoData;
+        std::vector<std::byte>      RelocTable;
+
+        // Turn the pointers into the relocation table
+        EncodeRelocations( m_pWrite->m_PointerTable, RelocTable );
+        m_Header.m_RelocSize = RelocTable.size();
+
+        // Allocate all the memory that we will need
+        InfoData.resize( sizeof(pack)            * m_pWrite->m_Packs.size() 
+                       + sizeof(std::uint32_t)   * m_pWrite->m_CSizeStream.size() 
+                       + RelocTable.size()
+                       + sizeof(std::uint32_t)   * m_pWrite->m_Checksums.size()
+                       + sizeof(std::uint64_t)   * BlockOffsets.size() );
+
+        auto pPack          = reinterpret_cast<pack*>           (InfoData.data());
+        auto pBlockSizes    = reinterpret_cast<std::uint32_t*>  (&pPack[m_pWrite->m_Packs.size()]);
+        auto pReloc         = reinterpret_cast<std::byte*>      (&pBlockSizes[m_pWrite->m_CSizeStream.size()]);
+        auto pChecksums     = pReloc + RelocTable.size();       // Not aligned, only touched with memcpy
+        auto pOffsets       = pChecksums + sizeof(std::uint32_t) * m_pWrite->m_Checksums.size();
+
+        // First update endianess 
+        if( m_pWrite->m_bEndian )
+        {
+            // Only the chunk count and the chunk starts of the relocation table are not bytes
+            if( RelocTable.empty() == false )
+            {
+                auto pWords = reinterpret_cast<std::uint32_t*>(RelocTable.data());
+                for( std::uint32_t i = 0, nWords = 1 + pWords[0]; i < nWords; i++ )
+                {
+                    pWords[i] = endian::Convert(pWords[i]);
+                }
+            }
+
+            for( auto& E : m_pWrite->m_Packs )
+            {
+                E.m_PackFlags.m_Value   = endian::Convert(E.m_PackFlags.m_Value);
+                E.m_UncompressSize      = endian::Convert(E.m_UncompressSize);
+                E.m_nBlocks             = endian::Convert(E.m_nBlocks);
+            }
+
+            for( auto& E : m_pWrite->m_CSizeStream )
+            {
+                E = endian::Convert(E);
+            }
+        }
+
+        // Now copy all the info starting with the packs
+        for( std::uint32_t i = 0; i < m_pWrite->m_Packs.size(); i++)
+        {
+            pPack[i] = m_pWrite->m_Packs[i];
+        }
+
+        // Now we copy all the block sizes
+        for(std::uint32_t i = 0; i < m_pWrite->m_CSizeStream.size(); i++)
+        {
+            pBlockSizes[i] = m_pWrite->m_CSizeStream[i];
+        }
+
+        // Now we copy the relocation table
+        if( RelocTable.empty() == false ) std::memcpy( pReloc, RelocTable.data(), RelocTable.size() );
+
+        // The checksums of the blocks
+        for( std::size_t i = 0; i < m_pWrite->m_Checksums.size(); i++ )
+        {
+            const std::uint32_t Checksum = m_pWrite->m_bEndian ? endian::Convert(m_pWrite->m_Checksums[i]) : m_pWrite->m_Checksums[i];
+            std::memcpy( pChecksums + i * sizeof(Checksum), &Checksum, sizeof(Checksum) );
+        }
+
+        // And the offsets of the blocks
+        for( std::size_t i = 0; i < BlockOffsets.size(); i++ )
+        {
+            const std::uint64_t Offset = m_pWrite->m_bEndian ? endian::Convert(BlockOffsets[i]) : BlockOffsets[i];
+            std::memcpy( pOffsets + i * sizeof(Offset), &Offset, sizeof(Offset) );
+        }
+
+        // 
+        // to compress it (stored files keep the tables uncompressed so they can be used in place)
+        //
+        if( m_CompressionLevel == compression_level::STORE )
+        {
+            Tables = std::move(InfoData);
+            return {};
+        }
+
+        Tables.resize(InfoData.size());
+
+#ifdef _DEBUG
+        {
+            std::memset( Tables.data(), 0xBE, Tables.size() );
+        }
+#endif
+
+        std::uint64_t   CompressSize;
+        compressor      Compress;
+        if ( auto Err = Compress.Init( InfoData.size(), InfoData, m_CompressionLevel); Err ) 
+            return Err;
+
+        if (auto Err = Compress.Pack(CompressSize, Tables); Err)
+        {
+            if (Err.getState<xcompression::state>() == xcompression::state::INCOMPRESSIBLE)
+            {
+                Tables = std::move(InfoData);
+                return {};
+            }
+
+            assert(false);
+            return Err;
+        }
+
+        //
+        // TODO: Sanity check, We could uncompressed here if we wanted to...
+        //
+        Tables.resize(CompressSize);
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // The header as it goes to the file
+    //------------------------------------------------------------------------------
+
+    stream::header stream::getDiskHeader( void ) const noexcept
+    {
+        if( m_pWrite->m_bEndian == false )
+            return m_Header;
+
+        header Header;
+        Header.m_HeaderSize         = endian::Convert(m_Header.m_HeaderSize);
+        Header.m_Flags              = endian::Convert(m_Header.m_Flags);
+        Header.m_SerialFileVersion  = endian::Convert(m_Header.m_SerialFileVersion);
+        Header.m_PackSize           = endian::Convert(m_Header.m_PackSize);
+        Header.m_MaxQualities       = endian::Convert(m_Header.m_MaxQualities);
+        Header.m_SizeOfData         = endian::Convert(m_Header.m_SizeOfData);
+        Header.m_nPointers          = endian::Convert(m_Header.m_nPointers);
+        Header.m_nPacks             = endian::Convert(m_Header.m_nPacks);
+        Header.m_nBlockSizes        = endian::Convert(m_Header.m_nBlockSizes);
+        Header.m_RelocSize          = endian::Convert(m_Header.m_RelocSize);
+        Header.m_ResourceVersion    = endian::Convert(m_Header.m_ResourceVersion);
+        Header.m_AutomaticVersion   = endian::Convert(m_Header.m_AutomaticVersion);
+        return Header;
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::SaveFile(details::save_target& Target) noexcept
+    {
+        //
+        // Packs go to the file from the coarsest to the finest quality so a loader can stop at any tier
+        //
+        SortPacksByQuality();
+
+        //
+        // Go throw all the packs and get them ready to compress
+        //
+        std::vector<compress_job> Jobs;
+        for(std::uint32_t i = 0; i < m_pWrite->m_Packs.size(); i++ )
+        {
+            pack_writing& Pack = m_pWrite->m_Packs[i];
+
+            Pack.m_UncompressSize = Pack.m_Data.size();
+
+            Pack.m_CompressSize                     = 0;
+            Pack.m_nBlocks                          = 0;
+            Pack.m_Format.m_bIndependentBlocks      = m_bIndependentBlocks || Pack.m_Codec != codec_id::XCOMPRESSION;
+            Pack.m_Format.m_BlockSizeShift          = static_cast<std::int8_t>( std::countr_zero( ChooseBlockSize( m_BlockSize, Pack.m_UncompressSize ) ) 
+                                                                              - std::countr_zero( default_block_size_v ) );
+            Pack.m_BlockSize                        = Pack.getBlockSize();
+
+            //
+            // Stored packs go to the file as they are
+            //
+            if( m_CompressionLevel == compression_level::STORE )
+            {
+                Pack.m_Format.m_bStored = true;
+                Pack.m_Codec            = codec_id::STORE;
+                Pack.m_CompressSize     = Pack.m_UncompressSize;
+                Pack.m_CompressData     = std::move(Pack.m_Data);
+                continue;
+            }
+
+            //
+            // Other codecs than xcompression always work with independent blocks
+            //
+            const codec_base* pCodec = nullptr;
+            if( Pack.m_Codec != codec_id::XCOMPRESSION )
+            {
+                pCodec = getCodec( Pack.m_Codec );
+                if( pCodec == nullptr )
+                    return xerr::create<state::FAILURE, "A pack uses a codec that is not registered">();
+            }
+
+            //
+            // Chained blocks must be compressed by a single job, independent blocks get a job each
+            //
+            const std::span<const std::byte> RawData{ Pack.m_Data };
+            const std::size_t                JobSize = Pack.m_Format.m_bIndependentBlocks ? Pack.m_BlockSize : RawData.size();
+            for( std::size_t Offset = 0; Offset < RawData.size(); Offset += JobSize )
+            {
+                auto& Job = Jobs.emplace_back();
+                Job.m_Source    = RawData.subspan( Offset, std::min( JobSize, RawData.size() - Offset ) );
+                Job.m_BlockSize = Pack.m_BlockSize;
+                Job.m_iPack     = i;
+                Job.m_pCodec    = pCodec;
+            }
+        }
+
+        //
+        // Compress all the jobs (all jobs are independent from each other)
+        //
+        worker_pool::getInstance().ParallelFor( m_nThreads, Jobs.size(), [&]( std::size_t i )
+        {
+            details::stats_scope Scope{ m_pStats, stats::stage::SAVE_COMPRESS };
+            Jobs[i].Run(m_CompressionLevel);
+            if( m_bChecksums ) Jobs[i].ComputeChecksums();
+        });
+
+        //
+        // Collect the results in order so the file is the same regardless of how many threads we used
+        //
+        for( auto& Job : Jobs )
+        {
+            if( Job.m_Error ) 
+                return Job.m_Error;
+
+            pack_writing& Pack = m_pWrite->m_Packs[Job.m_iPack];
+
+            Pack.m_CompressSize += Job.m_CompressData.size();
+            Pack.m_nBlocks      += static_cast<std::uint32_t>(Job.m_BlockSizes.size());
+
+            if( Pack.m_CompressData.empty() ) Pack.m_CompressData = std::move(Job.m_CompressData);
+            else                              Pack.m_CompressData.insert( Pack.m_CompressData.end(), Job.m_CompressData.begin(), Job.m_CompressData.end() );
+
+            m_pWrite->m_CSizeStream.insert( m_pWrite->m_CSizeStream.end(), Job.m_BlockSizes.begin(), Job.m_BlockSizes.end() );
+            m_pWrite->m_Checksums.insert( m_pWrite->m_Checksums.end(), Job.m_Checksums.begin(), Job.m_Checksums.end() );
+
+            if( m_pStats )
+            {
+                m_pStats->AddCounter( stats::counter::BYTES_COMPRESSED,      Job.m_Source.size() );
+                m_pStats->AddCounter( stats::counter::INCOMPRESSIBLE_BLOCKS, Job.m_nIncompressible );
+            }
+        }
+
+        //
+        // TODO: Could add a sanity check here and decompress the data and check if everything is OK
+        //
+        for( auto& Pack : m_pWrite->m_Packs )
+        {
+            Pack.m_Data.clear();
+            Pack.m_Data.shrink_to_fit();
+        }
+
+        //
+        // Take the references and the packs headers and compress them as well
+        //
+        std::vector<std::byte> CompressInfoData;
+        {
+            details::stats_scope Scope{ m_pStats, stats::stage::SAVE_TABLES };
+            if( auto Err = EncodeTables( {}, CompressInfoData ); Err )
+                return Err;
+        }
+
+        const std::uint64_t CompressInfoDataSize = CompressInfoData.size();
+
+        //
+        // Fill up all the header information
+        //
+        assert( m_pWrite->m_Packs.size()        <= std::numeric_limits<std::uint32_t>::max() );
+        assert( m_pWrite->m_PointerTable.size() <= std::numeric_limits<std::uint32_t>::max() );
+        assert( m_pWrite->m_CSizeStream.size()  <= std::numeric_limits<std::uint32_t>::max() );
+
+        m_Header.m_HeaderSize           = sizeof(header);
+        m_Header.m_SerialFileVersion    = version_id_v;       // Major and minor version ( version pattern helps Identify file format as well)
+        m_Header.m_nPacks               = static_cast<std::uint32_t>(m_pWrite->m_Packs.size());
+        m_Header.m_nPointers            = static_cast<std::uint32_t>(m_pWrite->m_PointerTable.size());
+        m_Header.m_nBlockSizes          = static_cast<std::uint32_t>(m_pWrite->m_CSizeStream.size());
+        m_Header.m_PackSize             = CompressInfoDataSize;
+        m_Header.m_AutomaticVersion     = m_ClassSize;
+        m_Header.m_Reserved             = 0;
+        m_Header.m_Flags                = m_bChecksums ? flags_checksums_v : 0;
+
+        // The size of the data is known before writing anything so the targets only need to append
+        m_Header.m_SizeOfData           = CompressInfoDataSize;
+        for( auto& Pack : m_pWrite->m_Packs )
+        {
+            if( Pack.m_Format.m_bStored )
+            {
+                const std::uint64_t Offset = sizeof(header) + m_Header.m_SizeOfData;
+                m_Header.m_SizeOfData += ((Offset + store_alignment_v - 1) & ~static_cast<std::uint64_t>(store_alignment_v - 1)) - Offset;
+            }
+
+            m_Header.m_SizeOfData += Pack.m_CompressSize;
+        }
+
+        const header Header = getDiskHeader();
+
+        if( m_pStats )
+        {
+            m_pStats->AddCounter( stats::counter::BYTES_WRITTEN, sizeof(Header) + m_Header.m_SizeOfData );
+            m_pStats->AddCounter( stats::counter::PACKS,         m_Header.m_nPacks );
+            m_pStats->AddCounter( stats::counter::BLOCKS,        m_Header.m_nBlockSizes );
+            m_pStats->AddCounter( stats::counter::POINTERS,      m_Header.m_nPointers );
+        }
+
+        //
+        // Save everything into the target
+        //
+        details::stats_scope Scope{ m_pStats, stats::stage::SAVE_WRITE };
+        Target.Reserve( sizeof(Header) + m_Header.m_SizeOfData );
+
+        if( auto Err = Target.WriteSpan(std::span(reinterpret_cast<const std::byte*>(&Header), sizeof(Header))); Err ) 
+            return Err;
+
+        if( auto Err = Target.WriteSpan(std::span( CompressInfoData.data(), CompressInfoDataSize )); Err ) 
+            return Err;
+
+        static constexpr std::array<std::byte, store_alignment_v> Zeros {};
+        std::size_t Offset = sizeof(Header) + CompressInfoDataSize;
+        for( auto& Pack : m_pWrite->m_Packs )
+        {
+            // Stored packs start in their own page
+            if( Pack.m_Format.m_bStored )
+            {
+                const std::size_t Padding = ((Offset + store_alignment_v - 1) & ~static_cast<std::size_t>(store_alignment_v - 1)) - Offset;
+                if( Padding )
+                {
+                    if( auto Err = Target.WriteSpan( std::span( Zeros.data(), Padding ) ); Err )
+                        return Err;
+                    Offset += Padding;
+                }
+            }
+
+            // Note that m_CompressSize is never endian swapped
+            if( auto Err = Target.WriteSpan( std::span( Pack.m_CompressData.data(), Pack.m_CompressSize )); Err )
+                return Err;
+
+            Offset += Pack.m_CompressSize;
+        }
+
+        assert( Offset == sizeof(Header) + m_Header.m_SizeOfData );
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Saves at the current position of an xfile::stream
+    //------------------------------------------------------------------------------
+
+    struct xfile_target final : details::save_target
+    {
+        xfile_target( xfile::stream& File ) noexcept : m_File{ File } {}
+
+        xerr WriteSpan( std::span<const std::byte> View ) noexcept override
+        {
+            return m_File.WriteSpan(View);
+        }
+
+        xfile::stream& m_File;
+    };
+
+    //------------------------------------------------------------------------------
+    // Saves at the end of a memory buffer
+    //------------------------------------------------------------------------------
+
+    struct buffer_target final : details::save_target
+    {
+        buffer_target( std::vector<std::byte>& Buffer ) noexcept : m_Buffer{ Buffer } {}
+
+        xerr WriteSpan( std::span<const std::byte> View ) noexcept override
+        {
+            m_Buffer.insert( m_Buffer.end(), View.begin(), View.end() );
+            return {};
+        }
+
+        void Reserve( std::size_t Size ) noexcept override
+        {
+            m_Buffer.reserve( m_Buffer.size() + Size );
+        }
+
+        std::vector<std::byte>& m_Buffer;
+    };
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::SaveFile( xfile::stream& File ) noexcept
+    {
+        xfile_target Target{ File };
+        return SaveFile( Target );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::SaveFile( std::vector<std::byte>& Buffer ) noexcept
+    {
+        buffer_target Target{ Buffer };
+        return SaveFile( Target );
+    }
+
+    //------------------------------------------------------------------------------
+    // Copies into the blocks of a streamed pack. The block size is a power of two so
+    // only the words of a misaligned view can go across two blocks.
+    //------------------------------------------------------------------------------
+
+    void stream::pack_writing::WriteBlocks( std::size_t Offset, std::span<const std::byte> View, std::size_t SwapSize ) noexcept
+    {
+        assert( SwapSize <= 16 );
+
+        while( View.empty() == false )
+        {
+            const std::size_t   iBlock  = Offset / m_BlockSize;
+            const std::size_t   InBlock = Offset % m_BlockSize;
+            std::size_t         Size    = std::min<std::size_t>( View.size(), m_BlockSize - InBlock );
+
+            // The pins make sure that blocks are only flushed once nothing else is going to write in them
+            assert( iBlock < m_StreamBlocks.size() );
+            auto& Block = m_StreamBlocks[iBlock];
+            assert( Block.m_CompressSize == 0 );
+
+            if( Block.m_pData == nullptr ) 
+                Block.m_pData = std::make_unique<std::byte[]>( m_BlockSize );
+
+            if( SwapSize > 1 && (Size % SwapSize) )
+            {
+                // The word that goes across the two blocks is swapped on the side
+                if( Size < SwapSize )
+                {
+                    std::array<std::byte, 16> Word;
+                    std::memcpy( Word.data(), View.data(), SwapSize );
+                    SwapBytes( std::span{ Word.data(), SwapSize }, SwapSize );
+                    WriteBlocks( Offset, std::span{ Word.data(), SwapSize }, 1 );
+
+                    Offset += SwapSize;
+                    View    = View.subspan( SwapSize );
+                    continue;
+                }
+
+                Size -= Size % SwapSize;
+            }
+
+            std::memcpy( &Block.m_pData[InBlock], View.data(), Size );
+            if( SwapSize > 1 )
+                SwapBytes( std::span{ &Block.m_pData[InBlock], Size }, SwapSize );
+
+            Offset += Size;
+            View    = View.subspan( Size );
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // Returns the end of the furthest pin that touches the range (zero if none does)
+    //------------------------------------------------------------------------------
+
+    std::uint64_t stream::PinnedUntil( std::uint32_t iPack, std::uint64_t Begin, std::uint64_t End ) const noexcept
+    {
+        std::uint64_t Until = 0;
+
+        for( const auto& Pin : m_pWrite->m_Pins )
+        {
+            if( Pin.m_iPack == iPack && Pin.m_Begin < End && Pin.m_End > Begin )
+                Until = std::max( Until, Pin.m_End );
+        }
+
+        return Until;
+    }
+
+    //------------------------------------------------------------------------------
+    // Compresses and writes every block that is full and that no pin touches. Blocks
+    // that are pinned are remembered as ranges so they are not scanned one by one again.
+    // The final call writes the rest of the blocks (including the last partial ones).
+    //------------------------------------------------------------------------------
+
+    xerr stream::FlushBlocks( bool bFinal ) noexcept
+    {
+        auto&                       Write       = *m_pWrite;
+        const std::uint64_t         BlockSize   = Write.m_StreamBlockSize;
+        std::vector<compress_job>   Jobs;
+        std::vector<std::uint64_t>  JobBlocks;
+
+        assert( bFinal == false || Write.m_Pins.empty() );
+
+        for( std::uint32_t iPack = 0; iPack < Write.m_Packs.size(); iPack++ )
+        {
+            auto&               Pack    = Write.m_Packs[iPack];
+            const std::uint64_t nReady  = bFinal ? Pack.m_StreamBlocks.size() : Pack.m_StreamSize / BlockSize;
+
+            if( Pack.m_Held.empty() && Pack.m_nScanned == nReady )
+                continue;
+
+            // Stored resources are written with the store codec, there are no stored packs in a streamed resource
+            const codec_id      Codec   = m_CompressionLevel == compression_level::STORE ? codec_id::STORE : Pack.m_Codec;
+            const codec_base*   pCodec  = nullptr;
+            if( Codec != codec_id::XCOMPRESSION )
+            {
+                pCodec = getCodec( Codec );
+                if( pCodec == nullptr )
+                    return xerr::create<state::FAILURE, "A pack uses a codec that is not registered">();
+            }
+
+            auto& Held = Write.m_HeldScratch;
+            Held.clear();
+
+            auto Scan = [&]( std::uint64_t iBegin, std::uint64_t iEnd )
+            {
+                for( std::uint64_t i = iBegin; i < iEnd; )
+                {
+                    // Every block up to the end of the pin is pinned as well
+                    if( const auto Until = PinnedUntil( iPack, i * BlockSize, (i + 1) * BlockSize ); Until )
+                    {
+                        const std::uint64_t iUntil = std::min( iEnd, (Until + BlockSize - 1) / BlockSize );
+                        Held.push_back( { i, iUntil } );
+                        i = iUntil;
+                        continue;
+                    }
+
+                    // Blocks that were never written are all zeros
+                    auto& Block = Pack.m_StreamBlocks[i];
+                    if( Block.m_pData == nullptr ) 
+                        Block.m_pData = std::make_unique<std::byte[]>( BlockSize );
+
+                    auto& Job = Jobs.emplace_back();
+                    Job.m_Source    = std::span{ Block.m_pData.get(), static_cast<std::size_t>( std::min( BlockSize, Pack.m_StreamSize - i * BlockSize ) ) };
+                    Job.m_BlockSize = static_cast<std::uint32_t>( std::min( BlockSize, Pack.m_StreamSize ) );
+                    Job.m_iPack     = iPack;
+                    Job.m_pCodec    = pCodec;
+                    JobBlocks.push_back( i );
+                    i++;
+                }
+            };
+
+            for( const auto& Range : Pack.m_Held ) 
+                Scan( Range[0], Range[1] );
+
+            Scan( Pack.m_nScanned, nReady );
+
+            Pack.m_nScanned = nReady;
+            std::swap( Pack.m_Held, Held );
+        }
+
+        if( Jobs.empty() ) 
+            return {};
+
+        worker_pool::getInstance().ParallelFor( m_nThreads, Jobs.size(), [&]( std::size_t i )
+        {
+            details::stats_scope Scope{ m_pStats, stats::stage::SAVE_COMPRESS };
+            Jobs[i].Run(m_CompressionLevel);
+            if( m_bChecksums ) Jobs[i].ComputeChecksums();
+        });
+
+        //
+        // Write them in order so the file is the same regardless of how many threads we used
+        //
+        details::stats_scope Scope{ m_pStats, stats::stage::SAVE_WRITE };
+        for( std::size_t i = 0; i < Jobs.size(); i++ )
+        {
+            const auto& Job = Jobs[i];
+            if( Job.m_Error ) 
+                return Job.m_Error;
+
+            if( m_pStats )
+            {
+                m_pStats->AddCounter( stats::counter::BYTES_COMPRESSED,      Job.m_Source.size() );
+                m_pStats->AddCounter( stats::counter::INCOMPRESSIBLE_BLOCKS, Job.m_nIncompressible );
+            }
+
+            assert( Job.m_BlockSizes.size() == 1 );
+            if( auto Err = Write.m_pTarget->WriteSpan( Job.m_CompressData ); Err )
+                return Err;
+
+            auto& Block = Write.m_Packs[Job.m_iPack].m_StreamBlocks[JobBlocks[i]];
+            Block.m_Offset          = Write.m_StreamOffset;
+            Block.m_CompressSize    = static_cast<std::uint32_t>( Job.m_CompressData.size() );
+            Block.m_Checksum        = Job.m_Checksums.empty() ? 0 : Job.m_Checksums[0];
+            Block.m_pData.reset();
+
+            Write.m_StreamOffset += Job.m_CompressData.size();
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Streamed layout:
+    //      header      - Only the version, the sizes of the root and the flags_streamed_v flag
+    //      blocks      - Every block is independent, they are in the order they were flushed
+    //      tables      - Packs, block sizes, relocation table, checksums and a u64 offset per block
+    //      header      - The real header
+    // Nothing is ever written twice so the target only has to append.
+    //------------------------------------------------------------------------------
+
+    xerr stream::SaveStreamed( details::save_target& Target, mem_type ObjectFlags, const void* pObject, serialize_fn Function ) noexcept
+    {
+        auto& Write = *m_pWrite;
+
+        Write.m_pTarget         = &Target;
+        Write.m_StreamBlockSize = m_BlockSize ? m_BlockSize : default_block_size_v;
+
+        //
+        // The first header just tells the loader to look at the end of the resource
+        //
+        const auto ResourceVersion = m_Header.m_ResourceVersion;
+
+        m_Header                        = header{};
+        m_Header.m_HeaderSize           = sizeof(header);
+        m_Header.m_SerialFileVersion    = version_id_v;
+        m_Header.m_ResourceVersion      = ResourceVersion;
+        m_Header.m_AutomaticVersion     = m_ClassSize;
+        m_Header.m_Flags                = flags_streamed_v;
+        {
+            const header Header = getDiskHeader();
+            if( auto Err = Target.WriteSpan( std::span( reinterpret_cast<const std::byte*>(&Header), sizeof(Header) ) ); Err ) 
+                return Err;
+        }
+
+        //
+        // Serialize, the blocks get written as soon as they are done
+        //
+        m_iPack = Write.AllocatePack( ObjectFlags, 0, m_Codec );
+        getW().Reserve( m_ClassSize, 8 );
+
+        const std::size_t iPin = PushPin( 0, m_ClassSize );
+        {
+            // Includes the blocks that got compressed and written on the way
+            details::stats_scope Scope{ m_pStats, stats::stage::SAVE_SERIALIZE };
+            if( auto Err = Function( *this, pObject ); Err ) 
+                return Err;
+        }
+        PopPin(iPin);
+
+        if( auto Err = FlushBlocks(true); Err ) 
+            return Err;
+
+        //
+        // The packs stay in the order they were created, the loader knows where each block is
+        //
+        std::vector<std::uint64_t> BlockOffsets;
+        for( auto& Pack : Write.m_Packs )
+        {
+            Pack.m_UncompressSize               = Pack.m_StreamSize;
+            Pack.m_nBlocks                      = static_cast<std::uint32_t>( Pack.m_StreamBlocks.size() );
+            Pack.m_Format.m_bIndependentBlocks  = true;
+            Pack.m_Format.m_BlockSizeShift      = static_cast<std::int8_t>( std::countr_zero( Write.m_StreamBlockSize ) - std::countr_zero( default_block_size_v ) );
+            if( m_CompressionLevel == compression_level::STORE ) 
+                Pack.m_Codec = codec_id::STORE;
+
+            m_Header.m_MaxQualities = std::max<std::uint16_t>( m_Header.m_MaxQualities, Pack.m_Quality + 1 );
+
+            for( const auto& Block : Pack.m_StreamBlocks )
+            {
+                assert( Block.m_CompressSize );
+                Write.m_CSizeStream.push_back( Block.m_CompressSize );
+                BlockOffsets.push_back( Block.m_Offset );
+                if( m_bChecksums ) Write.m_Checksums.push_back( Block.m_Checksum );
+            }
+
+            Pack.m_StreamBlocks.clear();
+        }
+
+        std::vector<std::byte> Tables;
+        {
+            details::stats_scope Scope{ m_pStats, stats::stage::SAVE_TABLES };
+            if( auto Err = EncodeTables( BlockOffsets, Tables ); Err )
+                return Err;
+        }
+
+        assert( Write.m_Packs.size()        <= std::numeric_limits<std::uint32_t>::max() );
+        assert( Write.m_PointerTable.size() <= std::numeric_limits<std::uint32_t>::max() );
+        assert( Write.m_CSizeStream.size()  <= std::numeric_limits<std::uint32_t>::max() );
+
+        m_Header.m_nPacks               = static_cast<std::uint32_t>(Write.m_Packs.size());
+        m_Header.m_nPointers            = static_cast<std::uint32_t>(Write.m_PointerTable.size());
+        m_Header.m_nBlockSizes          = static_cast<std::uint32_t>(Write.m_CSizeStream.size());
+        m_Header.m_PackSize             = Tables.size();
+        m_Header.m_SizeOfData           = Write.m_StreamOffset + Tables.size() + sizeof(header);
+        m_Header.m_Flags               |= m_bChecksums ? flags_checksums_v : 0;
+
+        if( m_pStats )
+        {
+            m_pStats->AddCounter( stats::counter::BYTES_WRITTEN, sizeof(header) + m_Header.m_SizeOfData );
+            m_pStats->AddCounter( stats::counter::PACKS,         m_Header.m_nPacks );
+            m_pStats->AddCounter( stats::counter::BLOCKS,        m_Header.m_nBlockSizes );
+            m_pStats->AddCounter( stats::counter::POINTERS,      m_Header.m_nPointers );
+        }
+
+        details::stats_scope Scope{ m_pStats, stats::stage::SAVE_WRITE };
+        if( auto Err = Target.WriteSpan( Tables ); Err ) 
+            return Err;
+
+        const header Header = getDiskHeader();
+        return Target.WriteSpan( std::span( reinterpret_cast<const std::byte*>(&Header), sizeof(Header) ) );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::SaveStreamed( xfile::stream& File, mem_type ObjectFlags, const void* pObject, serialize_fn Function ) noexcept
+    {
+        xfile_target Target{ File };
+        return SaveStreamed( Target, ObjectFlags, pObject, Function );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::SaveStreamed( std::vector<std::byte>& Buffer, mem_type ObjectFlags, const void* pObject, serialize_fn Function ) noexcept
+    {
+        buffer_target Target{ Buffer };
+        return SaveStreamed( Target, ObjectFlags, pObject, Function );
+    }
+
+    //------------------------------------------------------------------------------
+    // Sources that can't read the end of the resource can't load streamed resources
+    //------------------------------------------------------------------------------
+
+    xerr details::load_source::ReadTail( std::span<std::byte> ) noexcept
+    {
+        return xerr::create<state::FAILURE, "This source can not load streamed resources">();
+    }
+
+    //------------------------------------------------------------------------------
+    // Loads straight from an xfile::stream (the reads are asynchronous)
+    //------------------------------------------------------------------------------
+
+    struct xfile_source final : details::load_source
+    {
+        xfile_source( xfile::stream& File ) noexcept : m_File{ File } {}
+
+        xerr ReadSpan( std::span<std::byte> View ) noexcept override
+        {
+            return m_File.ReadSpan(View);
+        }
+
+        xerr Synchronize( void ) noexcept override
+        {
+            return m_File.Synchronize(true);
+        }
+
+        // Seeks to the end and back so the sequential reads are not disturbed
+        xerr ReadTail( std::span<std::byte> View ) noexcept override
+        {
+            std::size_t Pos, End;
+
+            if( auto Err = m_File.Synchronize(true); Err ) return Err;
+            if( auto Err = m_File.Tell(Pos);         Err ) return Err;
+            if( auto Err = m_File.SeekEnd(0);        Err ) return Err;
+            if( auto Err = m_File.Tell(End);         Err ) return Err;
+
+            if( End < Pos + View.size() )
+                return xerr::create<state::FAILURE, "The end of the resource is missing">();
+
+            if( auto Err = m_File.SeekOrigin( End - View.size() ); Err ) return Err;
+            if( auto Err = m_File.ReadSpan(View);                  Err ) return Err;
+            if( auto Err = m_File.Synchronize(true);               Err ) return Err;
+
+            return m_File.SeekOrigin(Pos);
+        }
+
+        xfile::stream& m_File;
+    };
+
+    //------------------------------------------------------------------------------
+    // Loads from memory, the compressed packs are never copied
+    //------------------------------------------------------------------------------
+
+    struct memory_source final : details::load_source
+    {
+        memory_source( std::span<const std::byte> Data ) noexcept : m_Data{ Data } {}
+
+        xerr ReadSpan( std::span<std::byte> View ) noexcept override
+        {
+            if( View.size() > m_Data.size() )
+                return xerr::create<state::FAILURE, "Reading pass the end of the memory buffer">();
+
+            std::memcpy( View.data(), m_Data.data(), View.size() );
+            m_Data = m_Data.subspan( View.size() );
+            return {};
+        }
+
+        std::span<const std::byte> getRemaining( void ) noexcept override
+        {
+            return m_Data;
+        }
+
+        // The resource must end where the buffer ends
+        xerr ReadTail( std::span<std::byte> View ) noexcept override
+        {
+            if( View.size() > m_Data.size() )
+                return xerr::create<state::FAILURE, "The end of the resource is missing">();
+
+            std::memcpy( View.data(), m_Data.data() + m_Data.size() - View.size(), View.size() );
+            return {};
+        }
+
+        std::span<const std::byte> m_Data;
+    };
+
+    //------------------------------------------------------------------------------
+    // Waits for the reads of a load, the time goes to the stats as I/O wait
+    //------------------------------------------------------------------------------
+
+    static
+    xerr WaitForReads( details::load_source& Source, stats* pStats ) noexcept
+    {
+        details::stats_scope Scope{ pStats, stats::stage::LOAD_IO_WAIT };
+        return Source.Synchronize();
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadHeader( xfile::stream& File, std::size_t SizeOfT ) noexcept
+    {
+        xfile_source Source{ File };
+        return LoadHeader( Source, SizeOfT );
+    }
+
+    //------------------------------------------------------------------------------
+
+    void* stream::LoadObject( xfile::stream& File ) noexcept
+    {
+        xfile_source Source{ File };
+        return LoadObject( Source );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadHeader( std::span<const std::byte> Data, std::size_t SizeOfT ) noexcept
+    {
+        memory_source Source{ Data };
+        return LoadHeader( Source, SizeOfT );
+    }
+
+    //------------------------------------------------------------------------------
+
+    void* stream::LoadObject( std::span<const std::byte> Data ) noexcept
+    {
+        assert( m_Header.m_HeaderSize );
+        if( Data.size() < getHeaderSize() )
+            return nullptr;
+
+        memory_source Source{ Data.subspan( getHeaderSize() ) };
+        return LoadObject( Source );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadHeader( details::load_source& Source, std::size_t SizeOfT) noexcept
+    {
+        details::stats_scope                  Scope{ m_pStats, stats::stage::LOAD_HEADER };
+        std::array<std::byte, sizeof(header)> Buffer {};
+
+        //
+        // Check signature (version is encoded in signature). All the headers are at least as big as the first one.
+        //
+        if ( auto Err = Source.ReadSpan(std::span{ Buffer.data(), sizeof(header_v1) }); Err )
+            return Err;
+
+        if( auto Err = Source.Synchronize(); Err ) 
+            return Err;
+
+        std::uint16_t Version;
+        std::memcpy( &Version, &Buffer[offsetof(header, m_SerialFileVersion)], sizeof(Version) );
+
+        if( Version == version_id_v )
+        {
+            if ( auto Err = Source.ReadSpan(std::span{ &Buffer[sizeof(header_v1)], sizeof(header) - sizeof(header_v1) }); Err )
+                return Err;
+
+            if( auto Err = Source.Synchronize(); Err ) 
+                return Err;
+
+            if( auto Err = DecodeHeader(Buffer, SizeOfT); Err )
+                return Err;
+
+            // Streamed resources have the real header at the end
+            if( m_Header.m_Flags & flags_streamed_v )
+            {
+                if( auto Err = Source.ReadTail(Buffer); Err )
+                    return Err;
+
+                if( auto Err = DecodeHeader(Buffer, SizeOfT); Err )
+                    return Err;
+
+                if( (m_Header.m_Flags & flags_streamed_v) == 0 || m_Header.m_HeaderSize != sizeof(header)
+                    || m_Header.m_SizeOfData < m_Header.m_PackSize + sizeof(header) )
+                    return xerr::create<state::FAILURE, "The header at the end of the streamed resource is corrupted">();
+            }
+
+            return {};
+        }
+
+        return DecodeHeader(std::span{ Buffer.data(), sizeof(header_v1) }, SizeOfT);
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::DecodeHeader( std::span<const std::byte> Data, std::size_t SizeOfT ) noexcept
+    {
+        std::uint16_t Version;
+        std::memcpy( &Version, &Data[offsetof(header, m_SerialFileVersion)], sizeof(Version) );
+
+        if( Version == version_id_v && Data.size() >= sizeof(header) )
+        {
+            std::memcpy( &m_Header, Data.data(), sizeof(header) );
+        }
+        else if( Version == version_id_v1_v )
+        {
+            header_v1 Header;
+            std::memcpy( &Header, Data.data(), sizeof(header_v1) );
+
+            m_Header                    = header{};
+            m_Header.m_HeaderSize       = sizeof(header_v1);
+            m_Header.m_SerialFileVersion= Header.m_SerialFileVersion;
+            m_Header.m_ResourceVersion  = Header.m_ResourceVersion;
+            m_Header.m_MaxQualities     = Header.m_MaxQualities;
+            m_Header.m_AutomaticVersion = Header.m_AutomaticVersion;
+            m_Header.m_nPointers        = Header.m_nPointers;
+            m_Header.m_nPacks           = Header.m_nPacks;
+            m_Header.m_nBlockSizes      = Header.m_nBlockSizes;
+            m_Header.m_PackSize         = Header.m_PackSize;
+            m_Header.m_SizeOfData       = Header.m_SizeOfData;
+        }
+        else
+        {
+            if ( endian::Convert(Version) == version_id_v || endian::Convert(Version) == version_id_v1_v )
+            {
+                return xerr::create<state::WRONG_VERSION, "File can not be read. Probably it has the wrong endian.">();
+            }
+
+            return xerr::create<state::UNKOWN_FILE_TYPE, "Unknown file format (Could be an older version of the file format)">();
+        }
+
+        if( m_Header.m_Flags & ~flags_all_v )
+        {
+            return xerr::create<state::UNKOWN_FILE_TYPE, "The file uses features that this version does not know about">();
+        }
+
+        if (m_Header.m_AutomaticVersion != SizeOfT)
+        {
+            return xerr::create<state::WRONG_VERSION, "The size of the structure that was used for writing this file is different from the one reading it">();
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Reads the packs, references and block sizes tables. Version 1 tables get converted
+    // to the current layout so the rest of the loader only deals with one format.
+    //------------------------------------------------------------------------------
+
+    xerr stream::ReadTables( details::load_source& Source, std::span<std::byte>& Tables ) noexcept
+    {
+        details::stats_scope Scope          { m_pStats, stats::stage::LOAD_TABLES };
+        auto&               Scratch         = *getLoaderContext().m_Scratch;
+        const bool          bV1             = m_Header.m_SerialFileVersion == version_id_v1_v;
+        const bool          bStreamed       = (m_Header.m_Flags & flags_streamed_v) != 0;
+        const std::size_t   OffsetsSize     = bStreamed ? m_Header.m_nBlockSizes * sizeof(std::uint64_t) : 0;
+        const std::size_t   ChecksumsSize   = (m_Header.m_Flags & flags_checksums_v) ? m_Header.m_nBlockSizes * sizeof(std::uint32_t) : 0;
+        const std::size_t   DecompressSize  = m_Header.m_nPacks      * (bV1 ? sizeof(pack_v1) : sizeof(pack))
+                                            + m_Header.m_nBlockSizes * sizeof(std::uint32_t)
+                                            + (bV1 ? m_Header.m_nPointers * sizeof(ref_v1) : m_Header.m_RelocSize)
+                                            + ChecksumsSize
+                                            + OffsetsSize;
+
+        Scratch.m_Checksums.clear();
+
+        if( m_Header.m_PackSize > DecompressSize )
+            return xerr::create<state::FAILURE, "The tables of the file are corrupted">();
+
+        const auto InfoData = details::loader_scratch::Grow( Scratch.m_Tables, DecompressSize );
+
+        // Streamed resources have the tables at the end, right before the last header
+        std::span<const std::byte> CompressData;
+        if( bStreamed )
+        {
+            const auto Tail = details::loader_scratch::Grow( Scratch.m_Staging, m_Header.m_PackSize + sizeof(header) );
+
+            if ( auto Err = Source.ReadTail(Tail); Err )
+                return Err;
+
+            CompressData = Tail.first( m_Header.m_PackSize );
+        }
+
+        // Uncompress in place for packs and references
+        if ( m_Header.m_PackSize < DecompressSize )
+        {
+            if( bStreamed == false )
+            {
+                const auto ReadData = details::loader_scratch::Grow( Scratch.m_Staging, m_Header.m_PackSize );
+
+                if ( auto Err = Source.ReadSpan(ReadData); Err )
+                    return Err;
+
+                if ( auto Err = WaitForReads( Source, m_pStats ); Err )
+                    return Err;
+
+                CompressData = ReadData;
+            }
+
+            // Actual decompress the block
+            auto& Decompress = Scratch.m_Decompress;
+            if ( auto Err = Decompress.Init(true, static_cast<std::uint32_t>(DecompressSize)); Err )
+                return Err;
+
+            std::uint32_t BlockUncompressed=0;
+            if ( auto Err = Decompress.Unpack(BlockUncompressed, InfoData, CompressData); Err )
+                return Err;
+
+            if( DecompressSize != BlockUncompressed )
+                return xerr::create<state::FAILURE, "The tables of the file did not decompress to the right size">();
+        }
+        else if( bStreamed )
+        {
+            std::memcpy( InfoData.data(), CompressData.data(), DecompressSize );
+        }
+        else
+        {
+            if ( auto Err = Source.ReadSpan(InfoData); Err )
+                return Err;
+
+            // Let as sync before moving forward...
+            if ( auto Err = WaitForReads( Source, m_pStats ); Err )
+                return Err;
+        }
+
+        if( bV1 == false )
+        {
+            auto const pPack = reinterpret_cast<const pack*>(InfoData.data());
+            for( std::uint32_t i = 0; i < m_Header.m_nPacks; i++ )
+            {
+                if( pPack[i].m_Format.m_bStored == false && pPack[i].m_Codec != codec_id::XCOMPRESSION && getCodec(pPack[i].m_Codec) == nullptr )
+                    return xerr::create<state::FAILURE, "The file uses a codec that is not registered">();
+            }
+
+            // The block offsets are not aligned so they get their own buffer
+            if( bStreamed )
+            {
+                Scratch.m_BlockOffsets.resize( m_Header.m_nBlockSizes );
+                if( OffsetsSize ) std::memcpy( Scratch.m_BlockOffsets.data(), &InfoData[DecompressSize - OffsetsSize], OffsetsSize );
+            }
+
+            // Checksums are only kept when they are going to be verified
+            if( ChecksumsSize && m_bVerifyChecksums )
+            {
+                Scratch.m_Checksums.resize( m_Header.m_nBlockSizes );
+                std::memcpy( Scratch.m_Checksums.data(), &InfoData[DecompressSize - OffsetsSize - ChecksumsSize], ChecksumsSize );
+            }
+
+            Tables = InfoData.first( DecompressSize - OffsetsSize - ChecksumsSize );
+            return {};
+        }
+
+        //
+        // Convert version 1 tables
+        //
+        auto const pPackV1       = reinterpret_cast<const pack_v1*>          (&InfoData[0]);
+        auto const pRefV1        = reinterpret_cast<const ref_v1*>           (&pPackV1[m_Header.m_nPacks]);
+        auto const pBlockSizesV1 = reinterpret_cast<const std::uint32_t*>    (&pRefV1[m_Header.m_nPointers]);
+
+        std::vector<ref> Refs( m_Header.m_nPointers );
+        for( std::uint32_t i = 0; i < m_Header.m_nPointers; i++ )
+        {
+            Refs[i] = ref
+            { .m_PointingAT     = pRefV1[i].m_PointingAT
+            , .m_OffSet         = pRefV1[i].m_OffSet
+            , .m_Count          = pRefV1[i].m_Count
+            , .m_OffsetPack     = pRefV1[i].m_OffsetPack
+            , .m_PointingATPack = pRefV1[i].m_PointingATPack
+            };
+        }
+
+        std::vector<std::byte> RelocTable;
+        EncodeRelocations( Refs, RelocTable );
+        m_Header.m_RelocSize = RelocTable.size();
+
+        // Built in the staging buffer which then becomes the tables buffer
+        Tables = details::loader_scratch::Grow( Scratch.m_Staging, m_Header.m_nPacks      * sizeof(pack)
+                                                                 + m_Header.m_nBlockSizes * sizeof(std::uint32_t)
+                                                                 + m_Header.m_RelocSize );
+
+        auto const pPack         = reinterpret_cast<pack*>                   (&Tables[0]);
+        auto const pBlockSizes   = reinterpret_cast<std::uint32_t*>          (&pPack[m_Header.m_nPacks]);
+        auto const pReloc        = reinterpret_cast<std::byte*>              (&pBlockSizes[m_Header.m_nBlockSizes]);
+
+        for( std::uint32_t i = 0; i < m_Header.m_nPacks; i++ )
+        {
+            pPack[i] = pack
+            { .m_PackFlags      = pPackV1[i].m_PackFlags
+            , .m_Format         = pack_format{}                 // Version 1 packs always have chained blocks of default_block_size_v
+            , .m_nBlocks        = pPackV1[i].m_nBlocks
+            , .m_UncompressSize = pPackV1[i].m_UncompressSize
+            };
+        }
+
+        std::memcpy( pBlockSizes, pBlockSizesV1, m_Header.m_nBlockSizes * sizeof(std::uint32_t) );
+        if( RelocTable.empty() == false ) std::memcpy( pReloc, RelocTable.data(), RelocTable.size() );
+
+        std::swap( Scratch.m_Tables, Scratch.m_Staging );
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Automatic block sizes keep the old 64KB blocks for small and medium packs and grow
+    // them for big packs, so that a pack has about auto_blocks_v blocks
+    //------------------------------------------------------------------------------
+
+    std::uint32_t stream::ChooseBlockSize( std::uint32_t BlockSize, std::uint64_t PackSize ) noexcept
+    {
+        if( BlockSize ) 
+        {
+            assert( std::has_single_bit(BlockSize) && BlockSize >= min_block_size_v && BlockSize <= max_block_size_v );
+            return BlockSize;
+        }
+
+        const std::uint64_t Target = std::bit_ceil( std::max<std::uint64_t>( PackSize / auto_blocks_v, 1 ) );
+        return static_cast<std::uint32_t>( std::clamp<std::uint64_t>( Target, default_block_size_v, auto_max_block_v ) );
+    }
+
+    //------------------------------------------------------------------------------
+    // Makes sure that every pack has the blocks its size needs, that no block is bigger 
+    // than the block size of its pack (so it fits in the read buffers) and returns the
+    // biggest block size of the file
+    //------------------------------------------------------------------------------
+
+    xerr stream::CheckBlockSizes( const pack* pPack, const std::uint32_t* pBlockSizes, std::uint32_t& MaxBlockSize ) const noexcept
+    {
+        std::uint64_t iBlock = 0;
+
+        MaxBlockSize = 0;
+        for( std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++ )
+        {
+            const pack& Pack      = pPack[iPack];
+            const auto  BlockSize = Pack.getBlockSize();
+
+            if( (iBlock + Pack.m_nBlocks) > m_Header.m_nBlockSizes )
+                return xerr::create<state::FAILURE, "The block sizes of the file are corrupted">();
+
+            // Written so it can not overflow, the block size is zero for empty packs
+            const std::uint64_t nBlocks = BlockSize ? Pack.m_UncompressSize / BlockSize + ((Pack.m_UncompressSize % BlockSize) != 0) : 0;
+            if( Pack.m_nBlocks != nBlocks )
+                return xerr::create<state::FAILURE, "The number of blocks of a pack does not match its size">();
+
+            for( std::uint32_t i = 0; i < Pack.m_nBlocks; i++ )
+            {
+                if( pBlockSizes[iBlock++] > BlockSize )
+                    return xerr::create<state::FAILURE, "A block of the file is bigger than its block size">();
+            }
+
+            MaxBlockSize = std::max( MaxBlockSize, BlockSize );
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Adds up the memory of the packs by type, and the region that LoadInto needs for
+    // the shared packs (each one 16 byte aligned like the allocations)
+    //------------------------------------------------------------------------------
+
+    xerr stream::ComputeRequirements( const pack* pPack, memory_requirements& Requirements ) const noexcept
+    {
+        Requirements = {};
+
+        for( std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++ )
+        {
+            const pack& Pack = pPack[iPack];
+
+            if( Pack.m_PackFlags.m_Value >= memory_requirements::num_types_v )
+                return xerr::create<state::FAILURE, "A pack of the file has an unknown memory type">();
+
+            Requirements.m_Size  [Pack.m_PackFlags.m_Value] += Pack.m_UncompressSize;
+            Requirements.m_nPacks[Pack.m_PackFlags.m_Value] ++;
+
+            if( isRegionPack(Pack.m_PackFlags) )
+                Requirements.m_RegionSize = ((Requirements.m_RegionSize + 15) & ~std::uint64_t{ 15 }) + Pack.m_UncompressSize;
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // During a LoadInto the shared packs are carved from the region in order, the rest
+    // (and every pack of a normal load) come from the memory callback
+    //------------------------------------------------------------------------------
+
+    std::byte* stream::AllocatePackMemory( const pack& Pack ) noexcept
+    {
+        details::stats_scope Scope{ m_pStats, stats::stage::LOAD_ALLOCATE };
+
+        if( m_Region.empty() || isRegionPack(Pack.m_PackFlags) == false )
+        {
+            if( m_pStats ) m_pStats->AddCounter( stats::counter::ALLOCATIONS, 1 );
+            return reinterpret_cast<std::byte*>( m_MemoryCallback.Allocate(Pack.m_PackFlags, Pack.m_UncompressSize, 16 ) );
+        }
+
+        const std::size_t Offset = (m_RegionUsed + 15) & ~std::size_t{ 15 };
+        if( Offset + Pack.m_UncompressSize > m_Region.size() )
+            return nullptr;
+
+        m_RegionUsed = Offset + static_cast<std::size_t>(Pack.m_UncompressSize);
+        return &m_Region[Offset];
+    }
+
+    //------------------------------------------------------------------------------
+    // Gives back the memory of a pack that AllocatePackMemory took, the packs in the
+    // region of a LoadInto belong to the caller
+    //------------------------------------------------------------------------------
+
+    void stream::FreePackMemory( const pack& Pack, std::byte* pData ) const noexcept
+    {
+        if( pData == nullptr ) return;
+        if( m_Region.empty() == false && isRegionPack(Pack.m_PackFlags) ) return;
+
+        m_MemoryCallback.Free( Pack.m_PackFlags, pData );
+    }
+
+    //------------------------------------------------------------------------------
+    // Reads all the compressed data in one go and then decompresses packs (or independent
+    // blocks) into their final memory in parallel. Trades the double buffer memory for 
+    // the size of the compressed data (unless the source is already in memory).
+    // Streamed resources give the offset of every block, otherwise they follow each other.
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadPacksParallel( details::load_source& Source, const pack* pPack, const std::uint32_t* pBlockSizes, const std::uint64_t* pBlockOffsets, std::byte** pPackPointers ) noexcept
+    {
+        using decompress_job = details::decompress_job;
+
+        auto&                       Scratch             = *getLoaderContext().m_Scratch;
+        auto&                       Jobs                = Scratch.m_Jobs;
+        const std::uint32_t*        pChecksums          = Scratch.m_Checksums.empty() ? nullptr : Scratch.m_Checksums.data();
+        std::size_t                 TotalCompressSize   = 0;
+        std::uint32_t               iBlock              = 0;
+        std::uint32_t               MaxBlockSize        = 0;
+
+        Jobs.clear();
+
+        // The jobs index the block tables and the memory of the packs with these counts
+        if( auto Err = CheckBlockSizes( pPack, pBlockSizes, MaxBlockSize ); Err )
+            return Err;
+
+        //
+        // Allocate the memory for all the packs and create the jobs
+        //
+        for (std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++)
+        {
+            const pack&     Pack        = pPack[iPack];
+            const auto      BlockSize   = Pack.getBlockSize();
+            const auto      pCodec      = getCodec( Pack.m_Codec );
+
+            pPackPointers[iPack] = AllocatePackMemory( Pack );
+            if( pPackPointers[iPack] == nullptr )
+                return xerr::create<state::FAILURE, "Fail to allocate memory for a pack">();
+
+            // Store a block that is mark as temp (can/should only be one)
+            if (Pack.m_PackFlags.m_bTempMemory )
+            {
+                assert(m_pTempBlockData == nullptr);
+                m_pTempBlockData = pPackPointers[iPack];
+            }
+
+            const std::span<std::byte> PackData{ pPackPointers[iPack], static_cast<std::size_t>(Pack.m_UncompressSize) };
+            if( pBlockOffsets && Pack.m_Format.m_bIndependentBlocks == false )
+            {
+                return xerr::create<state::FAILURE, "A streamed resource has a pack with chained blocks">();
+            }
+            else if( pBlockOffsets )
+            {
+                for( std::uint32_t i = 0; i < Pack.m_nBlocks; ++i )
+                {
+                    const std::size_t Offset = static_cast<std::size_t>(i) * BlockSize;
+                    Jobs.push_back
+                    ( decompress_job
+                      { .m_Destination          = PackData.subspan( Offset, std::min<std::size_t>( BlockSize, PackData.size() - Offset ) )
+                      , .m_SourceOffset         = static_cast<std::size_t>(pBlockOffsets[iBlock + i])
+                      , .m_BlockSizes           = std::span{ &pBlockSizes[iBlock + i], 1 }
+                      , .m_BlockSize            = BlockSize
+                      , .m_bIndependentBlocks   = true
+                      , .m_pCodec               = pCodec
+                      , .m_pChecksums           = pChecksums ? &pChecksums[iBlock + i] : nullptr
+                      }
+                    );
+                    TotalCompressSize = std::max<std::size_t>( TotalCompressSize, pBlockOffsets[iBlock + i] + pBlockSizes[iBlock + i] );
+                }
+            }
+            else if( Pack.m_Format.m_bIndependentBlocks )
+            {
+                for( std::uint32_t i = 0; i < Pack.m_nBlocks; ++i )
+                {
+                    const std::size_t Offset = static_cast<std::size_t>(i) * BlockSize;
+                    Jobs.push_back
+                    ( decompress_job
+                      { .m_Destination          = PackData.subspan( Offset, std::min<std::size_t>( BlockSize, PackData.size() - Offset ) )
+                      , .m_SourceOffset         = TotalCompressSize
+                      , .m_BlockSizes           = std::span{ &pBlockSizes[iBlock + i], 1 }
+                      , .m_BlockSize            = BlockSize
+                      , .m_bIndependentBlocks   = true
+                      , .m_pCodec               = pCodec
+                      , .m_pChecksums           = pChecksums ? &pChecksums[iBlock + i] : nullptr
+                      }
+                    );
+                    TotalCompressSize += pBlockSizes[iBlock + i];
+                }
+            }
+            else
+            {
+                const std::span BlockSizes{ &pBlockSizes[iBlock], Pack.m_nBlocks };
+                Jobs.push_back
+                ( decompress_job
+                  { .m_Destination          = PackData
+                  , .m_SourceOffset         = TotalCompressSize
+                  , .m_BlockSizes           = BlockSizes
+                  , .m_BlockSize            = BlockSize
+                  , .m_bIndependentBlocks   = false
+                  , .m_pCodec               = pCodec
+                  , .m_pChecksums           = pChecksums ? &pChecksums[iBlock] : nullptr
+                  }
+                );
+                for( auto Size : BlockSizes ) TotalCompressSize += Size;
+            }
+
+            iBlock += Pack.m_nBlocks;
+        }
+
+        // The blocks of a streamed resource must be before its tables
+        if( pBlockOffsets && TotalCompressSize > m_Header.m_SizeOfData - m_Header.m_PackSize - sizeof(header) )
+            return xerr::create<state::FAILURE, "The block offsets of the streamed resource are corrupted">();
+
+        //
+        // Sources in memory are decompressed in place, for the rest read all the compressed data
+        //
+        std::span<const std::byte>  CompressData = Source.getRemaining();
+
+        if( CompressData.empty() )
+        {
+            const auto ReadData = details::loader_scratch::Grow( Scratch.m_Staging, TotalCompressSize );
+
+            if ( auto Err = Source.ReadSpan(ReadData); Err )
+                return Err;
+
+            if ( auto Err = WaitForReads( Source, m_pStats ); Err )
+                return Err;
+
+            CompressData = ReadData;
+        }
+        else if( CompressData.size() < TotalCompressSize )
+        {
+            return xerr::create<state::FAILURE, "The packs go pass the end of the memory buffer">();
+        }
+
+        //
+        // Decompress everything
+        //
+        worker_pool::getInstance().ParallelFor( m_nThreads, Jobs.size(), [&]( std::size_t i )
+        {
+            details::stats_scope Scope{ m_pStats, stats::stage::LOAD_DECOMPRESS };
+            auto& Job = Jobs[i];
+            Job.m_Error = DecompressBlocks( Job.m_Destination, &CompressData[Job.m_SourceOffset], Job.m_BlockSizes, Job.m_BlockSize, Job.m_bIndependentBlocks, Job.m_pCodec, Job.m_pChecksums
+                                          , loader_context::getThreadContext().m_Scratch->m_Decompress );
+        });
+
+        for( auto& Job : Jobs )
+        {
+            if( Job.m_Error ) 
+                return Job.m_Error;
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Stored packs are read straight into their memory, only the alignment padding is skipped
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadPacksStored( details::load_source& Source, const pack* pPack, std::byte** pPackPointers ) noexcept
+    {
+        std::array<std::byte, store_alignment_v>    Padding;
+        std::size_t                                 Offset = getHeaderSize() + m_Header.m_PackSize;
+
+        for (std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++)
+        {
+            const pack& Pack = pPack[iPack];
+            assert(Pack.m_Format.m_bStored);
+
+            const std::size_t PaddingSize = ((Offset + store_alignment_v - 1) & ~static_cast<std::size_t>(store_alignment_v - 1)) - Offset;
+            if( PaddingSize )
+            {
+                if ( auto Err = Source.ReadSpan(std::span{ Padding.data(), PaddingSize }); Err )
+                    return Err;
+            }
+
+            pPackPointers[iPack] = AllocatePackMemory( Pack );
+            if( pPackPointers[iPack] == nullptr )
+                return xerr::create<state::FAILURE, "Fail to allocate memory for a pack">();
+
+            if (Pack.m_PackFlags.m_bTempMemory )
+            {
+                assert(m_pTempBlockData == nullptr);
+                m_pTempBlockData = pPackPointers[iPack];
+            }
+
+            if ( auto Err = Source.ReadSpan(std::span{ pPackPointers[iPack], static_cast<std::size_t>(Pack.m_UncompressSize) }); Err )
+                return Err;
+
+            if ( auto Err = WaitForReads( Source, m_pStats ); Err )
+                return Err;
+
+            Offset += PaddingSize + Pack.m_UncompressSize;
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    void* stream::LoadObject( details::load_source& Source ) noexcept
+    {
+        auto&                            Scratch        = *getLoaderContext().m_Scratch;
+        std::span<std::byte>             InfoData;                   // Buffer which contains all those arrays
+        std::uint32_t                    iCurrentBuffer = 0;
+        std::uint32_t                    MaxBlockSize   = 0;
+
+        //
+        // Read the refs and packs
+        //
+        if( auto Err = ReadTables(Source, InfoData); Err )
+        {
+            xerr::LogMessage<state::FAILURE>( std::format("ERROR:Serializer Load (1) Error {}", Err.getMessage() ) );
+            return nullptr;
+        }
+
+        //
+        // Set up the all the pointers
+        //
+        Scratch.m_PackPointers.assign(m_Header.m_nPacks, nullptr);
+
+        auto const   pPack           = reinterpret_cast<const pack*>            (InfoData.data());
+        auto const   pBlockSizes     = reinterpret_cast<const std::uint32_t*>   (&pPack[m_Header.m_nPacks]);
+        auto const   pReloc          = reinterpret_cast<const std::byte*>       (&pBlockSizes[m_Header.m_nBlockSizes]);
+        auto const   pPackPointers   = Scratch.m_PackPointers.data();
+
+        //
+        // Every failure from here on gives back the packs allocated so far (the ones in the
+        // region of a LoadInto belong to the caller) and forgets the temp data
+        //
+        auto const   Fail            = [&]( void ) noexcept -> void*
+        {
+            for( std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++ )
+            {
+                FreePackMemory( pPack[iPack], pPackPointers[iPack] );
+                pPackPointers[iPack] = nullptr;
+            }
+
+            m_pTempBlockData = nullptr;
+            return nullptr;
+        };
+
+        //
+        // Make sure that the region of a LoadInto fits every shared pack before allocating anything
+        //
+        if( m_Region.empty() == false )
+        {
+            memory_requirements Requirements;
+            if( auto Err = ComputeRequirements( pPack, Requirements ); Err )
+            {
+                xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (9) Error({})", Err.m_pMessage) );
+                return Fail();
+            }
+
+            if( Requirements.m_RegionSize > m_Region.size() || (reinterpret_cast<std::uintptr_t>(m_Region.data()) & 15) )
+            {
+                xerr::LogMessage<state::FAILURE>( "ERROR:Serializer Load (9) The region is too small or it is not 16 byte aligned" );
+                return Fail();
+            }
+
+            m_RegionUsed = 0;
+        }
+
+        //
+        // Start the reading and decompressing of the packs. The writer stores all of them or none
+        //
+        const auto nStored = static_cast<std::uint32_t>( std::count_if( pPack, pPack + m_Header.m_nPacks, []( const pack& P ){ return P.m_Format.m_bStored; } ) );
+        if( nStored != 0 && nStored != m_Header.m_nPacks )
+        {
+            xerr::LogMessage<state::FAILURE>( "ERROR:Serializer Load (7) The file mixes stored and compressed packs" );
+            return Fail();
+        }
+
+        if( nStored )
+        {
+            if( auto Err = LoadPacksStored( Source, pPack, pPackPointers ); Err )
+            {
+                xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (7) Error({})", Err.m_pMessage) );
+                return Fail();
+            }
+        }
+        else if( m_nThreads > 1 || Source.getRemaining().empty() == false || (m_Header.m_Flags & flags_streamed_v)
+              || std::any_of( pPack, pPack + m_Header.m_nPacks, []( const pack& P ){ return P.m_Codec > codec_id::STORE; } ) )
+        {
+            const std::uint64_t* pBlockOffsets = (m_Header.m_Flags & flags_streamed_v) ? Scratch.m_BlockOffsets.data() : nullptr;
+
+            if( auto Err = LoadPacksParallel( Source, pPack, pBlockSizes, pBlockOffsets, pPackPointers ); Err )
+            {
+                xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (6) Error({})", Err.m_pMessage) );
+                return Fail();
+            }
+        }
+        else
+        {
+            //
+            // Allocate the read temp double buffer, as big as the biggest block in the file
+            //
+            if( auto Err = CheckBlockSizes( pPack, pBlockSizes, MaxBlockSize ); Err )
+            {
+                xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (2) Error({})", Err.m_pMessage) );
+                return Fail();
+            }
+
+            const auto ReadBuffer = details::loader_scratch::Grow( Scratch.m_Staging, 2 * static_cast<std::size_t>(MaxBlockSize) );
+            auto const Buffer     = [&]( std::uint32_t i ) { return ReadBuffer.data() + i * static_cast<std::size_t>(MaxBlockSize); };
+
+            // Blocks are checked when they leave the double buffer, while the next one is being read
+            auto const IsCorrupted = [&]( std::uint32_t iBlock, const std::byte* pData )
+            {
+                return Scratch.m_Checksums.empty() == false && details::Crc32c( std::span{ pData, pBlockSizes[iBlock] } ) != Scratch.m_Checksums[iBlock];
+            };
+
+            std::uint32_t                          iBlock = 0;
+
+            for (std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++)
+            {
+                const pack&     Pack        = pPack[iPack];
+                std::uint64_t   ReadSoFar   = 0;
+                auto&           Decompress  = Scratch.m_Decompress;
+
+                // Initialize the decomporessor
+                const auto BlockSize = Pack.getBlockSize();
+                if (auto Err = Decompress.Init(true, BlockSize); Err)
+                {
+                    assert(false);
+                    return Fail();
+                }
+
+                // Start reading block immediately
+                // Note that the rest of the first block of a pack is interleave with the last pack last block
+                // except for the very first one (this one)
+                if (iPack == 0)
+                {
+                    if (auto Err = Source.ReadSpan(std::span<std::byte>(Buffer(iCurrentBuffer), pBlockSizes[iBlock])); Err)
+                    {
+                        xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (3) Error({})", Err.m_pMessage) );
+                        return Fail();
+                    }
+                }
+
+                // Allocate the size of this pack
+                pPackPointers[iPack] = AllocatePackMemory( Pack );
+                if( pPackPointers[iPack] == nullptr )
+                {
+                    xerr::LogMessage<state::FAILURE>( "ERROR:Serializer Load (3) Fail to allocate memory for a pack" );
+                    return Fail();
+                }
+
+                // Store a block that is mark as temp (can/should only be one)
+                if (Pack.m_PackFlags.m_bTempMemory )
+                {
+                    assert(m_pTempBlockData == nullptr);
+                    m_pTempBlockData = pPackPointers[iPack];
+                }
+
+                // Read each block
+                for ( std::uint32_t i=1; i< Pack.m_nBlocks; ++i )
+                {
+                    iCurrentBuffer = !iCurrentBuffer;
+                    iBlock++;
+
+                    // Start reading the next block
+                    if ( auto Err = WaitForReads( Source, m_pStats ); Err )
+                    {
+                        assert(false);
+                    }
+
+                    if ( auto Err = Source.ReadSpan(std::span{ Buffer(iCurrentBuffer), static_cast<std::size_t>(pBlockSizes[iBlock]) }); Err )
+                    {
+                        xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Loading block (4) Error({})", Err.getMessage()));
+                        assert(false);
+                        return Fail();
+                    }
+
+                    //
+                    // Start the decompressing at the same time
+                    //
+                    assert(pPackPointers[iPack]);
+
+                    if( IsCorrupted( iBlock - 1, Buffer(!iCurrentBuffer) ) )
+                    {
+                        xerr::LogMessage<state::FAILURE>( "ERROR:Serializer Loading block (4) A block of the file is corrupted (wrong checksum)" );
+                        return Fail();
+                    }
+
+                    if( pBlockSizes[iBlock - 1] > Pack.m_UncompressSize - ReadSoFar )
+                    {
+                        xerr::LogMessage<state::FAILURE>( "ERROR:Serializer Loading block (4) A block of the file is bigger than the room left in its pack" );
+                        return Fail();
+                    }
+
+                    details::stats_scope Scope{ m_pStats, stats::stage::LOAD_DECOMPRESS };
+
+                    // Independent blocks don't share any state with the previous block
+                    if( Pack.m_Format.m_bIndependentBlocks && i > 1 )
+                    {
+                        if (auto Err = Decompress.Init(true, BlockSize); Err)
+                        {
+                            assert(false);
+                            return Fail();
+                        }
+                    }
+
+                    // Check if the compressor failed to compress the data if so we must just copy the block
+                    if( pBlockSizes[iBlock - 1] == BlockSize)
+                    {
+                        auto dest = std::span<std::byte>{&pPackPointers[iPack][ReadSoFar], Pack.m_UncompressSize - ReadSoFar };
+                        auto src  = std::span<std::byte>{Buffer(!iCurrentBuffer), pBlockSizes[iBlock - 1]};
+                        std::ranges::copy( src, dest.begin());
+                        ReadSoFar += BlockSize;
+                    }
+                    else
+                    {
+                        std::uint32_t DecompressSize = 0;
+                        auto Err = Decompress.Unpack(DecompressSize
+                                        , std::span<std::byte>{&pPackPointers[iPack][ReadSoFar], Pack.m_UncompressSize - ReadSoFar}
+                                        , std::span<const std::byte>{Buffer(!iCurrentBuffer), pBlockSizes[iBlock - 1]});
+                        assert( Err == false || Err.getState<xcompression::state>() == xcompression::state::NOT_DONE);
+                        ReadSoFar += DecompressSize;
+                    }
+                }
+
+                // Finish reading the block
+                if ( auto Err = WaitForReads( Source, m_pStats ); Err )
+                {
+                    assert(false);
+                }
+
+                // Interleave next pack block with this last pack block
+                if ((iPack + 1) < m_Header.m_nPacks)
+                {
+                    if (auto Err = Source.ReadSpan(std::span<std::byte>(Buffer(!iCurrentBuffer), pBlockSizes[iBlock + 1])); Err )
+                    {
+                        xerr::LogMessage<state::FAILURE>( std::format("ERROR:Serializer Load (5) Error({})", Err.m_pMessage) );
+                        assert(false);
+                        return Fail();
+                    }
+                }
+
+                //
+                // Decompress last block for this pack
+                //
+                assert(pPackPointers[iPack]);
+
+                if( IsCorrupted( iBlock, Buffer(iCurrentBuffer) ) )
+                {
+                    xerr::LogMessage<state::FAILURE>( "ERROR:Serializer Load (5) A block of the file is corrupted (wrong checksum)" );
+                    return Fail();
+                }
+
+                if( pBlockSizes[iBlock] > Pack.m_UncompressSize - ReadSoFar )
+                {
+                    xerr::LogMessage<state::FAILURE>( "ERROR:Serializer Load (5) A block of the file is bigger than the room left in its pack" );
+                    return Fail();
+                }
+
+                details::stats_scope Scope{ m_pStats, stats::stage::LOAD_DECOMPRESS };
+                if ( pBlockSizes[iBlock] == BlockSize || Pack.m_UncompressSize == (ReadSoFar + pBlockSizes[iBlock]) )
+                {
+                    // If we has the same size as the uncompress block means we did not compressed anything
+                    std::memcpy(&pPackPointers[iPack][ReadSoFar], Buffer(iCurrentBuffer), pBlockSizes[iBlock]);
+                    ReadSoFar += pBlockSizes[iBlock];
+                }
+                else
+                {
+                    if( Pack.m_Format.m_bIndependentBlocks && Pack.m_nBlocks > 1 )
+                    {
+                        if (auto Err = Decompress.Init(true, BlockSize); Err)
+                        {
+                            assert(false);
+                            return Fail();
+                        }
+                    }
+
+                    std::uint32_t DecompressSize = 0;
+                    auto Err = Decompress.Unpack(DecompressSize
+                                    , std::span<std::byte>{&pPackPointers[iPack][ReadSoFar], Pack.m_UncompressSize - ReadSoFar }
+                                    , std::span<std::byte>{Buffer(iCurrentBuffer), pBlockSizes[iBlock]});
+                    assert( Err == false );
+                    ReadSoFar += DecompressSize;
+                }
+                assert(ReadSoFar == Pack.m_UncompressSize);
+
+                //
+                // Get ready for next block
+                //
+                iCurrentBuffer = !iCurrentBuffer;
+                iBlock++;
+            }
+        }
+
+        //
+        // Resolve pointers
+        //
+        {
+            details::stats_scope Scope{ m_pStats, stats::stage::LOAD_FIXUP };
+            if( auto Err = ResolveRelocations( std::span{ pReloc, static_cast<std::size_t>(m_Header.m_RelocSize) }, pPack, pPackPointers ); Err )
+            {
+                xerr::LogMessage<state::FAILURE>(std::format("ERROR:Serializer Load (8) Error({})", Err.m_pMessage) );
+                return Fail();
+            }
+        }
+
+        //
+        // The counters come from the tables. Blocks are stored as they are when their size
+        // is the size that they decompress to (same test as the decompression)
+        //
+        if( m_pStats )
+        {
+            std::uint64_t   Decompressed    = 0;
+            std::uint64_t   nIncompressible = 0;
+            std::uint32_t   iBlock          = 0;
+
+            for( std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++ )
+            {
+                const pack& Pack      = pPack[iPack];
+                const auto  BlockSize = Pack.getBlockSize();
+
+                if( Pack.m_Format.m_bStored == false ) 
+                    Decompressed += Pack.m_UncompressSize;
+
+                for( std::uint32_t i = 0; i < Pack.m_nBlocks; ++i, ++iBlock )
+                {
+                    const std::uint64_t Remaining = Pack.m_UncompressSize - std::min<std::uint64_t>( Pack.m_UncompressSize, static_cast<std::uint64_t>(i) * BlockSize );
+                    if( pBlockSizes[iBlock] == BlockSize || pBlockSizes[iBlock] == Remaining ) 
+                        nIncompressible++;
+                }
+            }
+
+            m_pStats->AddCounter( stats::counter::BYTES_READ,            getHeaderSize() + m_Header.m_SizeOfData );
+            m_pStats->AddCounter( stats::counter::BYTES_DECOMPRESSED,    Decompressed );
+            m_pStats->AddCounter( stats::counter::PACKS,                 m_Header.m_nPacks );
+            m_pStats->AddCounter( stats::counter::BLOCKS,                m_Header.m_nBlockSizes );
+            m_pStats->AddCounter( stats::counter::POINTERS,              m_Header.m_nPointers );
+            m_pStats->AddCounter( stats::counter::INCOMPRESSIBLE_BLOCKS, nIncompressible );
+        }
+
+        // Return the basic pack
+        return pPackPointers[0];
+    }
+
+    //------------------------------------------------------------------------------
+    // Only reads the tables, the source is left right before the packs
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadRequirements( details::load_source& Source, memory_requirements& Requirements ) noexcept
+    {
+        std::span<std::byte> InfoData;
+
+        if( auto Err = ReadTables(Source, InfoData); Err )
+            return Err;
+
+        return ComputeRequirements( reinterpret_cast<const pack*>(InfoData.data()), Requirements );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadRequirements( xfile::stream& File, memory_requirements& Requirements ) noexcept
+    {
+        xfile_source Source{ File };
+        return LoadRequirements( Source, Requirements );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadRequirements( std::span<const std::byte> Data, memory_requirements& Requirements ) noexcept
+    {
+        assert( m_Header.m_HeaderSize );
+        if( Data.size() < getHeaderSize() )
+            return xerr::create<state::FAILURE, "The memory buffer is too small to be a resource">();
+
+        memory_source Source{ Data.subspan( getHeaderSize() ) };
+        return LoadRequirements( Source, Requirements );
+    }
+
+    //------------------------------------------------------------------------------
+    // Resolves a stored file in place. The only thing written are the pointers so
+    // the rest of the pages stay shared with the file.
+    //------------------------------------------------------------------------------
+
+    void* stream::LoadMappedObject( std::span<std::byte> View ) noexcept
+    {
+        const auto TablesSize = m_Header.m_nPacks      * sizeof(pack)
+                              + m_Header.m_nBlockSizes * sizeof(std::uint32_t)
+                              + m_Header.m_RelocSize
+                              + ((m_Header.m_Flags & flags_checksums_v) ? m_Header.m_nBlockSizes * sizeof(std::uint32_t) : 0);
+
+        // Tables must be stored uncompressed and in the current format (streamed resources have them at the end)
+        if( m_Header.m_SerialFileVersion != version_id_v || (m_Header.m_Flags & flags_streamed_v) 
+            || m_Header.m_PackSize != TablesSize || View.size() < sizeof(header) + TablesSize )
+            return nullptr;
+
+        auto const pPack       = reinterpret_cast<const pack*>          (&View[sizeof(header)]);
+        auto const pBlockSizes = reinterpret_cast<const std::uint32_t*> (&pPack[m_Header.m_nPacks]);
+        auto const pReloc      = reinterpret_cast<const std::byte*>     (&pBlockSizes[m_Header.m_nBlockSizes]);
+
+        //
+        // Find where each pack lives
+        //
+        auto& PackPointers = getLoaderContext().m_Scratch->m_PackPointers;
+        PackPointers.assign( m_Header.m_nPacks, nullptr );
+
+        std::size_t Offset = sizeof(header) + TablesSize;
+        for (std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++)
+        {
+            const pack& Pack = pPack[iPack];
+            if( Pack.m_Format.m_bStored == false )
+                return nullptr;
+
+            Offset = (Offset + store_alignment_v - 1) & ~static_cast<std::size_t>(store_alignment_v - 1);
+            if( Offset + Pack.m_UncompressSize > View.size() )
+                return nullptr;
+
+            PackPointers[iPack] = &View[Offset];
+            Offset += Pack.m_UncompressSize;
+        }
+
+        //
+        // Resolve pointers
+        //
+        if( ResolveRelocations( std::span{ pReloc, static_cast<std::size_t>(m_Header.m_RelocSize) }, pPack, PackPointers.data() ) )
+            return nullptr;
+
+        return m_Header.m_nPacks ? PackPointers[0] : nullptr;
+    }
+
+    //------------------------------------------------------------------------------
+    // Loads the root and the shared packs, unique packs are left in the file for later
+    //------------------------------------------------------------------------------
+
+    void* stream::LoadLazyObject( lazy_file& File, std::uint8_t Quality, bool bDeferUnique ) noexcept
+    {
+        // The packs of a streamed resource are not in one piece
+        if( m_Header.m_Flags & flags_streamed_v )
+        {
+            xerr::LogMessage<state::FAILURE>( "ERROR:Serializer LoadLazy streamed resources can only be fully loaded" );
+            return nullptr;
+        }
+
+        xfile_source         Source{ File.m_File };
+        std::span<std::byte> Tables;
+        if( auto Err = ReadTables(Source, Tables); Err )
+        {
+            xerr::LogMessage<state::FAILURE>( std::format("ERROR:Serializer LoadLazy (1) Error {}", Err.getMessage() ) );
+            return nullptr;
+        }
+
+        // The tables are needed for as long as the file is open
+        File.m_Tables = std::make_unique<std::byte[]>( Tables.size() );
+        if( Tables.empty() == false ) std::memcpy( File.m_Tables.get(), Tables.data(), Tables.size() );
+        File.m_Checksums = getLoaderContext().m_Scratch->m_Checksums;
+
+        if( m_Header.m_nPacks == 0 ) 
+            return nullptr;
+
+        auto const pPack        = File.getPacks();
+        auto const pBlockSizes  = reinterpret_cast<const std::uint32_t*>   (&pPack[m_Header.m_nPacks]);
+        auto const pReloc       = reinterpret_cast<const std::byte*>       (&pBlockSizes[m_Header.m_nBlockSizes]);
+
+        //
+        // Find where each pack lives in the file
+        //
+        File.m_PackPointers.assign( m_Header.m_nPacks, nullptr );
+        File.m_PackOffsets.resize( m_Header.m_nPacks );
+        File.m_FirstBlock.resize( m_Header.m_nPacks );
+        File.m_Deferred.clear();
+
+        // Every failure from here on gives back the packs loaded so far and forgets the temp data
+        auto const Fail = [&]( void ) noexcept -> void*
+        {
+            for( std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++ )
+            {
+                FreePackMemory( pPack[iPack], File.m_PackPointers[iPack] );
+                File.m_PackPointers[iPack] = nullptr;
+            }
+
+            File.m_Deferred.clear();
+            m_pTempBlockData = nullptr;
+            return nullptr;
+        };
+
+        std::uint64_t Offset = getHeaderSize() + m_Header.m_PackSize;
+        std::uint32_t iBlock = 0;
+        for( std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++ )
+        {
+            const pack& Pack = pPack[iPack];
+
+            if( Pack.m_Format.m_bStored ) 
+                Offset = (Offset + store_alignment_v - 1) & ~static_cast<std::uint64_t>(store_alignment_v - 1);
+
+            File.m_PackOffsets[iPack] = Offset;
+            File.m_FirstBlock[iPack]  = iBlock;
+
+            if( (static_cast<std::uint64_t>(iBlock) + Pack.m_nBlocks) > m_Header.m_nBlockSizes )
+                return Fail();
+
+            if( Pack.m_Format.m_bStored ) Offset += Pack.m_UncompressSize;
+            else for( std::uint32_t i = 0; i < Pack.m_nBlocks; i++ ) Offset += pBlockSizes[iBlock++];
+        }
+
+        //
+        // The root and the temp pack are needed right away, the rest depends on the quality and if unique packs are deferred
+        //
+        for( std::uint32_t iPack = 0; iPack < m_Header.m_nPacks; iPack++ )
+        {
+            const auto Flags = pPack[iPack].m_PackFlags;
+            if( iPack && Flags.m_bTempMemory == false && ( pPack[iPack].m_Quality > Quality || (bDeferUnique && Flags.m_bUnique) ) ) 
+                continue;
+
+            if( auto Err = LoadLazyPack( File, iPack ); Err )
+            {
+                xerr::LogMessage<state::FAILURE>( std::format("ERROR:Serializer LoadLazy (2) Error {}", Err.getMessage() ) );
+                return Fail();
+            }
+        }
+
+        if( auto Err = ResolveRelocations( std::span{ pReloc, static_cast<std::size_t>(m_Header.m_RelocSize) }, pPack, File.m_PackPointers.data(), &File.m_Deferred ); Err )
+        {
+            xerr::LogMessage<state::FAILURE>( std::format("ERROR:Serializer LoadLazy (3) Error {}", Err.getMessage() ) );
+            return Fail();
+        }
+
+        // Keep the settings around to load the rest of the packs
+        File.m_pStream = std::make_unique<stream>(*this);
+        File.m_pStream->m_pTempBlockData = nullptr;
+        File.m_pStream->m_pLoaderContext = nullptr;
+
+        return File.m_PackPointers[0];
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadLazyPack( lazy_file& File, std::uint32_t iPack ) noexcept
+    {
+        auto const      pPack       = File.getPacks();
+        auto const      pBlockSizes = reinterpret_cast<const std::uint32_t*>(&pPack[m_Header.m_nPacks]);
+        const pack&     Pack        = pPack[iPack];
+        const auto      BlockSizes  = std::span{ &pBlockSizes[File.m_FirstBlock[iPack]], Pack.m_nBlocks };
+
+        auto const pData = AllocatePackMemory( Pack );
+        if( pData == nullptr )
+            return xerr::create<state::FAILURE, "Fail to allocate memory for a pack">();
+
+        auto Error = [&]() noexcept -> xerr
+        {
+            const std::span<std::byte> Destination{ pData, static_cast<std::size_t>(Pack.m_UncompressSize) };
+
+            if( auto Err = File.m_File.SeekOrigin( static_cast<std::size_t>(File.m_PackOffsets[iPack]) ); Err )
+                return Err;
+
+            if( Pack.m_Format.m_bStored )
+            {
+                if( auto Err = File.m_File.ReadSpan(Destination); Err )
+                    return Err;
+
+                return File.m_File.Synchronize(true);
+            }
+
+            std::size_t CompressSize = 0;
+            for( auto Size : BlockSizes ) CompressSize += Size;
+
+            auto&      Scratch      = *getLoaderContext().m_Scratch;
+            const auto CompressData = details::loader_scratch::Grow( Scratch.m_Staging, CompressSize );
+
+            if( auto Err = File.m_File.ReadSpan(CompressData); Err )
+                return Err;
+
+            if( auto Err = File.m_File.Synchronize(true); Err )
+                return Err;
+
+            return DecompressBlocks( Destination, CompressData.data(), BlockSizes, Pack.getBlockSize(), Pack.m_Format.m_bIndependentBlocks, getCodec( Pack.m_Codec )
+                                   , File.m_Checksums.empty() ? nullptr : &File.m_Checksums[File.m_FirstBlock[iPack]], Scratch.m_Decompress );
+        }();
+
+        if( Error )
+        {
+            FreePackMemory( Pack, pData );
+            return Error;
+        }
+
+        if( Pack.m_PackFlags.m_bTempMemory )
+        {
+            assert(m_pTempBlockData == nullptr);
+            m_pTempBlockData = pData;
+        }
+
+        File.m_PackPointers[iPack] = pData;
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    lazy_file::~lazy_file( void ) noexcept
+    {
+        close();
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr lazy_file::open( const std::wstring_view FileName ) noexcept
+    {
+        close();
+
+        if( auto Err = m_File.open(FileName, "rb"); Err )
+            return Err;
+
+        m_bOpen = true;
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Packs that were not loaded yet can not be loaded after closing
+
+    void lazy_file::close( void ) noexcept
+    {
+        if( m_bOpen == false ) return;
+
+        m_File.close();
+        m_bOpen = false;
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr lazy_file::LoadPack( std::uint32_t iPack ) noexcept
+    {
+        if( iPack >= m_PackPointers.size() )
+            return xerr::create<state::FAILURE, "The pack is not part of this resource">();
+
+        if( m_PackPointers[iPack] )
+            return {};
+
+        if( m_bOpen == false || m_pStream == nullptr )
+            return xerr::create<state::FAILURE, "The file was closed before loading all the packs">();
+
+        if( auto Err = m_pStream->LoadLazyPack( *this, iPack ); Err )
+            return Err;
+
+        ResolveDeferred();
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+    // Packs are sorted by quality in the file so the reads move forward
+
+    xerr lazy_file::LoadQuality( std::uint8_t Quality ) noexcept
+    {
+        if( m_bOpen == false || m_pStream == nullptr )
+            return xerr::create<state::FAILURE, "The file was closed before loading all the packs">();
+
+        auto const pPacks = getPacks();
+        xerr       Error;
+        for( std::uint32_t iPack = 0; iPack < m_PackPointers.size(); iPack++ )
+        {
+            if( m_PackPointers[iPack] || pPacks[iPack].m_Quality > Quality ) 
+                continue;
+
+            if( Error = m_pStream->LoadLazyPack( *this, iPack ); Error )
+                break;
+        }
+
+        // Even if something failed the packs that did load are usable
+        ResolveDeferred();
+        return Error;
+    }
+
+    //------------------------------------------------------------------------------
+    // Fixes the pointers that were waiting for packs that are now loaded
+
+    void lazy_file::ResolveDeferred( void ) noexcept
+    {
+        std::erase_if( m_Deferred, [&]( const stream::ref& Ref )
+        {
+            std::byte* const pOffsetPack = m_PackPointers[Ref.m_OffsetPack];
+            std::byte* const pTargetPack = m_PackPointers[Ref.m_PointingATPack];
+            if( pOffsetPack == nullptr ) 
+                return false;
+
+            auto& Pointer = *reinterpret_cast<data_ptr<void>*>(&pOffsetPack[Ref.m_OffSet]);
+            if( pTargetPack == nullptr )
+            {
+                // Pointers of a newly loaded pack that still point to a pack in the file
+                Pointer.m_pValue = nullptr;
+                return false;
+            }
+
+            Pointer.m_pValue = &pTargetPack[Ref.m_PointingAT];
+            return true;
+        });
+    }
+
+    //------------------------------------------------------------------------------
+    // Loads the pack where the pointer should point to
+
+    xerr lazy_file::LoadPointer( const void* pPointer ) noexcept
+    {
+        auto const pSlot  = static_cast<const std::byte*>(pPointer);
+        auto const pPacks = getPacks();
+
+        for( std::uint32_t iPack = 0; iPack < m_PackPointers.size(); iPack++ )
+        {
+            const std::byte* const pBegin = m_PackPointers[iPack];
+            if( pBegin == nullptr || pSlot < pBegin || pSlot >= pBegin + pPacks[iPack].m_UncompressSize ) 
+                continue;
+
+            const stream::ref Key{ .m_OffSet = static_cast<std::uint64_t>(pSlot - pBegin), .m_OffsetPack = iPack };
+            auto It = std::ranges::lower_bound( m_Deferred, Key, []( const stream::ref& A, const stream::ref& B )
+            {
+                if( A.m_OffsetPack != B.m_OffsetPack ) return A.m_OffsetPack < B.m_OffsetPack;
+                return A.m_OffSet < B.m_OffSet;
+            });
+
+            // Not waiting for anything (already loaded or null)
+            if( It == m_Deferred.end() || It->m_OffsetPack != Key.m_OffsetPack || It->m_OffSet != Key.m_OffSet ) 
+                return {};
+
+            return LoadPack( It->m_PointingATPack );
+        }
+
+        return xerr::create<state::FAILURE, "The pointer is not part of this resource">();
+    }
+
+    //------------------------------------------------------------------------------
+
+    void stream::SubmitLoad( std::shared_ptr<details::async_load_state> State, std::wstring FileName, std::size_t SizeOfT, std::uint16_t ResourceVersion ) noexcept
+    {
+        worker_pool::getInstance().Submit( [State = std::move(State), FileName = std::move(FileName), SizeOfT, ResourceVersion]
+        {
+            State->m_Error = [&]() noexcept -> xerr
+            {
+                xfile::stream File;
+
+                if( auto Err = File.open(FileName, "rb"); Err )
+                    return Err;
+
+                if( auto Err = State->m_Stream.LoadHeader(File, SizeOfT); Err )
+                    return Err;
+
+                if( State->m_Stream.getResourceVersion() != ResourceVersion )
+                    return xerr::create<state::WRONG_VERSION, "Wrong resource version">();
+
+                State->m_pObject = State->m_Stream.LoadObject(File);
+                if( State->m_pObject == nullptr )
+                    return xerr::create<state::FAILURE, "Fail to load the object">();
+
+                File.close();
+                return {};
+            }();
+
+            State->Done();
+        });
+    }
+
+    //------------------------------------------------------------------------------
+
+    void details::async_load_state::Done( void ) noexcept
+    {
+        std::coroutine_handle<> Continuation;
+        {
+            std::lock_guard Lock( m_Mutex );
+            m_bDone      = true;
+            Continuation = std::exchange( m_Continuation, {} );
+        }
+        m_DoneCondition.notify_all();
+
+        if( Continuation ) Continuation.resume();
+    }
+
+    //------------------------------------------------------------------------------
+
+    bool details::async_load_state::isDone( void ) noexcept
+    {
+        std::lock_guard Lock( m_Mutex );
+        return m_bDone;
+    }
+
+    //------------------------------------------------------------------------------
+
+    void details::async_load_state::Wait( void ) noexcept
+    {
+        std::unique_lock Lock( m_Mutex );
+        m_DoneCondition.wait( Lock, [&]{ return m_bDone; } );
+    }
+
+    //------------------------------------------------------------------------------
+    // Returns false when the load is already done so the coroutine does not suspend
+
+    bool details::async_load_state::setContinuation( std::coroutine_handle<> Handle ) noexcept
+    {
+        std::lock_guard Lock( m_Mutex );
+        if( m_bDone ) return false;
+        m_Continuation = Handle;
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr mapped_file::open( const std::wstring_view FileName ) noexcept
+    {
+        close();
+
+        const std::filesystem::path Path{ FileName };
+
+#ifdef _WIN32
+        HANDLE hFile = CreateFileW( Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+        if( hFile == INVALID_HANDLE_VALUE )
+            return xerr::create<state::FAILURE, "Fail to open the file to map">();
+
+        LARGE_INTEGER Size;
+        if( GetFileSizeEx( hFile, &Size ) == FALSE || Size.QuadPart == 0 )
+        {
+            CloseHandle(hFile);
+            return xerr::create<state::FAILURE, "Fail to get the size of the file to map">();
+        }
+
+        HANDLE hMapping = CreateFileMappingW( hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr );
+        CloseHandle(hFile);
+        if( hMapping == nullptr )
+            return xerr::create<state::FAILURE, "Fail to create the file mapping">();
+
+        // The view keeps the mapping alive
+        void* pData = MapViewOfFile( hMapping, FILE_MAP_COPY, 0, 0, 0 );
+        CloseHandle(hMapping);
+        if( pData == nullptr )
+            return xerr::create<state::FAILURE, "Fail to map the file">();
+
+        m_pData = static_cast<std::byte*>(pData);
+        m_Size  = static_cast<std::size_t>(Size.QuadPart);
+#else
+        const int hFile = ::open( Path.c_str(), O_RDONLY );
+        if( hFile < 0 )
+            return xerr::create<state::FAILURE, "Fail to open the file to map">();
+
+        struct stat Stat;
+        if( fstat( hFile, &Stat ) != 0 || Stat.st_size == 0 )
+        {
+            ::close(hFile);
+            return xerr::create<state::FAILURE, "Fail to get the size of the file to map">();
+        }
+
+        // The mapping keeps the file alive
+        void* pData = mmap( nullptr, static_cast<std::size_t>(Stat.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, hFile, 0 );
+        ::close(hFile);
+        if( pData == MAP_FAILED )
+            return xerr::create<state::FAILURE, "Fail to map the file">();
+
+        m_pData = static_cast<std::byte*>(pData);
+        m_Size  = static_cast<std::size_t>(Stat.st_size);
+#endif
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    void mapped_file::close( void ) noexcept
+    {
+        if( m_pData == nullptr ) return;
+
+#ifdef _WIN32
+        UnmapViewOfFile( m_pData );
+#else
+        munmap( m_pData, m_Size );
+#endif
+        m_pData = nullptr;
+        m_Size  = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    // Reads one resource of a bundle with positioned reads
+    //------------------------------------------------------------------------------
+
+    struct bundle_source final : details::load_source
+    {
+        bundle_source( const bundle_reader& Bundle, std::uint64_t Position, std::uint64_t End ) noexcept 
+            : m_Bundle{ Bundle }, m_Position{ Position }, m_End{ End } {}
+
+        xerr ReadSpan( std::span<std::byte> View ) noexcept override
+        {
+            if( m_Position + View.size() > m_End )
+                return xerr::create<state::FAILURE, "Trying to read past the end of the resource in the bundle">();
+
+            if( auto Err = m_Bundle.ReadAt( m_Position, View ); Err )
+                return Err;
+
+            m_Position += View.size();
+            return {};
+        }
+
+        xerr ReadTail( std::span<std::byte> View ) noexcept override
+        {
+            if( m_Position + View.size() > m_End )
+                return xerr::create<state::FAILURE, "The end of the resource is missing">();
+
+            return m_Bundle.ReadAt( m_End - View.size(), View );
+        }
+
+        const bundle_reader&    m_Bundle;
+        std::uint64_t           m_Position;
+        std::uint64_t           m_End;
+    };
+
+    //------------------------------------------------------------------------------
+    // The header comes from the table of contents so there is nothing to read
+
+    xerr stream::LoadHeader( const bundle_reader& Bundle, std::uint64_t ID, std::size_t SizeOfT ) noexcept
+    {
+        auto pEntry = Bundle.findEntry(ID);
+        if( pEntry == nullptr )
+            return xerr::create<state::FAILURE, "The resource is not in the bundle">();
+
+        return DecodeHeader( std::span{ reinterpret_cast<const std::byte*>(&pEntry->m_Header), sizeof(header) }, SizeOfT );
+    }
+
+    //------------------------------------------------------------------------------
+
+    void* stream::LoadObject( const bundle_reader& Bundle, std::uint64_t ID ) noexcept
+    {
+        auto pEntry = Bundle.findEntry(ID);
+        if( pEntry == nullptr )
+            return nullptr;
+
+        bundle_source Source{ Bundle, pEntry->m_Offset + sizeof(header), pEntry->m_Offset + pEntry->m_Size };
+        return LoadObject( Source );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr stream::LoadRequirements( const bundle_reader& Bundle, std::uint64_t ID, memory_requirements& Requirements ) noexcept
+    {
+        auto pEntry = Bundle.findEntry(ID);
+        if( pEntry == nullptr )
+            return xerr::create<state::FAILURE, "The resource is not in the bundle">();
+
+        bundle_source Source{ Bundle, pEntry->m_Offset + sizeof(header), pEntry->m_Offset + pEntry->m_Size };
+        return LoadRequirements( Source, Requirements );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr bundle_writer::open( const std::wstring_view FileName ) noexcept
+    {
+        m_Entries.clear();
+
+        if( auto Err = m_File.open(FileName, "wb"); Err )
+            return Err;
+
+        // The header is written again when closing
+        const stream::bundle_header Header{};
+        return m_File.WriteSpan( std::span{ reinterpret_cast<const std::byte*>(&Header), sizeof(Header) } );
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr bundle_writer::BeginEntry( void ) noexcept
+    {
+        std::size_t Pos;
+        if( auto Err = m_File.Tell(Pos); Err )
+            return Err;
+
+        // Every resource starts in its own page so stored resources stay aligned
+        const std::size_t Padding = ((Pos + stream::store_alignment_v - 1) & ~static_cast<std::size_t>(stream::store_alignment_v - 1)) - Pos;
+        if( Padding )
+        {
+            if( auto Err = m_File.putC(0, static_cast<int>(Padding), false); Err )
+                return Err;
+        }
+
+        m_EntryStart = Pos + Padding;
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr bundle_writer::EndEntry( std::uint64_t ID ) noexcept
+    {
+        std::size_t Pos;
+        if( auto Err = m_File.Tell(Pos); Err )
+            return Err;
+
+        auto& Entry = m_Entries.emplace_back();
+        Entry.m_ID                      = ID;
+        Entry.m_Offset                  = m_EntryStart;
+        Entry.m_Size                    = Pos - m_EntryStart;
+        Entry.m_Header                  = m_Stream.m_Header;
+        Entry.m_Header.m_SizeOfData     = Entry.m_Size - sizeof(stream::header);
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr bundle_writer::close( void ) noexcept
+    {
+        std::ranges::sort( m_Entries, []( const stream::bundle_entry& A, const stream::bundle_entry& B ){ return A.m_ID < B.m_ID; } );
+
+        if( std::ranges::adjacent_find( m_Entries, []( const stream::bundle_entry& A, const stream::bundle_entry& B ){ return A.m_ID == B.m_ID; } ) != m_Entries.end() )
+            return xerr::create<state::FAILURE, "The same id was added twice to the bundle">();
+
+        stream::bundle_header Header;
+        Header.m_Magic      = stream::bundle_magic_v;
+        Header.m_Version    = stream::bundle_version_v;
+        Header.m_nEntries   = static_cast<std::uint32_t>(m_Entries.size());
+
+        std::size_t Pos;
+        if( auto Err = m_File.Tell(Pos); Err )
+            return Err;
+
+        Header.m_TocOffset = Pos;
+
+        if( auto Err = m_File.WriteSpan( std::span{ reinterpret_cast<const std::byte*>(m_Entries.data()), m_Entries.size() * sizeof(stream::bundle_entry) } ); Err )
+            return Err;
+
+        if( auto Err = m_File.SeekOrigin(0); Err )
+            return Err;
+
+        if( auto Err = m_File.WriteSpan( std::span{ reinterpret_cast<const std::byte*>(&Header), sizeof(Header) } ); Err )
+            return Err;
+
+        m_File.close();
+        m_Entries.clear();
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    xerr bundle_reader::open( const std::wstring_view FileName ) noexcept
+    {
+        close();
+
+        const std::filesystem::path Path{ FileName };
+
+#ifdef _WIN32
+        HANDLE hFile = CreateFileW( Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+        if( hFile == INVALID_HANDLE_VALUE )
+            return xerr::create<state::FAILURE, "Fail to open the bundle">();
+
+        m_hFile = reinterpret_cast<std::intptr_t>(hFile);
+#else
+        m_hFile = ::open( Path.c_str(), O_RDONLY );
+        if( m_hFile < 0 )
+            return xerr::create<state::FAILURE, "Fail to open the bundle">();
+#endif
+
+        stream::bundle_header Header;
+        if( auto Err = ReadAt( 0, std::span{ reinterpret_cast<std::byte*>(&Header), sizeof(Header) } ); Err )
+        {
+            close();
+            return Err;
+        }
+
+        if( Header.m_Magic != stream::bundle_magic_v || Header.m_Version != stream::bundle_version_v )
+        {
+            close();
+            return xerr::create<state::UNKOWN_FILE_TYPE, "The file is not a bundle (or it is from a different version)">();
+        }
+
+        m_Entries.resize( Header.m_nEntries );
+        if( auto Err = ReadAt( Header.m_TocOffset, std::span{ reinterpret_cast<std::byte*>(m_Entries.data()), m_Entries.size() * sizeof(stream::bundle_entry) } ); Err )
+        {
+            close();
+            return Err;
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    void bundle_reader::close( void ) noexcept
+    {
+        m_Entries.clear();
+        if( m_hFile == -1 ) return;
+
+#ifdef _WIN32
+        CloseHandle( reinterpret_cast<HANDLE>(m_hFile) );
+#else
+        ::close( static_cast<int>(m_hFile) );
+#endif
+        m_hFile = -1;
+    }
+
+    //------------------------------------------------------------------------------
+    // Does not touch the file position so any number of threads can call it
+
+    xerr bundle_reader::ReadAt( std::uint64_t Offset, std::span<std::byte> View ) const noexcept
+    {
+        while( View.empty() == false )
+        {
+#ifdef _WIN32
+            OVERLAPPED  Overlapped  {};
+            DWORD       nRead       = 0;
+            Overlapped.Offset       = static_cast<DWORD>(Offset);
+            Overlapped.OffsetHigh   = static_cast<DWORD>(Offset >> 32);
+
+            const DWORD ToRead = static_cast<DWORD>( std::min<std::size_t>( View.size(), 1u << 30 ) );
+            if( ReadFile( reinterpret_cast<HANDLE>(m_hFile), View.data(), ToRead, &nRead, &Overlapped ) == FALSE || nRead == 0 )
+                return xerr::create<state::FAILURE, "Fail to read from the bundle">();
+#else
+            const auto nRead = ::pread( static_cast<int>(m_hFile), View.data(), std::min<std::size_t>( View.size(), 1u << 30 ), static_cast<off_t>(Offset) );
+            if( nRead < 0 && errno == EINTR ) continue;
+            if( nRead <= 0 )
+                return xerr::create<state::FAILURE, "Fail to read from the bundle">();
+#endif
+            View    = View.subspan( static_cast<std::size_t>(nRead) );
+            Offset += static_cast<std::uint64_t>(nRead);
+        }
+
+        return {};
+    }
+
+    //------------------------------------------------------------------------------
+
+    const stream::bundle_entry* bundle_reader::findEntry( std::uint64_t ID ) const noexcept
+    {
+        auto It = std::ranges::lower_bound( m_Entries, ID, {}, &stream::bundle_entry::m_ID );
+        if( It == m_Entries.end() || It->m_ID != ID ) return nullptr;
+        return &*It;
     }
-}
\ No newline at end of file
+}
@@ -7,7 +7,20 @@
 #include <variant>
 #include <string>
 #include <cassert>
+#include <cstring>
+#include <limits>
+#include <cstddef>
+#include <memory>
 #include <vector>
+#include <unordered_map>
+#include <thread>
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <condition_variable>
+#include <coroutine>
+#include <atomic>
+#include <chrono>
 
 #include "dependencies/xfile/source/xfile.h"
 #include "dependencies/xerr/source/xerr.h"
@@ -28,9 +41,9 @@ namespace xserializer
     //     that needs saving. There are certain cases where you can avoid this thought, check the example.
     //     Having the function allows this class to recurse across the hierarchy of the user classes/structures/buffer and arrays.
     //     Ones the class has finish loading there will be only one pointer that it is return which contains a 
-    //     the pointer of the main structure. The hold thing will have been allocated as a
-    //     single block of memory. This means that the pointer return is the only pointer that
-    //     needs to be deleted.
+    //     the pointer of the main structure. The hold thing will have been allocated as one
+    //     block per pack (or as a single block with stream::LoadInto). Only the unique packs
+    //     and the main pointer need to be deleted.
     //
     //<P>  Loading is design to be broken up into 3 stages. The Loading The Header which load minimum information
     //     about resource, load object which loads the file into memory and finally resolve which calls an specific 
@@ -66,22 +79,42 @@ namespace xserializer
     //     additional 32bit dummy variable in the structure. In the other solution the macro will contain 
     //     a smart pointer for 64 bits environments. That smart pointer class will have a global array of real
     //     pointers where it will allocate its entries. 
+    //     Structures that use rel_ptr instead of data_ptr don't have this problem since the pointer is 
+    //     always a 32bit offset relative to it self. They also don't need any fixup at load time.
     //
     //<P><B>Physical File layout in disk</B>
     //<CODE>
     //                          +----------------+      <-+
     //                          | File Header    |        | File header is never allocated.
     //                          +----------------+ <-+  <-+
-    //                          | BlockSizes +   |   |
-    //                          | PointerInfo +  |   |  This is temporary allocated and it gets deleted 
-    //                          | PackInfo       |   |  before the LoadObject function returns.
-    //                          |                |   |
+    //                          | PackInfo +     |   |  The tables, in this order. They are compressed as a 
+    //                          | BlockSizes +   |   |  single unit (except for stored files) and they live in
+    //                          | Relocations +  |   |  temporary memory that is reused by the next load.
+    //                          | [Checksums]    |   |  Checksums are only there when the file was saved with them.
     //                          +----------------+ <-+  <-+ 
     //                          |                |        | Here are a list of blocks which contain the real
     //                          | Blocks         |        | data that the user saved. Blocks are compress
     //                          |                |        | by the system and decompress at load time.
     //                          |                |        | The system will call a user function to allocate the memory.
     //                          +----------------+      <-+
+    //
+    //     Stored files (compression_level::STORE) have no blocks. The tables are not compressed
+    //     and each pack starts at a store_alignment_v (4KB) offset from the start of the header:
+    //
+    //                          | File Header    |
+    //                          | Tables         |        Not compressed.
+    //                          | Padding        |        Up to the next 4KB boundary.
+    //                          | Pack 0         |
+    //                          | Padding        |
+    //                          | Pack 1 ...     |
+    //
+    //     Streamed files write the blocks as they fill, so everything else goes at the end:
+    //
+    //                          | File Header    |        Only has the streamed flag set.
+    //                          | Blocks         |        In the order they filled up.
+    //                          | Tables +       |        The same tables plus the offset of every block
+    //                          | BlockOffsets   |        (from the end of the first header).
+    //                          | File Header    |        The real header of the resource.
     //</CODE>
     // Example:
     //------------------------------------------------------------------------------
@@ -94,6 +127,43 @@ namespace xserializer
         T* m_pValue;
     };
 
+    //-----------------------------------------------------------------------------------------------------
+    // Pointer that stores the distance in bytes from itself to the data. It does not need to be fixed 
+    // at load time and it is the same size in 32 and 64 bits. The data that it points to is saved in 
+    // the same pack as the pointer (the distance must fit in 32 bits). Note that copying a rel_ptr 
+    // to a different address breaks it.
+    //-----------------------------------------------------------------------------------------------------
+    template< typename T >
+    struct alignas(std::uint32_t) rel_ptr
+    {
+        std::int32_t    m_Offset{ 0 };          // Zero means nullptr
+
+        T*              get         (void)                  const   noexcept { return m_Offset ? reinterpret_cast<T*>(const_cast<std::byte*>(reinterpret_cast<const std::byte*>(this)) + m_Offset) : nullptr; }
+        void            set         (const T* pData)                noexcept 
+        {
+            const auto Distance = pData ? reinterpret_cast<const std::byte*>(pData) - reinterpret_cast<const std::byte*>(this) : 0;
+            assert( Distance >= std::numeric_limits<std::int32_t>::min() && Distance <= std::numeric_limits<std::int32_t>::max() );
+            m_Offset = static_cast<std::int32_t>(Distance);
+        }
+        T*              operator -> (void)                  const   noexcept { return get(); }
+        T&              operator [] (std::size_t Index)     const   noexcept { return get()[Index]; }
+        explicit        operator bool (void)                const   noexcept { return m_Offset != 0; }
+    };
+    static_assert(sizeof(rel_ptr<int>) == 4);
+
+    //-----------------------------------------------------------------------------------------------------
+    // Tells the serializer that the bytes of a type in memory are exactly the bytes that should be saved
+    // (no pointers inside). Arrays of these types are written with a single copy instead of one 
+    // SerializeIO call per element. Types can opt-in by specializing this template or by adding:
+    //     static constexpr bool xserializer_trivial_v = true;
+    // When saving with endian swapping these types can't be written as a blob, so structures must also
+    // have a SerializeIO (used to swap them member by member) while atomic types are swapped in bulk.
+    // Since SerializeIO is declared for every type the structure must also say that it has one:
+    //     static constexpr bool xserializer_swap_members_v = true;
+    //-----------------------------------------------------------------------------------------------------
+    template< typename T >
+    struct is_trivially_serializable : std::false_type {};
+
     union mem_type
     {
         std::uint8_t    m_Value{ 0 };
@@ -152,6 +222,90 @@ namespace xserializer
 
     inline constexpr default_memory_hadler default_memory_handler_v;
 
+    //------------------------------------------------------------------------------
+    // Keeps the freed memory in size classes (powers of two from 64 bytes to 1MB) so loading
+    // and unloading the same kind of resources over and over reuses the same blocks instead
+    // of going to the heap. The blocks are only returned to the system when the pool dies.
+    // It is thread safe, so many streams can share one pool.
+    //------------------------------------------------------------------------------
+    class pool_memory_handler final : public memory_handle_base
+    {
+    public:
+
+        constexpr static std::size_t    min_class_size_v    = 64;
+        constexpr static std::size_t    num_classes_v       = 15;           // 64 bytes ... 1MB
+        constexpr static std::size_t    slab_size_v         = 256 * 1024;   // Small blocks are carved from slabs of this size
+
+                                    pool_memory_handler         (void)                                                                                      noexcept = default;
+                                    pool_memory_handler         (const pool_memory_handler&)                                                                = delete;
+                                   ~pool_memory_handler         (void)                                                                                      noexcept;
+        void*                       Allocate                    (mem_type Type, std::size_t Size, std::size_t Alignment)                            const   noexcept override;
+        void                        Free                        (mem_type Type, void* pMemory)                                                      const   noexcept override;
+
+    protected:
+
+        // Sits right before every block
+        struct block_header
+        {
+            std::uint32_t           m_iClass;                   // Size class or large_class_v
+            std::uint32_t           m_Offset;                   // Distance to the start of the allocation (large blocks only)
+            block_header*           m_pNext;                    // Next free block of the same class (only valid while free)
+        };
+        static_assert(sizeof(block_header) == 16);
+
+        constexpr static std::uint32_t  large_class_v       = 0xffffffff;
+
+        mutable std::mutex                                  m_Mutex         {};
+        mutable std::array<block_header*, num_classes_v>    m_FreeList      {};
+        mutable std::vector<void*>                          m_Slabs         {};
+    };
+
+    //------------------------------------------------------------------------------
+    // Bump allocator for the packs of a single resource. Free does nothing, all the memory
+    // goes back to the backing handler at once with Reset (or when the arena dies), which
+    // also takes care of the packs that are not unique. Backing it with a pool_memory_handler
+    // makes loading and unloading a resource almost free of heap calls.
+    //      xserializer::arena_memory_handler   Arena{ Pool };
+    //      xserializer::stream                 Stream{ Arena };
+    //      Stream.Load( L"file.bin", pObject );
+    //      ...
+    //      Arena.Reset();
+    // An arena is meant for one resource at a time so it is not thread safe.
+    //------------------------------------------------------------------------------
+    class arena_memory_handler final : public memory_handle_base
+    {
+    public:
+
+        constexpr static std::size_t    default_chunk_size_v = 256 * 1024;
+
+                                    arena_memory_handler        ( const memory_handle_base& Backing     = default_memory_handler_v
+                                                                , std::size_t               ChunkSize   = default_chunk_size_v
+                                                                )                                                                                           noexcept : m_Backing{ Backing }, m_ChunkSize{ ChunkSize } {}
+                                    arena_memory_handler        (const arena_memory_handler&)                                                               = delete;
+                                   ~arena_memory_handler        (void)                                                                                      noexcept { Reset(); }
+        void*                       Allocate                    (mem_type Type, std::size_t Size, std::size_t Alignment)                            const   noexcept override;
+        void                        Free                        (mem_type, void*)                                                                   const   noexcept override {}
+        void                        Reset                       (void)                                                                                      noexcept;
+        std::size_t                 getAllocatedSize            (void)                                                                              const   noexcept { return m_AllocatedSize; }
+
+    protected:
+
+        // Sits at the start of every chunk
+        struct chunk
+        {
+            chunk*                  m_pNext;
+            std::size_t             m_Size;
+        };
+        static_assert(sizeof(chunk) == 16);
+
+        const memory_handle_base&   m_Backing;
+        std::size_t                 m_ChunkSize;
+        mutable chunk*              m_pChunks           {};
+        mutable std::byte*          m_pCurrent          {};
+        mutable std::byte*          m_pEnd              {};
+        mutable std::size_t         m_AllocatedSize     {};             // Bytes handed out since the last Reset
+    };
+
     class stream;
     // User should place all their serializing function inside the name space
     // Note that the full name space is:
@@ -167,7 +321,8 @@ namespace xserializer
     }
 
     enum class compression_level : std::uint8_t
-    { FAST
+    { STORE                 // No compression, packs are page aligned in the file so they can be memory mapped (see stream::LoadMapped)
+    , FAST
     , LOW
     , MEDIUM
     , HIGH
@@ -180,12 +335,250 @@ namespace xserializer
     , UNKOWN_FILE_TYPE
     };
 
+    //------------------------------------------------------------------------------
+    // Each pack records the codec that compressed it. The first ids are built in, users
+    // can register their own codecs from USER_FIRST on (see RegisterCodec).
+    //------------------------------------------------------------------------------
+    enum class codec_id : std::uint8_t
+    { XCOMPRESSION          // Built in xcompression (chained or independent blocks, depends on compression_level)
+    , STORE                 // Blocks are copied as they are (decode is a memcpy)
+    , SHUFFLE2              // Byte shuffle of 2 byte elements, then xcompression (int16, half floats)
+    , SHUFFLE4              // Byte shuffle of 4 byte elements, then xcompression (int32, floats)
+    , SHUFFLE8              // Byte shuffle of 8 byte elements, then xcompression (int64, doubles)
+    , DELTA4                // Differences of 32 bit values plus shuffle, then xcompression (sorted integers)
+    , BITPACK4              // Frame of reference bit packing of 32 bit values (integers in a small range)
+    , USER_FIRST = 0x40     // First id that users can register (the ones below are reserved for built in codecs)
+    , DEFAULT = 0xff        // Only for Serialize: use the codec set in the stream (see stream::setCodec)
+    };
+
+    //------------------------------------------------------------------------------
+    // Codecs compress one block at a time and every block is independent. Compress must 
+    // fail when the result does not fit in Destination, the block is then saved as it is.
+    // Decompress gets the exact uncompressed size of the block in Destination.
+    //------------------------------------------------------------------------------
+    struct codec_base
+    {
+        virtual xerr        Compress            (std::span<std::byte> Destination, std::span<const std::byte> Source, compression_level Level, std::size_t& CompressSize)    const noexcept = 0;
+        virtual xerr        Decompress          (std::span<std::byte> Destination, std::span<const std::byte> Source)                                                       const noexcept = 0;
+    };
+
+    // Register user codecs at start up, before any save or load uses them. The codec must outlive them.
+    xerr                    RegisterCodec       (codec_id ID, const codec_base& Codec)                                                                                      noexcept;
+    const codec_base*       getCodec            (codec_id ID)                                                                                                               noexcept;
+
+    //------------------------------------------------------------------------------
+    // Maps a whole file in memory as copy-on-write. Pages are shared between processes
+    // until they are written to. Objects returned by stream::LoadMapped live inside 
+    // the view so the mapped_file must be kept open for as long as the object is used.
+    //------------------------------------------------------------------------------
+    class mapped_file
+    {
+    public:
+                                    mapped_file                 (void)                                                                                      noexcept = default;
+                                    mapped_file                 (const mapped_file&)                                                                        = delete;
+                                   ~mapped_file                 (void)                                                                                      noexcept { close(); }
+        xerr                        open                        (const std::wstring_view FileName)                                                          noexcept;
+        void                        close                       (void)                                                                                      noexcept;
+        std::span<std::byte>        getView                     (void)                                                                              const   noexcept { return { m_pData, m_Size }; }
+
+    protected:
+
+        std::byte*                  m_pData             {};
+        std::size_t                 m_Size              {};
+    };
+
+    namespace details
+    {
+        struct async_load_state;
+
+        //------------------------------------------------------------------------------
+        // Where the loader reads from. Reads are sequential, Synchronize waits for the
+        // reads that are still in flight (sources with blocking reads don't need it).
+        //------------------------------------------------------------------------------
+        class load_source
+        {
+        public:
+            virtual xerr                ReadSpan            (std::span<std::byte> View)                                                                 noexcept = 0;
+            virtual xerr                Synchronize         (void)                                                                                      noexcept { return {}; }
+            virtual std::span<const std::byte> getRemaining (void)                                                                                      noexcept { return {}; } // Only sources in memory, the loader then decompresses without copying
+            virtual xerr                ReadTail            (std::span<std::byte> View)                                                                 noexcept; // Last bytes of the resource, only for streamed resources
+
+        protected:
+                                       ~load_source         (void)                                                                                      noexcept = default;
+        };
+
+        //------------------------------------------------------------------------------
+        // Where the saver writes to. Writes are sequential and Reserve is told the final
+        // size before the first write (targets that can't use it just ignore it).
+        //------------------------------------------------------------------------------
+        class save_target
+        {
+        public:
+            virtual xerr                WriteSpan           (std::span<const std::byte> View)                                                           noexcept = 0;
+            virtual void                Reserve             (std::size_t)                                                                               noexcept {}
+
+        protected:
+                                       ~save_target         (void)                                                                                      noexcept = default;
+        };
+    }
+
+    namespace details
+    {
+        struct loader_scratch;
+    }
+
+    //------------------------------------------------------------------------------
+    // Scratch memory of the loader: the tables, the staging and read buffers, the pack
+    // pointers, the decompression jobs and the decompressor. The buffers only grow, so
+    // after the first few loads small resources load without any scratch allocation.
+    // Every thread has one (see getThreadContext) which is what streams use unless they
+    // are given one with stream::setLoaderContext. A context serves one load at a time.
+    //------------------------------------------------------------------------------
+    class loader_context
+    {
+    public:
+                                    loader_context              (void)                                                                                      noexcept;
+                                    loader_context              (const loader_context&)                                                                     = delete;
+                                   ~loader_context              (void)                                                                                      noexcept;
+        void                        Release                     (void)                                                                                      noexcept;
+        std::size_t                 getScratchSize              (void)                                                                              const   noexcept;
+        static loader_context&      getThreadContext            (void)                                                                                      noexcept;
+
+    protected:
+
+        friend class stream;
+
+        std::unique_ptr<details::loader_scratch>    m_Scratch;
+    };
+
+    //------------------------------------------------------------------------------
+    // Memory needed to load a resource, see stream::LoadRequirements. Packs are counted
+    // by their type, the index of the arrays is mem_type::m_Value.
+    //------------------------------------------------------------------------------
+    struct memory_requirements
+    {
+        constexpr static std::size_t    num_types_v     = 8;
+
+        std::array<std::uint64_t, num_types_v>  m_Size          {};     // Bytes of all the packs of each type
+        std::array<std::uint32_t, num_types_v>  m_nPacks        {};     // Packs of each type (one allocation each)
+        std::uint64_t                           m_RegionSize    {};     // Size of the region that stream::LoadInto needs
+    };
+
+    //------------------------------------------------------------------------------
+    // Timings and counters of the saves (SaveFile) and loads (LoadObject) of the streams
+    // that are given one with stream::setStats. Without one the stream doesn't even read
+    // the clock. Many streams and threads can share a stats, everything adds up. When
+    // tracing, every timed stage is also kept as an event with its thread, which can
+    // be exported for chrome://tracing (or Perfetto).
+    //
+    //      xserializer::stats Stats{ true };
+    //      Stream.setStats(&Stats);
+    //      Stream.Load(L"file.bin", pObject);
+    //      Stats.getDuration(xserializer::stats::stage::LOAD_IO_WAIT);
+    //      Stats.SaveChromeTrace(L"load.json");
+    //------------------------------------------------------------------------------
+    class stats
+    {
+    public:
+
+        enum class stage : std::uint8_t
+        { SAVE_SERIALIZE            // Going through the user structures (SerializeIO)
+        , SAVE_COMPRESS             // Compressing a job (a pack or a block), in the thread that did it
+        , SAVE_TABLES               // Encoding and compressing the packs, block sizes and relocation tables
+        , SAVE_WRITE                // Writing into the target
+        , LOAD_HEADER               // LoadHeader
+        , LOAD_TABLES               // Reading and decompressing the tables
+        , LOAD_IO_WAIT              // Waiting for reads to finish (Synchronize)
+        , LOAD_DECOMPRESS           // Decompressing (or copying) blocks, in the thread that did it
+        , LOAD_ALLOCATE             // Allocating the memory of the packs
+        , LOAD_FIXUP                // Resolving the pointers
+        , ENUM_COUNT
+        };
+
+        enum class counter : std::uint8_t
+        { BYTES_READ                // Bytes of the resources that were loaded (tables and packs)
+        , BYTES_WRITTEN             // Bytes of the resources that were saved (header included)
+        , BYTES_DECOMPRESSED        // Bytes of the packs that came out of blocks
+        , BYTES_COMPRESSED          // Bytes of the packs that went into blocks
+        , PACKS
+        , BLOCKS
+        , POINTERS
+        , ALLOCATIONS               // Packs that were allocated by the memory handler
+        , INCOMPRESSIBLE_BLOCKS     // Blocks that are stored as they are because they did not compress
+        , BYTES_DEDUPLICATED        // Bytes of pointed-to buffers that were not saved because they were a copy (see setDeduplication)
+        , ENUM_COUNT
+        };
+
+        struct event
+        {
+            std::uint64_t                       m_Start             {};     // Nanoseconds from when the stats was created (or Reset)
+            std::uint64_t                       m_Duration          {};     // Nanoseconds
+            std::uint32_t                       m_ThreadID          {};     // Small id of the thread, not the one of the OS
+            stage                               m_Stage             {};
+        };
+
+        using clock = std::chrono::steady_clock;
+
+                                    stats                       (bool bTrace = false)                                                                       noexcept : m_bTrace{ bTrace } {}
+                                    stats                       (const stats&)                                                                              = delete;
+        void                        Reset                       (void)                                                                                      noexcept;
+        void                        AddStage                    (stage Stage, clock::time_point Start, clock::time_point End)                               noexcept;
+        void                        AddCounter                  (counter Counter, std::uint64_t Value)                                                      noexcept { m_Counters[static_cast<std::size_t>(Counter)].fetch_add(Value, std::memory_order_relaxed); }
+        std::uint64_t               getDuration                 (stage Stage)                                                                       const   noexcept { return m_Durations[static_cast<std::size_t>(Stage)].load(std::memory_order_relaxed); }
+        std::uint64_t               getStageCount               (stage Stage)                                                                       const   noexcept { return m_nStages[static_cast<std::size_t>(Stage)].load(std::memory_order_relaxed); }
+        std::uint64_t               getCounter                  (counter Counter)                                                                   const   noexcept { return m_Counters[static_cast<std::size_t>(Counter)].load(std::memory_order_relaxed); }
+        std::vector<event>          getEvents                   (void)                                                                              const   noexcept;
+        static const char*          getName                     (stage Stage)                                                                               noexcept;
+        static const char*          getName                     (counter Counter)                                                                           noexcept;
+        void                        getChromeTrace              (std::string& Json)                                                                 const   noexcept;
+        xerr                        SaveChromeTrace             (const std::wstring_view FileName)                                                  const   noexcept;
+
+    protected:
+
+        constexpr static std::size_t    num_stages_v    = static_cast<std::size_t>(stage::ENUM_COUNT);
+        constexpr static std::size_t    num_counters_v  = static_cast<std::size_t>(counter::ENUM_COUNT);
+
+        std::array<std::atomic<std::uint64_t>, num_stages_v>    m_Durations     {};     // Nanoseconds of each stage
+        std::array<std::atomic<std::uint64_t>, num_stages_v>    m_nStages       {};     // Times that each stage happened
+        std::array<std::atomic<std::uint64_t>, num_counters_v>  m_Counters      {};
+        const bool                                              m_bTrace;
+        clock::time_point                                       m_Epoch         { clock::now() };  // Protected by m_EventsMutex
+        mutable std::mutex                                      m_EventsMutex   {};
+        std::vector<event>                                      m_Events        {};
+    };
+
+    namespace details
+    {
+        //------------------------------------------------------------------------------
+        // Times a stage until the end of the scope, does nothing without a stats
+        //------------------------------------------------------------------------------
+        class stats_scope
+        {
+        public:
+                                        stats_scope         (stats* pStats, stats::stage Stage)                                                         noexcept : m_pStats{ pStats }, m_Stage{ Stage } { if( m_pStats ) m_Start = stats::clock::now(); }
+                                        stats_scope         (const stats_scope&)                                                                        = delete;
+                                       ~stats_scope         (void)                                                                                      noexcept { if( m_pStats ) m_pStats->AddStage( m_Stage, m_Start, stats::clock::now() ); }
+
+        protected:
+
+            stats*                      m_pStats;
+            stats::stage                m_Stage;
+            stats::clock::time_point    m_Start             {};
+        };
+    }
+
+    template< class T >
+    class async_load;
+
+    class bundle_reader;
+    class lazy_file;
+
     class stream
     {
     public:
 
 
-                                    stream                      (const default_memory_hadler& MemoryHandler = default_memory_handler_v )                    noexcept;
+                                    stream                      (const memory_handle_base& MemoryHandler = default_memory_handler_v )                       noexcept;
 
         template< class T >
         inline      xerr            Save                        ( const std::wstring_view FileName
@@ -203,10 +596,36 @@ namespace xserializer
                                                                 , bool                  bSwapEndian = false
                                                                 )                                                                                           noexcept;
 
+        template< class T >
+        inline      xerr            Save                        ( std::vector<std::byte>& Buffer
+                                                                , const T&              Object
+                                                                , compression_level     Level       = compression_level::MEDIUM
+                                                                , mem_type              ObjectFlags = {}
+                                                                , bool                  bSwapEndian = false
+                                                                )                                                                                           noexcept;
+
+        template< class T >
+        inline      xerr            Save                        ( details::save_target& Target
+                                                                , const T&              Object
+                                                                , compression_level     Level       = compression_level::MEDIUM
+                                                                , mem_type              ObjectFlags = {}
+                                                                , bool                  bSwapEndian = false
+                                                                )                                                                                           noexcept;
+
         template< class T >
         xerr                        Load                        (xfile::stream& File, T*& pObject)                                                          noexcept;
         template< class T >
         xerr                        Load                        (const std::wstring_view FileName, T*& pObject )                                            noexcept;
+        template< class T >
+        xerr                        LoadRequirements            (const std::wstring_view FileName, memory_requirements& Requirements)                       noexcept;
+        template< class T >
+        xerr                        LoadInto                    (const std::wstring_view FileName, std::span<std::byte> Region, T*& pObject)                noexcept;
+        template< class T >
+        xerr                        LoadInto                    (xfile::stream& File, std::span<std::byte> Region, T*& pObject)                             noexcept;
+        template< class T >
+        xerr                        LoadInto                    (std::span<const std::byte> Data, std::span<std::byte> Region, T*& pObject)                 noexcept;
+        template< class T >
+        xerr                        LoadInto                    (const bundle_reader& Bundle, std::uint64_t ID, std::span<std::byte> Region, T*& pObject)   noexcept;
 
         void                        DontFreeTempData            (void)                                                                                      noexcept { m_bFreeTempData = false; }
         void*                       getTempData                 (void)                                                                              const   noexcept { assert(m_bFreeTempData == false);  return m_pTempBlockData; }
@@ -216,102 +635,354 @@ namespace xserializer
         template< class T >
         inline      xerr            Serialize                   (const T& A)                                                                                noexcept;
         template< class T, typename T_SIZE >
-        inline      xerr            Serialize                   ( T*const& pView, T_SIZE Size, mem_type MemoryFlags = {} )                                  noexcept;
+        inline      xerr            Serialize                   ( T*const& pView, T_SIZE Size, mem_type MemoryFlags = {}, std::uint8_t Quality = 0, codec_id Codec = codec_id::DEFAULT ) noexcept;
+        template< class T, typename T_SIZE >
+        inline      xerr            Serialize                   ( const rel_ptr<T>& Ptr, const T* pData, T_SIZE Size )                                      noexcept;
+        template< class T, typename T_SIZE >
+        inline      xerr            Serialize                   ( const rel_ptr<T>& Ptr, T_SIZE Size )                                                      noexcept;
+
+        template< class T >
+        xerr                        Load                        (std::span<const std::byte> Data, T*& pObject)                                              noexcept;
+        template< class T >
+        xerr                        LoadMapped                  (mapped_file& File, T*& pObject)                                                            noexcept;
+        template< class T >
+        async_load<T>               LoadAsync                   (const std::wstring_view FileName, T*& pObject)                                             noexcept;
+        template< class T >
+        xerr                        Load                        (const bundle_reader& Bundle, std::uint64_t ID, T*& pObject)                                noexcept;
+        template< class T >
+        xerr                        LoadLazy                    (lazy_file& File, T*& pObject)                                                              noexcept;
+        template< class T >
+        xerr                        LoadLazy                    (lazy_file& File, T*& pObject, std::uint8_t Quality)                                        noexcept;
 
         xerr                        LoadHeader                  (xfile::stream& File, std::size_t SizeOfT)                                                  noexcept;
+        xerr                        LoadHeader                  (details::load_source& Source, std::size_t SizeOfT)                                         noexcept;
         void*                       LoadObject                  (xfile::stream& File)                                                                       noexcept;
+        void*                       LoadObject                  (details::load_source& Source)                                                              noexcept;
+        xerr                        LoadHeader                  (std::span<const std::byte> Data, std::size_t SizeOfT)                                      noexcept;
+        void*                       LoadObject                  (std::span<const std::byte> Data)                                                           noexcept;
+        xerr                        LoadHeader                  (const bundle_reader& Bundle, std::uint64_t ID, std::size_t SizeOfT)                        noexcept;
+        void*                       LoadObject                  (const bundle_reader& Bundle, std::uint64_t ID)                                             noexcept;
+        void*                       LoadMappedObject            (std::span<std::byte> View)                                                                 noexcept;
+        xerr                        LoadRequirements            (xfile::stream& File, memory_requirements& Requirements)                                    noexcept;
+        xerr                        LoadRequirements            (details::load_source& Source, memory_requirements& Requirements)                           noexcept;
+        xerr                        LoadRequirements            (std::span<const std::byte> Data, memory_requirements& Requirements)                        noexcept;
+        xerr                        LoadRequirements            (const bundle_reader& Bundle, std::uint64_t ID, memory_requirements& Requirements)          noexcept;
         template< class T >
         void                        ResolveObject               (T*& pObject)                                                                               noexcept;
 
         void                        setResourceVersion          (std::uint16_t ResourceVersion)                                                             noexcept;
         void                        setSwapEndian               (bool SwapEndian)                                                                           noexcept;
+        void                        setThreadCount              (std::uint32_t nThreads)                                                                    noexcept;
+        void                        setIndependentBlocks        (bool bIndependentBlocks)                                                                   noexcept;
+        void                        setBlockSize                (std::uint32_t BlockSize)                                                                   noexcept;
+        void                        setCodec                    (codec_id Codec)                                                                            noexcept;
+        void                        setLoaderContext            (loader_context* pContext)                                                                  noexcept;
+        void                        setStreamingSave            (bool bStreaming)                                                                           noexcept;
+        void                        setChecksums                (bool bChecksums)                                                                           noexcept;
+        void                        setVerifyChecksums          (bool bVerify)                                                                              noexcept;
+        void                        setStats                    (stats* pStats)                                                                             noexcept;
+        void                        setDeduplication            (bool bDeduplicate)                                                                         noexcept;
 
         constexpr   bool            SwapEndian                  (void)                                                                              const   noexcept;
         constexpr   std::uint16_t   getResourceVersion          (void)                                                                              const   noexcept;
 
     protected:
 
-        static constexpr std::uint32_t  version_id_v        = 1;
-        static constexpr std::uint32_t  max_block_size_v    = 1024 * 64;
+        static constexpr std::uint32_t  version_id_v        = 2;            // Version that we write (version 1 files can still be loaded)
+        static constexpr std::uint32_t  version_id_v1_v     = 1;            // Original format with 16/32 bit counts and sizes
+        static constexpr std::uint32_t  default_block_size_v= 1024 * 64;    // Block size of files written before the block size was stored per pack
+        static constexpr std::uint32_t  min_block_size_v    = 1024 * 4;
+        static constexpr std::uint32_t  max_block_size_v    = 1024 * 1024 * 8;
+        static constexpr std::uint32_t  auto_blocks_v       = 16;           // Automatic block size aims for this many blocks per pack
+        static constexpr std::uint32_t  auto_max_block_v    = 1024 * 1024;  // Largest block size that the automatic mode will pick
+        static constexpr std::uint32_t  store_alignment_v   = 1024 * 4;     // Alignment of stored packs in the file (from the start of the header)
+        static constexpr std::uint32_t  reloc_chunk_size_v  = 1024 * 16;    // Max pointers in a chunk of the relocation table (chunks are resolved in parallel)
 
-        // This structure wont save to file
-        struct decompress_block
+        // Bits of header::m_Flags
+        static constexpr std::uint32_t  flags_streamed_v    = 1u << 0;      // Written by a streaming save, the real header and the tables are at the end
+        static constexpr std::uint32_t  flags_checksums_v   = 1u << 1;      // The tables have a CRC32C per block (after the relocation table)
+        static constexpr std::uint32_t  flags_all_v         = flags_streamed_v | flags_checksums_v;
+
+        // This structure wont save to file. The pointers are written as a relocation table sorted by
+        // (m_OffsetPack, m_OffSet) with the following layout:
+        //      u32     nChunks
+        //      u32     ChunkStart[nChunks]     - Byte offset of each chunk from the end of this array
+        //      runs    ...                     - Each chunk starts with a fresh state so it can be resolved by itself
+        // A run is a set of pointers with the same packs and constant strides (arrays of structures):
+        //      varint  Control                 - bit 0: new offset pack, bit 1: new target pack, bits 2..n: extra pointers in the run
+        //      varint  OffsetPack              - Only if bit 0, resets the offset to zero
+        //      varint  PointingATPack          - Only if bit 1, resets the target to zero
+        //      varint  Offset                  - Delta from the last pointer offset
+        //      zigzag  PointingAT              - Delta from the last pointer target
+        //      varint  OffsetStride            - Only if there are extra pointers
+        //      zigzag  PointingATStride        - Only if there are extra pointers
+        struct ref
         {
-            std::array<std::byte, max_block_size_v > m_Buff;
+            std::uint64_t                       m_PointingAT        {}; // What part of the file is this pointer pointing to
+            std::uint64_t                       m_OffSet            {}; // Byte offset where the pointer lives
+            std::uint64_t                       m_Count             {}; // Count of entries that this pointer is pointing to
+            std::uint32_t                       m_OffsetPack        {}; // Offset pack where the pointer is located
+            std::uint32_t                       m_PointingATPack    {}; // Pack location where we are pointing to
         };
+        static_assert(sizeof(ref) == 32);
 
         // This structure will save to file
-        struct ref
+        union pack_format
         {
-            std::uint32_t                       m_PointingAT        {}; // What part of the file is this pointer pointing to
-            std::uint32_t                       m_OffSet            {}; // Byte offset where the pointer lives
-            std::uint32_t                       m_Count             {}; // Count of entries that this pointer is pointing to
-            std::uint16_t                       m_OffsetPack        {}; // Offset pack where the pointer is located
-            std::uint16_t                       m_PointingATPack    {}; // Pack location where we are pointing to
+            std::uint8_t                        m_Value             { 0 };
+            struct
+            {
+                bool                            m_bIndependentBlocks:1; // -> On  - Each block was compressed by it self so it can be decompressed in any order
+                                                                        //    Off - Blocks are chained and must be decompressed in order
+                bool                            m_bStored:1;            // -> On  - The pack is not compressed (no blocks) and starts at a store_alignment_v offset
+                std::int8_t                     m_BlockSizeShift:4;     // -> Block size is default_block_size_v shifted by this (zero for older files)
+            };
         };
+        static_assert(sizeof(pack_format) == 1);
 
         // This structure will save to file
         struct pack
         {
             mem_type                            m_PackFlags         {}; // Flags which tells what type of memory this pack is            
-            std::uint32_t                       m_UncompressSize    {}; // How big is this pack uncompress
+            pack_format                         m_Format            {}; // How the blocks of this pack were written
+            std::uint8_t                        m_Quality           {}; // Quality tier of the data in this pack (0 is the coarsest)
+            codec_id                            m_Codec             {}; // Codec used to compress the blocks of this pack
             std::uint32_t                       m_nBlocks           {}; // Number of blocks needed to compress the pack
+            std::uint64_t                       m_UncompressSize    {}; // How big is this pack uncompress
+
+            constexpr std::uint32_t             getBlockSize        (void) const noexcept;
+        };
+        static_assert(sizeof(pack) == 16);
+
+        // This structure wont save to file. A block of a pack that is being streamed
+        struct stream_block
+        {
+            std::unique_ptr<std::byte[]>        m_pData             {}; // Null until the block is written to (or once it is flushed)
+            std::uint64_t                       m_Offset            {}; // Where the compressed block is (from the end of the first header)
+            std::uint32_t                       m_CompressSize      {}; // Zero until the block is flushed
+            std::uint32_t                       m_Checksum          {}; // Of the compressed block (only when saving checksums)
         };
 
         // This structure wont save to file
         struct pack_writing : public pack
         {
-            xfile::stream                       m_Data              {}; // raw Data for this block
+            inline void                         Write               (std::size_t Offset, const std::span<const std::byte> View, std::size_t SwapSize = 1) noexcept;
+            inline std::size_t                  Reserve             (std::size_t Size, std::size_t Alignment) noexcept;
+                   void                         WriteBlocks         (std::size_t Offset, std::span<const std::byte> View, std::size_t SwapSize) noexcept;
+
+            std::vector<std::byte>              m_Data              {}; // raw Data for this block
+            std::size_t                         m_Position          {}; // Where the next structure will be written
             std::uint32_t                       m_BlockSize         {}; // size of the block for compressing this pack
-            std::uint32_t                       m_CompressSize      {}; // How big is this pack compress
+            std::uint64_t                       m_CompressSize      {}; // How big is this pack compress
             std::vector<std::byte>              m_CompressData      {}; // Data in compress form
+
+            // Streaming saves keep the pack in blocks instead of m_Data (see stream::FlushBlocks)
+            bool                                m_bStreaming        {}; // The block size is fixed when the pack is allocated
+            std::uint64_t                       m_StreamSize        {}; // Size of the pack so far
+            std::vector<stream_block>           m_StreamBlocks      {}; // Every block of the pack so far
+            std::uint64_t                       m_nScanned          {}; // Blocks before this one were already flushed or are in m_Held
+            std::vector<std::array<std::uint64_t, 2>> m_Held        {}; // Ranges of blocks that were pinned the last time we tried to flush them
+        };
+
+        // This structure wont save to file. Range of a pack that is still going to be written
+        // so its blocks can't be flushed yet
+        struct pin
+        {
+            std::uint32_t                       m_iPack             {};
+            std::uint64_t                       m_Begin             {};
+            std::uint64_t                       m_End               {};
+        };
+
+        // This structure wont save to file. A pointed-to buffer that later copies can point to
+        struct dedup_entry
+        {
+            std::uint64_t                       m_Position          {}; // Where the buffer is in its pack
+            std::uint64_t                       m_Size              {}; // Size in bytes of the buffer
+            std::uint32_t                       m_iPack             {}; // Pack of the buffer
         };
 
         // This structure wont save to file
         struct writing
         {
-            std::uint32_t                       AllocatePack        (mem_type DefaultPackFlags) noexcept;
+            std::uint32_t                       AllocatePack        (mem_type DefaultPackFlags, std::uint8_t Quality, codec_id Codec) noexcept;
 
             std::vector<std::uint32_t>          m_CSizeStream       {}; // a in order List of compress sizes for packs and blocks
+            std::vector<std::uint32_t>          m_Checksums         {}; // Checksum of each compressed block (only when saving checksums)
             std::vector<ref>                    m_PointerTable      {}; // Table of all the pointer written
             std::vector<pack_writing>           m_Packs             {}; // Free-able memory + VRam/Core
-            xfile::stream*                      m_pFile             {};
             bool                                m_bEndian           {};
+            std::unordered_multimap<std::uint32_t, dedup_entry> m_Dedup {}; // Buffers by the checksum of their data (only when deduplicating)
+
+            // Only for streaming saves
+            details::save_target*               m_pTarget           {}; // Where the blocks go as soon as they are done
+            std::uint32_t                       m_StreamBlockSize   {}; // Block size of all the packs
+            std::uint64_t                       m_StreamOffset      {}; // Bytes of blocks written so far
+            std::vector<pin>                    m_Pins              {}; // Stack of the ranges that are being written
+            std::vector<std::array<std::uint64_t, 2>> m_HeldScratch {}; // Reused by FlushBlocks
         };
 
-        // This structure will save to file
+        // This structure will save to file. Note that the m_SerialFileVersion must be at the same
+        // offset for all the versions of the header so we can tell them apart.
         struct header
         {
-            std::uint32_t                       m_SizeOfData        {}; // Size of this hold data in disk excluding header
+            std::uint32_t                       m_HeaderSize        {}; // Size of this header in disk
             std::uint16_t                       m_SerialFileVersion {}; // Version generated by this system
-            std::uint16_t                       m_PackSize          {}; // Pack size
-            std::uint16_t                       m_nPointers         {}; // How big is the table with pointers
-            std::uint16_t                       m_nPacks            {}; // How many packs does it contain
-            std::uint16_t                       m_nBlockSizes       {}; // How many block sizes do we have
             std::uint16_t                       m_ResourceVersion   {}; // User version of this data
             std::uint16_t                       m_MaxQualities      {}; // Maximum number of qualities for this resource
-            std::uint16_t                       m_AutomaticVersion  {}; // The size of the main structure as a simple version of the file
+            std::uint16_t                       m_Reserved          {}; // Must be zero
+            std::uint32_t                       m_AutomaticVersion  {}; // The size of the main structure as a simple version of the file
+            std::uint32_t                       m_nPointers         {}; // How big is the table with pointers
+            std::uint32_t                       m_nPacks            {}; // How many packs does it contain
+            std::uint32_t                       m_nBlockSizes       {}; // How many block sizes do we have
+            std::uint32_t                       m_Flags             {}; // See the flags_*_v constants
+            std::uint64_t                       m_RelocSize         {}; // Size in bytes of the relocation table (uncompressed)
+            std::uint64_t                       m_PackSize          {}; // Size in disk of the packs, block sizes and relocation tables
+            std::uint64_t                       m_SizeOfData        {}; // Size of this hold data in disk excluding header
         };
+        static_assert(sizeof(header) == 56);
+
+        //
+        // Version 1 of the file (only used for loading old files)
+        //
+        struct ref_v1
+        {
+            std::uint32_t                       m_PointingAT        {};
+            std::uint32_t                       m_OffSet            {};
+            std::uint32_t                       m_Count             {};
+            std::uint16_t                       m_OffsetPack        {};
+            std::uint16_t                       m_PointingATPack    {};
+        };
+        static_assert(sizeof(ref_v1) == 16);
+
+        struct pack_v1
+        {
+            mem_type                            m_PackFlags         {};
+            std::array<std::uint8_t, 3>         m_Padding           {}; // Not initialized by the version 1 writer (can be anything)
+            std::uint32_t                       m_UncompressSize    {};
+            std::uint32_t                       m_nBlocks           {};
+        };
+        static_assert(sizeof(pack_v1) == 12);
+
+        struct header_v1
+        {
+            std::uint32_t                       m_SizeOfData        {};
+            std::uint16_t                       m_SerialFileVersion {};
+            std::uint16_t                       m_PackSize          {};
+            std::uint16_t                       m_nPointers         {};
+            std::uint16_t                       m_nPacks            {};
+            std::uint16_t                       m_nBlockSizes       {};
+            std::uint16_t                       m_ResourceVersion   {};
+            std::uint16_t                       m_MaxQualities      {};
+            std::uint16_t                       m_AutomaticVersion  {};
+        };
+        static_assert(sizeof(header_v1) == 20);
+        static_assert(offsetof(header_v1, m_SerialFileVersion) == offsetof(header, m_SerialFileVersion));
+
+        //
+        // Bundles (many resources in one file)
+        //
+        static constexpr std::uint32_t  bundle_magic_v      = 0x4E425358;   // "XSBN"
+        static constexpr std::uint16_t  bundle_version_v    = 1;
+
+        // This structure will save to file (start of the bundle)
+        struct bundle_header
+        {
+            std::uint32_t                       m_Magic             {}; // Always bundle_magic_v
+            std::uint16_t                       m_Version           {}; // Version of the bundle format
+            std::uint16_t                       m_Reserved          {}; // Must be zero
+            std::uint32_t                       m_nEntries          {}; // How many resources are in the bundle
+            std::uint32_t                       m_Flags             {}; // Must be zero
+            std::uint64_t                       m_TocOffset         {}; // Where the table of contents starts
+        };
+        static_assert(sizeof(bundle_header) == 24);
+
+        // This structure will save to file (table of contents sorted by m_ID)
+        struct bundle_entry
+        {
+            std::uint64_t                       m_ID                {}; // User id of the resource
+            std::uint64_t                       m_Offset            {}; // Where the resource starts (from the start of the bundle)
+            std::uint64_t                       m_Size              {}; // Size of the resource including its header
+            header                              m_Header            {}; // Copy of the header so loading does not have to read it
+        };
+        static_assert(sizeof(bundle_entry) == 24 + sizeof(header));
+
+        friend class bundle_writer;
+        friend class bundle_reader;
+        friend class lazy_file;
 
     protected:
 
-                    xerr            SaveFile            (void)                                                                                              noexcept;
-        inline      xfile::stream&  getW                (void)                                                                                              noexcept;
+        template< class T, class T_TARGET >
+        inline      xerr            SaveObject          (T_TARGET& Target, const T& Object, compression_level Level, mem_type ObjectFlags, bool bSwapEndian)   noexcept;
+                    xerr            SaveFile            (xfile::stream& File)                                                                               noexcept;
+                    xerr            SaveFile            (std::vector<std::byte>& Buffer)                                                                    noexcept;
+                    xerr            SaveFile            (details::save_target& Target)                                                                      noexcept;
+        using       serialize_fn    = xerr(*)(stream& Stream, const void* pObject) noexcept;
+                    xerr            SaveStreamed        (xfile::stream& File, mem_type ObjectFlags, const void* pObject, serialize_fn Function)             noexcept;
+                    xerr            SaveStreamed        (std::vector<std::byte>& Buffer, mem_type ObjectFlags, const void* pObject, serialize_fn Function)  noexcept;
+                    xerr            SaveStreamed        (details::save_target& Target, mem_type ObjectFlags, const void* pObject, serialize_fn Function)    noexcept;
+                    xerr            EncodeTables        (std::span<const std::uint64_t> BlockOffsets, std::vector<std::byte>& Tables)                      noexcept;
+                    header          getDiskHeader       (void)                                                                                      const   noexcept;
+        inline      bool            isStreaming         (void)                                                                                      const   noexcept;
+        inline      std::size_t     PushPin             (std::uint64_t Begin, std::uint64_t End)                                                            noexcept;
+        inline      void            PopPin              (std::size_t iPin)                                                                                  noexcept;
+                    std::uint64_t   PinnedUntil         (std::uint32_t iPack, std::uint64_t Begin, std::uint64_t End)                               const   noexcept;
+                    xerr            FlushBlocks         (bool bFinal)                                                                                       noexcept;
+        inline      pack_writing&   getW                (void)                                                                                              noexcept;
 //                    file::stream&   getTable            (void)                                                                                      const   noexcept;
         constexpr   bool            isLocalVariable     (const std::byte* pRange)                                                                   const   noexcept;
         constexpr   std::int32_t    ComputeLocalOffset  (const std::byte* pItem)                                                                    const   noexcept;
-                    xerr            HandlePtrDetails    (const std::byte* pA, std::size_t SizeofA, std::size_t Count, mem_type MemoryFlags)                 noexcept;
-        inline      xerr            Handle              (const std::span<const std::byte> View)                                                             noexcept;
+                    xerr            HandlePtrDetails    (const std::byte* pA, std::size_t SizeofA, std::size_t Count, mem_type MemoryFlags, std::uint8_t Quality, codec_id Codec) noexcept;
+                    xerr            HandleRelPtrDetails (const std::byte* pA, std::size_t SizeofA, std::size_t Count)                                       noexcept;
+                    void            DeduplicatePointer  (std::uint64_t DataPos, std::uint64_t DataSize)                                                     noexcept;
+        template< class T >
+        inline      xerr            SerializeElements   (const T* pView, std::uint64_t Size)                                                                noexcept;
+        template< class T >
+        inline      xerr            SerializeMembers    (const T& A)                                                                                        noexcept;
+        inline      xerr            Handle              (const std::span<const std::byte> View, std::size_t SwapSize = 1)                                   noexcept;
+        static      void            SwapBytes           (std::span<std::byte> Data, std::size_t SwapSize)                                                   noexcept;
+        template< typename T_FUNCTION >
+        inline      xerr            SerializeNonLocal   (const std::byte* pData, std::size_t Size, T_FUNCTION&& Function)                                   noexcept;
+                    xerr            LoadPacksParallel   (details::load_source& Source, const pack* pPack, const std::uint32_t* pBlockSizes, const std::uint64_t* pBlockOffsets, std::byte** pPackPointers) noexcept;
+                    xerr            CheckBlockSizes     (const pack* pPack, const std::uint32_t* pBlockSizes, std::uint32_t& MaxBlockSize)         const   noexcept;
+                    xerr            LoadPacksStored     (details::load_source& Source, const pack* pPack, std::byte** pPackPointers)                        noexcept;
+                    xerr            DecodeHeader        (std::span<const std::byte> Data, std::size_t SizeOfT)                                              noexcept;
+                    xerr            ReadTables          (details::load_source& Source, std::span<std::byte>& Tables)                                        noexcept;
+                    xerr            ComputeRequirements (const pack* pPack, memory_requirements& Requirements)                                      const   noexcept;
+        static constexpr bool       isRegionPack        (mem_type Type)                                                                                     noexcept { return !Type.m_bUnique && !Type.m_bTempMemory && !Type.m_bVRam; }
+                    std::byte*      AllocatePackMemory  (const pack& Pack)                                                                                  noexcept;
+                    void            FreePackMemory      (const pack& Pack, std::byte* pData)                                                        const   noexcept;
+                    loader_context& getLoaderContext    (void)                                                                                      const   noexcept;
+        static      std::uint32_t   ChooseBlockSize     (std::uint32_t BlockSize, std::uint64_t PackSize)                                   noexcept;
+        static      void            EncodeRelocations   (std::vector<ref>& Refs, std::vector<std::byte>& Table)                                             noexcept;
+                    xerr            ResolveRelocations  (std::span<const std::byte> Table, const pack* pPack, std::byte* const* pPackPointers, std::vector<ref>* pDeferred = nullptr) const noexcept;
+                    void*           LoadLazyObject      (lazy_file& File, std::uint8_t Quality, bool bDeferUnique)                                          noexcept;
+                    void            SortPacksByQuality  (void)                                                                                              noexcept;
+                    xerr            LoadLazyPack        (lazy_file& File, std::uint32_t iPack)                                                              noexcept;
+        constexpr   std::size_t     getHeaderSize       (void)                                                                                      const   noexcept;
+        static      void            SubmitLoad          (std::shared_ptr<details::async_load_state> State, std::wstring FileName, std::size_t SizeOfT, std::uint16_t ResourceVersion) noexcept;
 
     protected:
 
         // non stack base variables for writing
         writing*                    m_pWrite            {};             // Static data for writing
         compression_level           m_CompressionLevel  { compression_level::MEDIUM };
+        bool                        m_bIndependentBlocks{ false };      // Compress every block by it self (allows block level parallelism)
+        std::uint32_t               m_BlockSize         { 0 };          // Compression block size (zero picks one per pack based on its size)
+        codec_id                    m_Codec             { codec_id::XCOMPRESSION }; // Codec for the packs that don't ask for one
+        bool                        m_bStreamingSave    { false };      // Write the blocks as soon as they are done (see setStreamingSave)
+        bool                        m_bChecksums        { false };      // Save a CRC32C of every compressed block
+        bool                        m_bDeduplicate      { false };      // Identical pointed-to buffers are saved once (see setDeduplication)
+
+        // Settings for both reading and writing
+        std::uint32_t               m_nThreads          { 1 };          // How many threads (including the caller) can we use
+        loader_context*             m_pLoaderContext    { nullptr };    // Scratch memory for loading (null uses the one of the thread)
+        bool                        m_bVerifyChecksums  { false };      // Check the blocks of files that have checksums while loading
+        stats*                      m_pStats            { nullptr };    // Where the timings and counters go (null to skip them)
 
         // Stack base variables for writing
         std::uint32_t               m_iPack             {};
-        std::uint32_t               m_ClassPos          {};
+        std::uint64_t               m_ClassPos          {};
         mutable std::byte*          m_pClass            {};
         std::uint32_t               m_ClassSize         {};
 
@@ -320,6 +991,171 @@ namespace xserializer
         const memory_handle_base&   m_MemoryCallback;                   // Callback
         void*                       m_pTempBlockData    { nullptr };    // This is data that was saved with the flag temp_data
         bool                        m_bFreeTempData     { true };
+        std::span<std::byte>        m_Region            {};             // Where the shared packs go during a LoadInto (empty uses m_MemoryCallback)
+        std::size_t                 m_RegionUsed        {};             // Bytes of m_Region given to packs so far
+    };
+
+    namespace details
+    {
+        // Shared between the loader thread and the async_load handle
+        struct async_load_state
+        {
+                                        async_load_state    (const stream& Settings)                                                                    noexcept : m_Stream{ Settings } {}
+            void                        Done                (void)                                                                                      noexcept;
+            bool                        isDone              (void)                                                                                      noexcept;
+            void                        Wait                (void)                                                                                      noexcept;
+            bool                        setContinuation     (std::coroutine_handle<> Handle)                                                            noexcept;
+
+            stream                      m_Stream;
+            void*                       m_pObject           {};
+            xerr                        m_Error             {};
+            std::mutex                  m_Mutex             {};
+            std::condition_variable     m_DoneCondition     {};
+            std::coroutine_handle<>     m_Continuation      {};
+            bool                        m_bDone             { false };
+        };
+    }
+
+    //------------------------------------------------------------------------------
+    // Handle for a load started with stream::LoadAsync. The header, the I/O and the
+    // decompression run in the worker pool, ResolveObject runs in the thread that 
+    // calls get(). co_await only waits for the load and returns its status, the
+    // coroutine resumes in a worker so get() should be called once it is back in
+    // the thread that owns the object. The result can only be collected once.
+    //
+    //      auto Handle = Stream.LoadAsync(L"file.bin", pObject);
+    //      if( auto Err = Handle.get(); Err ) ...
+    //
+    //      if( auto Err = co_await Handle; Err ) ...
+    //      ... back in the owner thread ...
+    //      if( auto Err = Handle.get(); Err ) ...
+    //------------------------------------------------------------------------------
+    template< class T >
+    class async_load
+    {
+    public:
+                                    async_load                  (std::shared_ptr<details::async_load_state> State, T*& pObject)                            noexcept : m_State{ std::move(State) }, m_ppObject{ &pObject } {}
+        inline      bool            isReady                     (void)                                                                              const   noexcept;
+        inline      void            wait                        (void)                                                                              const   noexcept;
+        inline      xerr            get                         (void)                                                                                      noexcept;
+
+        inline      bool            await_ready                 (void)                                                                              const   noexcept { return isReady(); }
+        inline      bool            await_suspend               (std::coroutine_handle<> Handle)                                                            noexcept { return m_State->setContinuation(Handle); }
+        inline      xerr            await_resume                (void)                                                                              const   noexcept { assert(m_State); return m_State->m_Error; }
+
+    protected:
+
+        std::shared_ptr<details::async_load_state>  m_State;
+        T**                                         m_ppObject;
+    };
+
+    //------------------------------------------------------------------------------
+    // Writes many resources into a single file. Each resource is the output of 
+    // stream::Save (starting at a page boundary) and the table of contents at the
+    // end of the file maps the id of each resource to where it is.
+    //------------------------------------------------------------------------------
+    class bundle_writer
+    {
+    public:
+                                    bundle_writer               (void)                                                                                      noexcept = default;
+                                    bundle_writer               (const bundle_writer&)                                                                      = delete;
+        xerr                        open                        (const std::wstring_view FileName)                                                          noexcept;
+        template< class T >
+        inline      xerr            Add                         ( std::uint64_t         ID
+                                                                , const T&              Object
+                                                                , compression_level     Level       = compression_level::MEDIUM
+                                                                , mem_type              ObjectFlags = {}
+                                                                )                                                                                           noexcept;
+        xerr                        close                       (void)                                                                                      noexcept;
+        stream&                     getStream                   (void)                                                                                      noexcept { return m_Stream; }
+
+    protected:
+
+        xerr                        BeginEntry                  (void)                                                                                      noexcept;
+        xerr                        EndEntry                    (std::uint64_t ID)                                                                          noexcept;
+
+        xfile::stream                       m_File              {};
+        stream                              m_Stream            {};     // Stream used to save every resource (settings like the thread count go here)
+        std::vector<stream::bundle_entry>   m_Entries           {};
+        std::size_t                         m_EntryStart        {};
+    };
+
+    //------------------------------------------------------------------------------
+    // Reads resources from a bundle. All the reads are positioned reads on a single 
+    // file descriptor so many threads can load from the same bundle at the same 
+    // time (each one with its own stream).
+    //
+    //      Stream.Load(Bundle, ID, pObject);
+    //------------------------------------------------------------------------------
+    class bundle_reader
+    {
+    public:
+                                    bundle_reader               (void)                                                                                      noexcept = default;
+                                    bundle_reader               (const bundle_reader&)                                                                      = delete;
+                                   ~bundle_reader               (void)                                                                                      noexcept { close(); }
+        xerr                        open                        (const std::wstring_view FileName)                                                          noexcept;
+        void                        close                       (void)                                                                                      noexcept;
+        bool                        contains                    (std::uint64_t ID)                                                                  const   noexcept { return findEntry(ID) != nullptr; }
+        std::size_t                 getCount                    (void)                                                                              const   noexcept { return m_Entries.size(); }
+        xerr                        ReadAt                      (std::uint64_t Offset, std::span<std::byte> View)                                   const   noexcept;
+
+    protected:
+
+        const stream::bundle_entry* findEntry                   (std::uint64_t ID)                                                                  const   noexcept;
+
+        std::vector<stream::bundle_entry>   m_Entries           {};
+        std::intptr_t                       m_hFile             { -1 }; // Native handle (HANDLE or file descriptor)
+
+        friend class stream;
+    };
+
+    //------------------------------------------------------------------------------
+    // Keeps a resource file open so its packs can be loaded when they are needed.
+    // stream::LoadLazy loads the root pack and all the shared packs, unique packs stay 
+    // in the file and the pointers to them are null until their pack is loaded.
+    // When a quality is given it loads every pack up to that quality tier instead,
+    // finer tiers can be streamed in later with LoadQuality.
+    // Loaded packs are owned by the user the same way as with a normal load.
+    //
+    //      Stream.LoadLazy(File, pLevel);
+    //      File.Load(pLevel->m_BigTexture);         // Loads the pack and fixes its pointers
+    //
+    //      Stream.LoadLazy(File, pMesh, 0);         // Only the coarsest tier
+    //      File.LoadQuality(1);                     // Later on, add the next tier
+    //------------------------------------------------------------------------------
+    class lazy_file
+    {
+    public:
+                                    lazy_file                   (void)                                                                                      noexcept = default;
+                                    lazy_file                   (const lazy_file&)                                                                          = delete;
+                                   ~lazy_file                   (void)                                                                                      noexcept;
+        xerr                        open                        (const std::wstring_view FileName)                                                          noexcept;
+        void                        close                       (void)                                                                                      noexcept;
+        template< class T >
+        inline      xerr            Load                        (const data_ptr<T>& Pointer)                                                                noexcept { return LoadPointer(&Pointer); }
+        xerr                        LoadPack                    (std::uint32_t iPack)                                                                       noexcept;
+        xerr                        LoadQuality                 (std::uint8_t Quality)                                                                      noexcept;
+        std::uint16_t               getQualityCount             (void)                                                                              const   noexcept { return m_pStream ? m_pStream->m_Header.m_MaxQualities : 0; }
+        std::uint32_t               getPackCount                (void)                                                                              const   noexcept { return static_cast<std::uint32_t>(m_PackPointers.size()); }
+        bool                        isPackLoaded                (std::uint32_t iPack)                                                               const   noexcept { return m_PackPointers[iPack] != nullptr; }
+
+    protected:
+
+        xerr                        LoadPointer                 (const void* pPointer)                                                                      noexcept;
+        void                        ResolveDeferred             (void)                                                                                      noexcept;
+        const stream::pack*         getPacks                    (void)                                                                              const   noexcept { return reinterpret_cast<const stream::pack*>(m_Tables.get()); }
+
+        xfile::stream                       m_File              {};
+        bool                                m_bOpen             { false };
+        std::unique_ptr<stream>             m_pStream           {};     // Copy of the stream that loaded the resource (memory handler, header, ...)
+        std::unique_ptr<std::byte[]>        m_Tables            {};     // Packs, block sizes and relocation table
+        std::vector<std::byte*>             m_PackPointers      {};     // Null for the packs that are not loaded
+        std::vector<std::uint64_t>          m_PackOffsets       {};     // Where each pack starts in the file
+        std::vector<std::uint32_t>          m_FirstBlock        {};     // Index of the first block size of each pack
+        std::vector<std::uint32_t>          m_Checksums         {};     // Checksum of each block (empty when they are not verified)
+        std::vector<stream::ref>            m_Deferred          {};     // Pointers waiting for a pack, sorted by (m_OffsetPack, m_OffSet)
+
+        friend class stream;
     };
 }
 